@@ -19,6 +19,9 @@ include( msvc.pri )
 
     QT += qml quick multimedia
 
+    # QLocalServer/QLocalSocket, the control channel to out-of-process cores
+    QT += network
+
     # Needed to grab the native OpenGL context handle
     macx: QT += platformsupport-private
 
@@ -64,12 +67,23 @@ include( msvc.pri )
     core/core.h \
     core/libretro.h \
     core/libretrocore.h \
+    core/libretrocorehost.h \
+    core/libretrocoreproxy.h \
     core/libretroloader.h \
+    core/libretromemoryexport.h \
+    core/libretromemorysearch.h \
+    core/libretromovie.h \
+    core/libretromovieplayer.h \
+    core/libretromovierecorder.h \
+    core/libretroperf.h \
+    core/libretrorewind.h \
+    core/libretrosaveworker.h \
     core/libretrorunner.h \
     core/libretrosymbols.h \
     core/libretrovariable.h \
     core/libretrovariablemodel.h \
     core/libretrovariableforwarder.h \
+    core/libretrovariabletable.h \
     input/gamepadstate.h \
     input/globalgamepad.h \
     input/keyboardstate.h \
@@ -78,12 +92,20 @@ include( msvc.pri )
     input/remappermodel.h \
     input/sdlmanager.h \
     input/sdlunloader.h \
+    pipeline/audioring.h \
     pipeline/node.h \
     pipeline/pipelinecommon.h \
+    util/glfences.h \
+    util/hash64.h \
     util/logging.h \
+    util/logring.h \
+    util/memoryusage.h \
     util/microtimer.h \
     util/phoenixwindow.h \
     util/phoenixwindownode.h \
+    util/pixelconvert.h \
+    util/stdiocapture.h \
+    util/triplebuffer.h \
 
     SOURCES += \
     backendplugin.cpp \
@@ -95,12 +117,23 @@ include( msvc.pri )
     control/gameconsole.cpp \
     core/core.cpp \
     core/libretrocore.cpp \
+    core/libretrocorehost.cpp \
+    core/libretrocoreproxy.cpp \
     core/libretroloader.cpp \
+    core/libretromemoryexport.cpp \
+    core/libretromemorysearch.cpp \
+    core/libretromovie.cpp \
+    core/libretromovieplayer.cpp \
+    core/libretromovierecorder.cpp \
+    core/libretroperf.cpp \
+    core/libretrorewind.cpp \
+    core/libretrosaveworker.cpp \
     core/libretrorunner.cpp \
     core/libretrosymbols.cpp \
     core/libretrovariable.cpp \
     core/libretrovariablemodel.cpp \
     core/libretrovariableforwarder.cpp \
+    core/libretrovariabletable.cpp \
     input/gamepadstate.cpp \
     input/globalgamepad.cpp \
     input/keyboardstate.cpp \
@@ -109,11 +142,18 @@ include( msvc.pri )
     input/remappermodel.cpp \
     input/sdlmanager.cpp \
     input/sdlunloader.cpp \
+    pipeline/audioring.cpp \
     pipeline/node.cpp \
+    util/glfences.cpp \
+    util/hash64.cpp \
     util/logging.cpp \
+    util/logring.cpp \
+    util/memoryusage.cpp \
     util/microtimer.cpp \
     util/phoenixwindow.cpp \
     util/phoenixwindownode.cpp \
+    util/pixelconvert.cpp \
+    util/stdiocapture.cpp \
 
     OBJECTIVE_SOURCES += \
     util/osxhelper.mm
@@ -160,6 +200,12 @@ include( msvc.pri )
 
         # Other libraries we use
         LIBS += -lsamplerate -lz
+
+        # Memory usage stats
+        win32: LIBS += -lpsapi
+
+        # shm_open() for the memory export
+        unix:!macx: LIBS += -lrt
     }
 
     msvc: {
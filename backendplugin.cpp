@@ -20,8 +20,13 @@
 
 // Misc
 #include "logging.h"
+#include "stdiocapture.h"
 
 void BackendPlugin::registerTypes( const char *uri ) {
+    // Write log messages from a thread of their own so logging never holds up the game thread
+    startAsyncLogging();
+    startStdioCapture();
+
     // QML-owned nodes
     qmlRegisterType<ControlOutput>( uri, 1, 0, "ControlOutput" );
     qmlRegisterType<GameConsole>( uri, 1, 0, "GameConsole" );
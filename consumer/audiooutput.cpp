@@ -152,137 +152,32 @@ void AudioOutput::commandIn( Node::Command command, QVariant data, qint64 timeSt
 }
 
 void AudioOutput::dataIn( Node::DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp ) {
-    if( type == DataType::Audio ) {
-        if( state == State::Playing ) {
-            qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
+    if( type == DataType::Audio && inputDataShort ) {
+        AudioRing *audioRing = static_cast<AudioRing *>( data );
+        qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
+        AudioRingChunk chunk;
+
+        // Drain every committed chunk, even when not playing, so the producer always has room
+        // Each read copies the chunk out of the ring so the data can't be changed later
+        while( audioRing->read( reinterpret_cast<int16_t *>( inputDataShort ), static_cast<size_t>( inputBufferFrames ), chunk ) ) {
+            if( state != State::Playing ) {
+                continue;
+            }
 
             // Discard data that's too far from the past to matter anymore
-            if( currentTime - timeStamp > 500 ) {
+            if( currentTime - chunk.timeStamp > 500 ) {
                 static qint64 lastMessage = QDateTime::currentMSecsSinceEpoch();
 
                 if( currentTime - lastMessage > 1000 ) {
                     lastMessage = currentTime;
-                    // qCWarning( phxAudioOutput ) << "Discarding" << bytes << "bytes of old audio data from" <<
-                    //   currentTime - timestamp << "ms ago";
+                    // qCWarning( phxAudioOutput ) << "Discarding" << chunk.frames << "frames of old audio data from" <<
+                    //   currentTime - chunk.timeStamp << "ms ago";
                 }
 
-                return;
-            }
-
-            // Make a copy so the data won't be changed later
-            mutex->lock();
-
-            short *inputData = *reinterpret_cast<short **>( data );
-
-            if( inputData ) {
-                memcpy( inputDataShort, inputData, bytes );
-            }
-
-            mutex->unlock();
-
-            // Handle the situation where there is an error opening the audio device
-            if( outputAudioInterface->error() == QAudio::OpenError ) {
-                // qWarning( phxAudioOutput ) << "QAudio::OpenError, attempting reset...";
-                resetAudio();
-            }
-
-            int inputBytes = static_cast<int>( bytes );
-            int inputFrames = inputAudioFormat.framesForBytes( inputBytes );
-            int inputSamples = inputFrames * samplesPerFrame;
-
-            // What do we have to work with?
-            int outputTotalBytes = outputAudioFormat.bytesForDuration( outputLengthMs * 1000 );
-            outputCurrentByte = static_cast<int>( outputBuffer.bytesAvailable() );
-            int outputFreeBytes = outputTotalBytes - outputCurrentByte;
-            int outputFreeFrames = outputAudioFormat.framesForBytes( outputFreeBytes );
-            int outputFreeSamples = outputFreeFrames * samplesPerFrame;
-            Q_UNUSED( outputTotalBytes );
-            Q_UNUSED( outputFreeSamples );
-
-            // Calculate how much the read data should be scaled (shrunk or stretched) to keep the buffer on target
-            // The vector is negative if beyond the target and positive if behind
-            int outputTargetByte = outputAudioFormat.bytesForDuration( outputTargetMs * 1000 );
-            int outputEstimatedBytes = outputAudioFormat.bytesForDuration( inputAudioFormat.durationForBytes( inputBytes ) );
-            int outputVectorTargetToCurrent = outputTargetByte - outputCurrentByte + outputEstimatedBytes;
-            // double unclampedDRCScale = ( double )outputVectorTargetToCurrent / outputTargetByte;
-            double unclampedDRCScale = ( static_cast<double>( outputVectorTargetToCurrent ) + outputEstimatedBytes ) / outputEstimatedBytes;
-
-            // Calculate the final DRC ratio
-            double DRCScale = qMax( -maxDeviation, qMin( unclampedDRCScale, maxDeviation ) );
-            double hostRatio = vsync ? hostFPS / coreFPS : 1.0;
-            double adjustedSampleRateRatio = sampleRateRatio * ( 1.0 + DRCScale ) * hostRatio;
-
-            // libsamplerate works in floats, must convert to floats for processing
-            src_short_to_float_array( inputDataShort, inputDataFloat, inputSamples );
-
-            // Set up a struct containing parameters for the resampler
-            SRC_DATA srcData;
-            srcData.data_in = inputDataFloat;
-            srcData.data_out = outputDataFloat;
-            srcData.end_of_input = 0;
-            srcData.input_frames = inputFrames;
-            srcData.output_frames = outputFreeFrames; // Max size
-            srcData.src_ratio = adjustedSampleRateRatio;
-
-            // Perform resample
-            src_set_ratio( resamplerState, adjustedSampleRateRatio );
-            int errorCode = src_process( resamplerState, &srcData );
-
-            if( errorCode ) {
-                qCWarning( phxAudioOutput ) << "libresample error: " << src_strerror( errorCode ) ;
-            }
-
-            int outputFramesConverted = static_cast<int>( srcData.output_frames_gen );
-            int outputBytesConverted = outputAudioFormat.bytesForFrames( outputFramesConverted );
-            int outputSamplesConverted = outputFramesConverted * samplesPerFrame;
-
-            // Convert float data back to shorts
-            src_float_to_short_array( outputDataFloat, outputDataShort, outputSamplesConverted );
-
-            // Send the converted data out
-            int outputBytesWritten = static_cast<int>( outputBuffer.write( reinterpret_cast<char *>( outputDataShort ), outputBytesConverted ) );
-            outputCurrentByte += outputBytesWritten;
-            //#define DRC_LOGGING
-#if defined( DRC_LOGGING )
-            static qint64 lastMessage = 0;
-
-            qint64 inputBytesPerMSec = inputAudioFormat.bytesForDuration( 1000 );
-            qint64 outputBytesPerMSec = outputAudioFormat.bytesForDuration( 1000 );
-
-            if( currentTime - lastMessage > 1000 ) {
-                lastMessage = currentTime;
-                qCDebug( phxAudioOutput ) << "Input:" << inputBytes / inputBytesPerMSec << "ms";
-                qCDebug( phxAudioOutput ) << "hostFps:" << hostFPS << "coreFPS:" << coreFPS;
-                qCDebug( phxAudioOutput ) << "Output is" << ( ( ( double )( ( outputTotalBytes - outputFreeBytes ) ) /
-                                          outputTotalBytes ) * 100 )
-                                          << "% full," << ( outputTotalBytes - outputFreeBytes ) / outputBytesPerMSec << "ms (target:" << outputTargetMs << "ms /"
-                                          << ( ( double )outputTargetMs / outputLengthMs ) * 100 << "%)";
-                qCDebug( phxAudioOutput ) << "\tunclampedDRCScale =" << unclampedDRCScale << "DRCScale =" << DRCScale
-                                          << "outputAudioInterface->bufferSize()" << outputAudioInterface->bufferSize() / outputBytesPerMSec << "ms";
-                qCDebug( phxAudioOutput ) << "\toutputTotalBytes =" << outputTotalBytes / outputBytesPerMSec << "ms"
-                                          << "outputCurrentByte =" << outputCurrentByte / outputBytesPerMSec << "ms"
-                                          << " outputFreeBytes =" << outputFreeBytes / outputBytesPerMSec << "ms";
-                qCDebug( phxAudioOutput ) << "\tOutput buffer is" << outputLengthMs
-                                          << "ms, target =" << outputTargetMs
-                                          << "ms (" << ( double )100.0 * ( ( double )outputTargetMs / (
-                                                      ( double )( outputAudioFormat.durationForBytes(
-                                                              outputTotalBytes ) ) / 1000.0 ) )
-                                          << "%)";
-                qCDebug( phxAudioOutput ) << "\tOutput: needed" << outputVectorTargetToCurrent / outputBytesPerMSec << "ms, wrote"
-                                          << outputBytesWritten / outputBytesPerMSec << "ms";
-                qCDebug( phxAudioOutput ) << "\toutputTargetByte =" << outputTargetByte / outputBytesPerMSec << "ms"
-                                          << "outputVectorTargetToCurrent =" << outputVectorTargetToCurrent / outputBytesPerMSec << "ms";
-                qCDebug( phxAudioOutput ) << "\toutputAudioInterface->bufferSize() =" << outputAudioInterface->bufferSize() / outputBytesPerMSec << "ms"
-                                          << "outputAudioInterface->bytesFree() =" << outputAudioInterface->bytesFree() / outputBytesPerMSec << "ms"
-                                          << "outputBuffer.bytesToWrite() =" << outputBuffer.bytesToWrite() / outputBytesPerMSec << "ms";
-                qCDebug( phxAudioOutput ) << "\toutputBuffer.bytesAvailable() =" << outputBuffer.bytesAvailable() / outputBytesPerMSec << "ms"
-                                          << "outputBuffer.size() =" << outputBuffer.size() / outputBytesPerMSec << "ms"
-                                          << "outputBuffer.pos() =" << outputBuffer.pos() / outputBytesPerMSec << "ms";
-                // qCDebug( phxAudioOutput ) << "\tState:" << outputAudioInterface->state()
-                //   << " error: " << outputAudioInterface->error();
+                continue;
             }
 
-#endif
+            resample( inputAudioFormat.bytesForFrames( static_cast<int>( chunk.frames ) ), currentTime );
         }
     }
 
@@ -317,6 +212,113 @@ void AudioOutput::outputUnderflow() {
 
 // Private
 
+void AudioOutput::resample( int inputBytes, qint64 currentTime ) {
+    Q_UNUSED( currentTime );
+
+    // Handle the situation where there is an error opening the audio device
+    if( outputAudioInterface->error() == QAudio::OpenError ) {
+        // qWarning( phxAudioOutput ) << "QAudio::OpenError, attempting reset...";
+        resetAudio();
+    }
+
+    int inputFrames = inputAudioFormat.framesForBytes( inputBytes );
+    int inputSamples = inputFrames * samplesPerFrame;
+
+    // What do we have to work with?
+    int outputTotalBytes = outputAudioFormat.bytesForDuration( outputLengthMs * 1000 );
+    outputCurrentByte = static_cast<int>( outputBuffer.bytesAvailable() );
+    int outputFreeBytes = outputTotalBytes - outputCurrentByte;
+    int outputFreeFrames = outputAudioFormat.framesForBytes( outputFreeBytes );
+    int outputFreeSamples = outputFreeFrames * samplesPerFrame;
+    Q_UNUSED( outputTotalBytes );
+    Q_UNUSED( outputFreeSamples );
+
+    // Calculate how much the read data should be scaled (shrunk or stretched) to keep the buffer on target
+    // The vector is negative if beyond the target and positive if behind
+    int outputTargetByte = outputAudioFormat.bytesForDuration( outputTargetMs * 1000 );
+    int outputEstimatedBytes = outputAudioFormat.bytesForDuration( inputAudioFormat.durationForBytes( inputBytes ) );
+    int outputVectorTargetToCurrent = outputTargetByte - outputCurrentByte + outputEstimatedBytes;
+    // double unclampedDRCScale = ( double )outputVectorTargetToCurrent / outputTargetByte;
+    double unclampedDRCScale = ( static_cast<double>( outputVectorTargetToCurrent ) + outputEstimatedBytes ) / outputEstimatedBytes;
+
+    // Calculate the final DRC ratio
+    double DRCScale = qMax( -maxDeviation, qMin( unclampedDRCScale, maxDeviation ) );
+    double hostRatio = vsync ? hostFPS / coreFPS : 1.0;
+    double adjustedSampleRateRatio = sampleRateRatio * ( 1.0 + DRCScale ) * hostRatio;
+
+    // libsamplerate works in floats, must convert to floats for processing
+    src_short_to_float_array( inputDataShort, inputDataFloat, inputSamples );
+
+    // Set up a struct containing parameters for the resampler
+    SRC_DATA srcData;
+    srcData.data_in = inputDataFloat;
+    srcData.data_out = outputDataFloat;
+    srcData.end_of_input = 0;
+    srcData.input_frames = inputFrames;
+    srcData.output_frames = outputFreeFrames; // Max size
+    srcData.src_ratio = adjustedSampleRateRatio;
+
+    // Perform resample
+    src_set_ratio( resamplerState, adjustedSampleRateRatio );
+    int errorCode = src_process( resamplerState, &srcData );
+
+    if( errorCode ) {
+        qCWarning( phxAudioOutput ) << "libresample error: " << src_strerror( errorCode ) ;
+    }
+
+    int outputFramesConverted = static_cast<int>( srcData.output_frames_gen );
+    int outputBytesConverted = outputAudioFormat.bytesForFrames( outputFramesConverted );
+    int outputSamplesConverted = outputFramesConverted * samplesPerFrame;
+
+    // Convert float data back to shorts
+    src_float_to_short_array( outputDataFloat, outputDataShort, outputSamplesConverted );
+
+    // Send the converted data out
+    int outputBytesWritten = static_cast<int>( outputBuffer.write( reinterpret_cast<char *>( outputDataShort ), outputBytesConverted ) );
+    outputCurrentByte += outputBytesWritten;
+    //#define DRC_LOGGING
+#if defined( DRC_LOGGING )
+    static qint64 lastMessage = 0;
+
+    qint64 inputBytesPerMSec = inputAudioFormat.bytesForDuration( 1000 );
+    qint64 outputBytesPerMSec = outputAudioFormat.bytesForDuration( 1000 );
+
+    if( currentTime - lastMessage > 1000 ) {
+        lastMessage = currentTime;
+        qCDebug( phxAudioOutput ) << "Input:" << inputBytes / inputBytesPerMSec << "ms";
+        qCDebug( phxAudioOutput ) << "hostFps:" << hostFPS << "coreFPS:" << coreFPS;
+        qCDebug( phxAudioOutput ) << "Output is" << ( ( ( double )( ( outputTotalBytes - outputFreeBytes ) ) /
+                                  outputTotalBytes ) * 100 )
+                                  << "% full," << ( outputTotalBytes - outputFreeBytes ) / outputBytesPerMSec << "ms (target:" << outputTargetMs << "ms /"
+                                  << ( ( double )outputTargetMs / outputLengthMs ) * 100 << "%)";
+        qCDebug( phxAudioOutput ) << "\tunclampedDRCScale =" << unclampedDRCScale << "DRCScale =" << DRCScale
+                                  << "outputAudioInterface->bufferSize()" << outputAudioInterface->bufferSize() / outputBytesPerMSec << "ms";
+        qCDebug( phxAudioOutput ) << "\toutputTotalBytes =" << outputTotalBytes / outputBytesPerMSec << "ms"
+                                  << "outputCurrentByte =" << outputCurrentByte / outputBytesPerMSec << "ms"
+                                  << " outputFreeBytes =" << outputFreeBytes / outputBytesPerMSec << "ms";
+        qCDebug( phxAudioOutput ) << "\tOutput buffer is" << outputLengthMs
+                                  << "ms, target =" << outputTargetMs
+                                  << "ms (" << ( double )100.0 * ( ( double )outputTargetMs / (
+                                              ( double )( outputAudioFormat.durationForBytes(
+                                                      outputTotalBytes ) ) / 1000.0 ) )
+                                  << "%)";
+        qCDebug( phxAudioOutput ) << "\tOutput: needed" << outputVectorTargetToCurrent / outputBytesPerMSec << "ms, wrote"
+                                  << outputBytesWritten / outputBytesPerMSec << "ms";
+        qCDebug( phxAudioOutput ) << "\toutputTargetByte =" << outputTargetByte / outputBytesPerMSec << "ms"
+                                  << "outputVectorTargetToCurrent =" << outputVectorTargetToCurrent / outputBytesPerMSec << "ms";
+        qCDebug( phxAudioOutput ) << "\toutputAudioInterface->bufferSize() =" << outputAudioInterface->bufferSize() / outputBytesPerMSec << "ms"
+                                  << "outputAudioInterface->bytesFree() =" << outputAudioInterface->bytesFree() / outputBytesPerMSec << "ms"
+                                  << "outputBuffer.bytesToWrite() =" << outputBuffer.bytesToWrite() / outputBytesPerMSec << "ms";
+        qCDebug( phxAudioOutput ) << "\toutputBuffer.bytesAvailable() =" << outputBuffer.bytesAvailable() / outputBytesPerMSec << "ms"
+                                  << "outputBuffer.size() =" << outputBuffer.size() / outputBytesPerMSec << "ms"
+                                  << "outputBuffer.pos() =" << outputBuffer.pos() / outputBytesPerMSec << "ms";
+        // qCDebug( phxAudioOutput ) << "\tState:" << outputAudioInterface->state()
+        //   << " error: " << outputAudioInterface->error();
+    }
+
+#endif
+}
+
 void AudioOutput::pipelineStateChanged() {
     if( !outputAudioInterface ) {
         return;
@@ -349,6 +351,7 @@ void AudioOutput::shutdown() {
     if( inputDataShort ) {
         delete [] inputDataShort;
         inputDataShort = nullptr;
+        inputBufferFrames = 0;
     }
 
     if( inputDataFloat ) {
@@ -444,6 +447,7 @@ void AudioOutput::allocateMemory() {
     }
 
     inputDataShort = new short[ inputBufferSamples ]();
+    inputBufferFrames = inputBufferSamples / samplesPerFrame;
     inputDataFloat = new float[ inputBufferSamples ]();
     outputDataFloat = new float[ outputBufferSamples ]();
     outputDataShort = new short[ outputBufferSamples ]();
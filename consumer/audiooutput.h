@@ -2,6 +2,7 @@
 
 #include "node.h"
 #include "audiobuffer.h"
+#include "audioring.h"
 #include "samplerate.h"
 
 #include <QAudio>
@@ -51,6 +52,9 @@ class AudioOutput : public Node {
         // Allocate memory for conversion
         void allocateMemory();
 
+        // Resample inputBytes of data from inputDataShort and write it to the output buffer
+        void resample( int inputBytes, qint64 currentTime );
+
         // Opaque pointer for libsamplerate
         SRC_STATE *resamplerState{ nullptr };
 
@@ -62,6 +66,7 @@ class AudioOutput : public Node {
 
         // Internal buffers used for resampling
         short *inputDataShort{ nullptr };
+        int inputBufferFrames{ 0 };
         float *inputDataFloat{ nullptr };
         float *outputDataFloat{ nullptr };
         short *outputDataShort{ nullptr };
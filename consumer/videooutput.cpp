@@ -3,10 +3,22 @@
 
 #include <QMutex>
 #include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QSGSimpleTextureNode>
 #include <QThread>
 #include <QQuickWindow>
 
+#include <string.h>
+
+// Not in every platform's GL headers
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
 VideoOutput::VideoOutput( QQuickItem *parent ) : QQuickItem( parent ) {
     // Mandatory for our own drawing code to do anything
     setFlag( QQuickItem::ItemHasContents, true );
@@ -17,15 +29,11 @@ VideoOutput::VideoOutput( QQuickItem *parent ) : QQuickItem( parent ) {
     emit televisionChanged();
     emit ntscChanged();
     emit widescreenChanged();
-
-    size_t newSize = this->format.videoSize.width() * this->format.videoSize.height() * this->format.videoBytesPerPixel;
-    framebuffer = new uchar[ newSize ]();
-    framebufferSize = newSize;
 }
 
 VideoOutput::~VideoOutput() {
-    if( framebuffer ) {
-        delete framebuffer;
+    for( int i = 0; i < 3; i++ ) {
+        delete[] frames.slot( i ).storage;
     }
 }
 
@@ -49,26 +57,13 @@ void VideoOutput::setFormat( LibretroVideoFormat format ) {
         emit aspectRatioChanged();
     }
 
-    // Allocate a new framebuffer if the incoming format defines a larger one than we already have room for
-    size_t newSize = format.videoSize.width() * format.videoSize.height() * format.videoBytesPerPixel;
-
-    if( newSize > framebufferSize ) {
-        if( framebuffer ) {
-            delete framebuffer;
-        }
-
-        qCDebug( phxVideo ).nospace() << "Expanded framebuffer to fit new size/format (size = " <<
-                                      ( double )newSize / 1024.0 << " KB)";
-        framebuffer = new uchar[ newSize ]();
-        framebufferSize = newSize;
-    }
+    // Frames get converted to 32-bit as they're copied in if the format is one we can convert
+    converter = pixelConverter( format.videoPixelFormat );
 
     this->format = format;
 }
 
 void VideoOutput::data( QMutex *mutex, void *data, size_t bytes, qint64 timestamp ) {
-    this->mutex = mutex;
-
     // Copy framebuffer to our own buffer for later drawing
     if( state == Node::State::Playing ) {
         qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
@@ -86,21 +81,46 @@ void VideoOutput::data( QMutex *mutex, void *data, size_t bytes, qint64 timestam
             return;
         }
 
-        // Make sure reads and writes to this buffer are atomic
+        VideoOutputFrame &frame = frames.writeSlot();
+        size_t pitch = this->format.videoSize.width() * ( converter ? 4 : this->format.videoBytesPerPixel );
+        size_t size = this->format.videoSize.height() * pitch;
+
+        // Straight into the buffer the render thread mapped for us if the frame fits, our own storage otherwise
+        if( frame.mapped && frame.mappedSize >= size ) {
+            frame.pixels = frame.mapped;
+        } else {
+            if( size > frame.storageSize ) {
+                delete[] frame.storage;
+
+                qCDebug( phxVideo ).nospace() << "Expanded frame storage to fit new size/format (size = " <<
+                                              ( double )size / 1024.0 << " KB)";
+                frame.storage = new uchar[ size ]();
+                frame.storageSize = size;
+            }
+
+            frame.pixels = frame.storage;
+        }
+
+        // Keeps Core from freeing its buffers while we read them. The render thread never takes it for software frames
         mutex->lock();
 
         const uchar *newFramebuffer = *( const uchar ** )data;
 
-        if( newFramebuffer ) {
+        // Convert and copy in one pass, skipping the garbage at the end of each line
+        if( newFramebuffer && converter ) {
+            Q_ASSERT( this->format.videoSize.height() * this->format.videoBytesPerLine <= bytes );
+
+            converter( frame.pixels, pitch, newFramebuffer, this->format.videoBytesPerLine,
+                       this->format.videoSize.width(), this->format.videoSize.height() );
+        }
+
+        else if( newFramebuffer ) {
             // Copy framebuffer line by line as the consumer may pack the image with arbitrary garbage data at the end of each line
             for( int i = 0; i < this->format.videoSize.height(); i++ ) {
                 // Don't read past the end of the given buffer
                 Q_ASSERT( i * this->format.videoBytesPerLine < bytes );
 
-                // Don't write past the end of our framebuffer
-                Q_ASSERT( i * this->format.videoSize.width() * this->format.videoBytesPerPixel < framebufferSize );
-
-                memcpy( framebuffer + i * this->format.videoSize.width() * this->format.videoBytesPerPixel,
+                memcpy( frame.pixels + i * pitch,
                         newFramebuffer + i * this->format.videoBytesPerLine,
                         this->format.videoSize.width() * this->format.videoBytesPerPixel
                       );
@@ -109,13 +129,21 @@ void VideoOutput::data( QMutex *mutex, void *data, size_t bytes, qint64 timestam
 
         mutex->unlock();
 
+        // Hand it to the render thread
+        if( newFramebuffer ) {
+            frame.size = this->format.videoSize;
+            frame.pitch = pitch;
+            frame.pixelFormat = converter ? QImage::Format_RGB32 : this->format.videoPixelFormat;
+            frames.publish();
+        }
+
         // Schedule a call to updatePaintNode()
         update();
     }
 }
 
-void VideoOutput::setTextureID( GLuint textureID ) {
-    this->textureID = textureID;
+void VideoOutput::setGLFrames( LibretroGLFrames *glFrames ) {
+    this->glFrames = glFrames;
 }
 
 void VideoOutput::setAspectMode( int aspectMode ) {
@@ -152,21 +180,33 @@ void VideoOutput::classBegin() {
 
 void VideoOutput::componentComplete() {
     QQuickItem::componentComplete();
-    // Lock the mutex before we start drawing
-    connect( window(), &QQuickWindow::beforeRendering, this, [ & ]() {
-        if( mutex ) {
-            lockedByUs = true;
-            mutex->lock();
-            //qDebug() << "VideoOutput lock";
-        }
-    }, Qt::DirectConnection );
 
-    connect( window(), &QQuickWindow::afterRendering, this, [ & ]() {
-        if( mutex && lockedByUs ) {
-            lockedByUs = false;
-            mutex->unlock();
-            //qDebug() << "VideoOutput unlock";
+    // The context is about to go away, take the streaming texture and buffers with it
+    // The main thread waits for the render thread while the scene graph is invalidated, data() can't be running
+    connect( window(), &QQuickWindow::sceneGraphInvalidated, this, [ & ]() {
+        freeStreamingTexture();
+
+        for( int i = 0; i < 3; i++ ) {
+            VideoOutputFrame &frame = frames.slot( i );
+
+            if( frame.mapped ) {
+                frame.buffer.bind();
+                frame.buffer.unmap();
+                QOpenGLBuffer::release( QOpenGLBuffer::PixelUnpackBuffer );
+            }
+
+            // A frame that was converted into the buffer goes with it
+            if( frame.pixels && frame.pixels == frame.mapped ) {
+                frame.pixels = nullptr;
+            }
+
+            frame.buffer.destroy();
+            frame.mapped = nullptr;
+            frame.mappedSize = 0;
         }
+
+        pixelBuffersSupported = false;
+        fences.init( nullptr );
     }, Qt::DirectConnection );
 }
 
@@ -192,29 +232,94 @@ QSGNode *VideoOutput::updatePaintNode( QSGNode *storedNode, QQuickItem::UpdatePa
         storedTextureNode = new QSGSimpleTextureNode();
     }
 
-    // 2D rendering, create a texture from the stored buffer
-    if( format.videoMode == SOFTWARERENDER ) {
-        // Schedule old texture for deletion
-        if( texture ) {
-            texture->deleteLater();
-            texture = nullptr;
+    // 2D rendering, update the texture if data() published a new frame, otherwise show the last one again
+    if( format.videoMode == SOFTWARERENDER && ( frames.hasUpdate() || texture ) ) {
+        if( frames.hasUpdate() ) {
+            // Map the buffer of the frame we're done with before it goes back to data() so the next frame can be
+            // converted straight into it
+            mapFrameBuffer( frames.readSlot() );
+            frames.update();
+
+            VideoOutputFrame &frame = frames.readSlot();
+            sourceRect = QRectF();
+
+            if( frame.pixels ) {
+                bool streaming = frame.pixelFormat == QImage::Format_RGB32 &&
+                                 ( frame.size == streamingTextureSize || allocateStreamingTexture( frame.size ) );
+
+                // Schedule old texture for deletion unless it's the streaming texture, which stays
+                if( texture && texture != streamingTexture ) {
+                    texture->deleteLater();
+                    texture = nullptr;
+                }
+
+                if( streaming ) {
+                    uploadFrame( frame );
+                    texture = streamingTexture;
+                }
+
+                // Fall back to a new texture every frame
+                else {
+                    // Create new Image that holds a reference to the frame, data() won't touch it until we take a newer one
+                    QImage image( const_cast<const uchar *>( frame.pixels ), frame.size.width(), frame.size.height(),
+                                  static_cast<int>( frame.pitch ), frame.pixelFormat );
+                    // Create a texture via a factory function (framebuffer contents are uploaded to GPU once QSG reads texture node)
+                    texture = window()->createTextureFromImage( image, QQuickWindow::TextureOwnsGLTexture );
+                }
+            }
         }
 
-        // Create new Image that holds a reference to our framebuffer
-        QImage image( const_cast<const uchar *>( framebuffer ), format.videoSize.width(), format.videoSize.height(), format.videoPixelFormat );
-        // Create a texture via a factory function (framebuffer contents are uploaded to GPU once QSG reads texture node)
-        texture = window()->createTextureFromImage( image, QQuickWindow::TextureOwnsGLTexture );
+        // The only frame there was went away with its buffer
+        if( !texture ) {
+            delete storedTextureNode;
+            update();
+            return 0;
+        }
     }
 
-    // 3D rendering, use the stored texture name to render
-    else if( textureID != 0 ) {
-        if( !texture ) {
-            texture = window()->createTextureFromId( textureID, QSize( format.videoSize.width(), format.videoSize.height() ) );
+    // 3D rendering, show the newest frame the core published, otherwise the last one again
+    else if( format.videoMode == HARDWARERENDER && glFrames && ( glFrames->hasUpdate() || texture ) ) {
+        // The streaming texture is freed separately
+        if( texture == streamingTexture ) {
+            texture = nullptr;
+        }
+
+        if( glFrames->hasUpdate() ) {
+            fences.init( window()->openglContext() );
+
+            // We're done with the frame we showed last once everything issued so far (the last render pass) has run,
+            // the core waits for that before drawing into it again
+            // Without fences the other two FBOs are all that keep the core from drawing over it too soon
+            LibretroGLFrame &previous = glFrames->readSlot();
+            fences.remove( previous.released );
+            previous.released = previous.texture ? fences.insert() : nullptr;
+            glFrames->update();
+
+            // Our commands from here on wait for the core to finish drawing the frame, this thread doesn't
+            LibretroGLFrame &frame = glFrames->readSlot();
+            fences.wait( frame.ready );
+            fences.remove( frame.ready );
+            frame.ready = nullptr;
+
+            // The core swaps an FBO for a bigger one if its video outgrows it, a new one may get the old one's texture
+            // name
+            if( !texture || frame.texture != static_cast<GLuint>( texture->textureId() ) || frame.textureSize != texture->textureSize() ) {
+                if( texture ) {
+                    texture->deleteLater();
+                }
+
+                texture = window()->createTextureFromId( frame.texture, frame.textureSize );
+            }
+
+            // Only the bottom-left corner of the FBO holds the frame. Top-left here, mirroring flips it within the rect
+            sourceRect = QRectF( QPointF( 0, 0 ), frame.size );
         }
 
-        if( textureID != static_cast<GLuint>( texture->textureId() ) ) {
-            texture->deleteLater();
-            texture = window()->createTextureFromId( textureID, QSize( format.videoSize.width(), format.videoSize.height() ) );
+        // The streaming texture was the last thing shown
+        if( !texture ) {
+            delete storedTextureNode;
+            update();
+            return 0;
         }
     }
 
@@ -231,6 +336,7 @@ QSGNode *VideoOutput::updatePaintNode( QSGNode *storedNode, QQuickItem::UpdatePa
 
     // Put this new texture into our QSG node and mark the node dirty so it'll be redrawn
     storedTextureNode->setTexture( texture );
+    storedTextureNode->setSourceRect( sourceRect );
     storedTextureNode->setRect( boundingRect() );
     storedTextureNode->setFiltering( linearFiltering ? QSGTexture::Linear : QSGTexture::Nearest );
     storedTextureNode->setTextureCoordinatesTransform(
@@ -247,6 +353,129 @@ QSGNode *VideoOutput::updatePaintNode( QSGNode *storedNode, QQuickItem::UpdatePa
     return storedTextureNode;
 }
 
+bool VideoOutput::allocateStreamingTexture( QSize size ) {
+    freeStreamingTexture();
+
+    if( size.isEmpty() ) {
+        return false;
+    }
+
+    QOpenGLContext *context = window()->openglContext();
+    QOpenGLFunctions *gl = context->functions();
+    GLenum internalFormat = GL_RGBA;
+
+    // Desktop GL takes the pixels as whole 32-bit words. ES only has BGRA as an extension and only as bytes, which are
+    // only in B, G, R, A order in memory on little-endian machines
+    if( context->isOpenGLES() ) {
+        if( !context->hasExtension( "GL_EXT_texture_format_BGRA8888" ) || Q_BYTE_ORDER != Q_LITTLE_ENDIAN ) {
+            return false;
+        }
+
+        internalFormat = GL_BGRA;
+        streamingTextureType = GL_UNSIGNED_BYTE;
+    } else {
+        streamingTextureType = GL_UNSIGNED_INT_8_8_8_8_REV;
+    }
+
+    GLuint textureName = 0;
+    gl->glGenTextures( 1, &textureName );
+    gl->glBindTexture( GL_TEXTURE_2D, textureName );
+    gl->glTexImage2D( GL_TEXTURE_2D, 0, static_cast<GLint>( internalFormat ), size.width(), size.height(), 0, GL_BGRA,
+                      streamingTextureType, nullptr );
+    gl->glBindTexture( GL_TEXTURE_2D, 0 );
+
+    streamingTexture = window()->createTextureFromId( textureName, size, QQuickWindow::TextureOwnsGLTexture );
+    streamingTextureSize = size;
+
+    // Pixel unpack buffers are core in desktop GL 2.1 and ES 3.0, without them frames are uploaded from our own storage
+    QSurfaceFormat surfaceFormat = context->format();
+    pixelBuffersSupported = context->isOpenGLES() ? surfaceFormat.majorVersion() >= 3 :
+                            surfaceFormat.version() >= qMakePair( 2, 1 ) || context->hasExtension( "GL_ARB_pixel_buffer_object" );
+
+    qCDebug( phxVideo ).nospace() << "Allocated streaming texture (" << size.width() << "x" << size.height() << ", "
+                                  << ( pixelBuffersSupported ? "with" : "without" ) << " pixel buffers)";
+
+    return true;
+}
+
+void VideoOutput::freeStreamingTexture() {
+    if( texture == streamingTexture ) {
+        texture = nullptr;
+    }
+
+    // Owns its GL texture
+    delete streamingTexture;
+    streamingTexture = nullptr;
+    streamingTextureSize = QSize();
+}
+
+void VideoOutput::mapFrameBuffer( VideoOutputFrame &frame ) {
+    // Only 0xffRRGGBB frames are uploaded from a buffer
+    if( !pixelBuffersSupported || !converter || frame.mapped ) {
+        return;
+    }
+
+    if( !frame.buffer.isCreated() ) {
+        frame.buffer = QOpenGLBuffer( QOpenGLBuffer::PixelUnpackBuffer );
+        frame.buffer.setUsagePattern( QOpenGLBuffer::StreamDraw );
+
+        if( !frame.buffer.create() ) {
+            pixelBuffersSupported = false;
+            return;
+        }
+    }
+
+    // Sized for the format data() will use next
+    size_t size = format.videoSize.height() * format.videoSize.width() * 4;
+
+    if( !size ) {
+        return;
+    }
+
+    frame.buffer.bind();
+
+    // Orphan its old storage so the driver doesn't make us wait on an upload still in flight from it
+    frame.buffer.allocate( static_cast<int>( size ) );
+    frame.mapped = static_cast<uchar *>( frame.buffer.map( QOpenGLBuffer::WriteOnly ) );
+    frame.mappedSize = frame.mapped ? size : 0;
+
+    QOpenGLBuffer::release( QOpenGLBuffer::PixelUnpackBuffer );
+
+    // Frames will come from our own storage from now on
+    if( !frame.mapped ) {
+        qCDebug( phxVideo ) << "Could not map a pixel buffer, uploading frames without one";
+        frame.buffer.destroy();
+        pixelBuffersSupported = false;
+    }
+}
+
+void VideoOutput::uploadFrame( VideoOutputFrame &frame ) {
+    QOpenGLFunctions *gl = window()->openglContext()->functions();
+    bool fromBuffer = frame.mapped && frame.pixels == frame.mapped;
+
+    // Unmapped either way, data() only writes to a buffer we mapped after the upload
+    if( frame.mapped ) {
+        frame.buffer.bind();
+        frame.buffer.unmap();
+        frame.mapped = nullptr;
+        frame.mappedSize = 0;
+
+        if( !fromBuffer ) {
+            QOpenGLBuffer::release( QOpenGLBuffer::PixelUnpackBuffer );
+        }
+    }
+
+    // With a buffer bound the pointer is an offset into it
+    gl->glBindTexture( GL_TEXTURE_2D, static_cast<GLuint>( streamingTexture->textureId() ) );
+    gl->glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, frame.size.width(), frame.size.height(), GL_BGRA, streamingTextureType,
+                         fromBuffer ? nullptr : frame.pixels );
+    gl->glBindTexture( GL_TEXTURE_2D, 0 );
+
+    if( fromBuffer ) {
+        QOpenGLBuffer::release( QOpenGLBuffer::PixelUnpackBuffer );
+    }
+}
+
 qreal VideoOutput::calculateAspectRatio( LibretroVideoFormat format ) {
     qreal newRatio = format.videoAspectRatio;
 
@@ -1,14 +1,37 @@
 #pragma once
 
 #include "node.h"
+#include "pixelconvert.h"
+#include "triplebuffer.h"
 
 #include <QQuickItem>
+#include <QOpenGLBuffer>
 #include <QOpenGLContext>
 #include <QQmlParserStatus>
 
 class QMutex;
 class QSGTexture;
 
+// A software-rendered frame on its way from VideoOutput::data() to the render thread
+struct VideoOutputFrame {
+    // Where the frame is, nullptr if there's no frame. Either mapped or storage
+    uchar *pixels { nullptr };
+
+    QSize size;
+    size_t pitch { 0 };
+    QImage::Format pixelFormat { QImage::Format_Invalid };
+
+    // A pixel unpack buffer the render thread maps before handing the slot to data() so frames can be converted
+    // straight into memory the GPU uploads from. nullptr if it isn't mapped
+    QOpenGLBuffer buffer;
+    uchar *mapped { nullptr };
+    size_t mappedSize { 0 };
+
+    // Used when the buffer isn't mapped or the frame doesn't fit it, grown by data() as needed
+    uchar *storage { nullptr };
+    size_t storageSize { 0 };
+};
+
 /*
  * VideoOutput is a QQuickItem that consumes video data. It is meant to be instantiated from QML.
  */
@@ -31,7 +54,7 @@ class VideoOutput : public QQuickItem {
         void setFormat( LibretroVideoFormat consumerFmt );
         void data( QMutex *mutex, void *data, size_t bytes, qint64 timestamp );
 
-        void setTextureID( GLuint textureID );
+        void setGLFrames( LibretroGLFrames *glFrames );
 
         // Setters for the properties, will force a recheck of the aspect ratio if any are called
         void setAspectMode( int aspectMode );
@@ -39,10 +62,6 @@ class VideoOutput : public QQuickItem {
         void setNtsc( bool ntsc );
         void setWidescreen( bool widescreen );
 
-        // The mutex used by the core to draw video
-        // We'll need to lock it during 3D rendering
-        QMutex *mutex { nullptr };
-
         void classBegin() override;
         void componentComplete() override;
 
@@ -60,15 +79,46 @@ class VideoOutput : public QQuickItem {
         Node::State state{ Node::State::Stopped };
         LibretroVideoFormat format;
 
-        // The framebuffer that holds the latest frame from Core
-        uchar *framebuffer { nullptr };
-        size_t framebufferSize { 0 };
+        // Software-rendered frames from Core, converted to 0xffRRGGBB if there's a converter for their format so Qt
+        // can upload them without converting them again. data() fills and publishes the write slot, the render thread
+        // takes the newest one when it updates the texture. Neither waits on the other
+        TripleBuffer<VideoOutputFrame> frames;
+
+        // Converts the core's frames as they're copied, nullptr if frames are copied as they are
+        PixelConverter converter { nullptr };
 
-        // Holds a pointer to the framebuffer via its underlying QImage, used by renderer to upload framebuffer to GPU
+        // The texture currently given to the scene graph: the streaming texture, a texture made from a QImage of the
+        // newest frame if there isn't one or a wrapper around a 3D core's texture
         QSGTexture *texture { nullptr };
 
-        // The texture name used by 3d cores
-        GLuint textureID { 0 };
+        // The part of texture that's the frame in pixels, empty for all of it. 3D cores' frames only fill part of their
+        // FBO
+        QRectF sourceRect;
+
+        // Software rendering: a texture that lives until the frame's size changes, frames are copied into it with
+        // glTexSubImage2D straight from the pixel unpack buffer they were converted into so the upload itself happens
+        // asynchronously. Only used for frames the converter turned into 0xffRRGGBB. Render thread only
+        QSGTexture *streamingTexture { nullptr };
+        QSize streamingTextureSize;
+        GLenum streamingTextureType { 0 };
+        bool pixelBuffersSupported { false };
+
+        // Render thread only, the GL context must be current
+        // Returns false if the streaming texture can't be used by this context
+        bool allocateStreamingTexture( QSize size );
+        void freeStreamingTexture();
+
+        // Orphan the frame's buffer and map it for data() to write the next frame into, if pixel buffers are supported
+        void mapFrameBuffer( VideoOutputFrame &frame );
+
+        // Unmap the frame's buffer and copy the frame into the streaming texture
+        void uploadFrame( VideoOutputFrame &frame );
+
+        // Frames 3D cores drew, the render thread takes the newest one and gives the one before back with a fence
+        LibretroGLFrames *glFrames { nullptr };
+
+        // For the render thread's context
+        GLFences fences;
 
         // Called by render thread whenever it's time to render and needs an update from us
         // We'll assign the current texture to the stored node given to us, creating this stored node if it does not
@@ -101,9 +151,6 @@ class VideoOutput : public QQuickItem {
         // Ignored if television is false
         bool widescreen{ false };
 
-        // Has this mutex been locked by us?
-        bool lockedByUs { false };
-
         // Discovered from: http://stackoverflow.com/a/96035/4190028
         // Find rational approximation to given real number
         // By: David Eppstein / UC Irvine / 8 Aug 1993
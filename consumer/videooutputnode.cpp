@@ -38,10 +38,6 @@ void VideoOutputNode::commandIn( Node::Command command, QVariant data, qint64 ti
                 videoOutput->setFormat( qvariant_cast<LibretroVideoFormat>( data ) );
                 break;
 
-            case Command::SetOpenGLTexture:
-                videoOutput->setTextureID( data.toInt() );
-                break;
-
             case Command::SetAspectRatioMode: {
                 videoOutput->setAspectMode( data.toInt() );
                 break;
@@ -60,7 +56,7 @@ void VideoOutputNode::dataIn( Node::DataType type, QMutex *mutex, void *data, si
         if( type == DataType::Video ) {
             videoOutput->data( mutex, data, bytes, timeStamp );
         } else if( type == DataType::VideoGL ) {
-            videoOutput->mutex = mutex;
+            videoOutput->setGLFrames( static_cast<LibretroGLFrames *>( data ) );
             videoOutput->update();
         }
     }
@@ -44,6 +44,17 @@ void ControlOutput::commandIn( Node::Command command, QVariant data, qint64 time
             break;
         }
 
+        case Command::SetMemorySearchResults: {
+            emit memorySearchResults( data.toMap() );
+            break;
+        }
+
+        case Command::SetPerfCounters: {
+            perfCounters = data.toList();
+            emit perfCountersChanged();
+            break;
+        }
+
         default:
             break;
     }
@@ -14,6 +14,9 @@ class ControlOutput : public Node {
         Q_OBJECT
         Q_PROPERTY( State state MEMBER state NOTIFY stateChanged )
 
+        // The core's performance counters, see Node::Command::SetPerfCounters
+        Q_PROPERTY( QVariantList perfCounters MEMBER perfCounters NOTIFY perfCountersChanged )
+
     public:
         explicit ControlOutput( Node *parent = nullptr );
 
@@ -21,9 +24,15 @@ class ControlOutput : public Node {
         void paused();
         void stateChanged( State state );
 
+        // Results of a memory search, see Node::Command::SetMemorySearchResults
+        void memorySearchResults( QVariantMap results );
+
+        void perfCountersChanged();
+
     public slots:
         void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
 
     private:
         State state;
+        QVariantList perfCounters;
 };
@@ -3,6 +3,7 @@
 
 #include <QMetaObject>
 #include <QScreen>
+#include <QTimer>
 
 
 GameConsole::GameConsole( Node *parent ) : Node( parent ),
@@ -16,13 +17,19 @@ GameConsole::GameConsole( Node *parent ) : Node( parent ),
 
     // Dynamic pipeline
     audioOutput( new AudioOutput ),
+    libretroCoreProxy( new LibretroCoreProxy ),
     libretroLoader( new LibretroLoader ),
+    libretroMoviePlayer( new LibretroMoviePlayer ),
+    libretroMovieRecorder( new LibretroMovieRecorder ),
     libretroRunner( new LibretroRunner ),
     libretroVariableForwarder( new LibretroVariableForwarder ) {
 
     // Move all our stuff to the game thread
     audioOutput->moveToThread( gameThread );
+    libretroCoreProxy->moveToThread( gameThread );
     libretroLoader->moveToThread( gameThread );
+    libretroMoviePlayer->moveToThread( gameThread );
+    libretroMovieRecorder->moveToThread( gameThread );
     libretroRunner->moveToThread( gameThread );
     libretroVariableForwarder->moveToThread( gameThread );
     microTimer->moveToThread( gameThread );
@@ -31,6 +38,12 @@ GameConsole::GameConsole( Node *parent ) : Node( parent ),
     sdlUnloader->moveToThread( gameThread );
 
     gameThread->setObjectName( "Game thread" );
+
+    // A core kept loaded after its last game (see keepCoreLoaded) is deinitialized on the game thread as it exits
+    connect( gameThread, &QThread::finished, libretroRunner, [ = ]() {
+        LibretroCoreUnloadWarmCore();
+    }, Qt::DirectConnection );
+
     gameThread->start();
 
     // Connect global pipeline (at least the parts that can be connected at this point)
@@ -138,6 +151,47 @@ void GameConsole::reset() {
     emit commandOut( Command::Reset, QVariant(), nodeCurrentTime() );
 }
 
+void GameConsole::saveState( int slot ) {
+    emit commandOut( Command::SaveState, slot, nodeCurrentTime() );
+}
+
+void GameConsole::loadState( int slot ) {
+    emit commandOut( Command::LoadState, slot, nodeCurrentTime() );
+}
+
+void GameConsole::saveQuickState( int slot ) {
+    emit commandOut( Command::SaveQuickState, slot, nodeCurrentTime() );
+}
+
+void GameConsole::loadQuickState( int slot ) {
+    emit commandOut( Command::LoadQuickState, slot, nodeCurrentTime() );
+}
+
+void GameConsole::searchMemory( QString comparison, int value ) {
+    QVariantMap request;
+    request[ QStringLiteral( "comparison" ) ] = comparison;
+    request[ QStringLiteral( "value" ) ] = value;
+    emit commandOut( Command::SearchMemory, request, nodeCurrentTime() );
+}
+
+void GameConsole::recordMovie( QString path ) {
+    if( !dynamicPipelineReady() ) {
+        qCWarning( phxControl ) << Q_FUNC_INFO << ": No game is loaded, ignoring";
+        return;
+    }
+
+    emit commandOut( Command::RecordMovie, path, nodeCurrentTime() );
+}
+
+void GameConsole::playMovie( QString path ) {
+    if( !dynamicPipelineReady() ) {
+        qCWarning( phxControl ) << Q_FUNC_INFO << ": No game is loaded, ignoring";
+        return;
+    }
+
+    emit commandOut( Command::PlayMovie, path, nodeCurrentTime() );
+}
+
 // Private (Startup)
 
 void GameConsole::load() {
@@ -181,40 +235,85 @@ void GameConsole::loadLibretro() {
     Q_ASSERT_X( videoOutput, "libretro load", "videoOutput was not set!" );
     Q_ASSERT_X( variableModel, "libretro load", "variableModel was not set!" );
 
-    // Disconnect PhoenixWindow from MicroTimer, insert libretroLoader in between
+    // The source may not have been applied yet
+    QVariantMap pendingSource = pendingPropertyChanges.contains( "source" ) ? pendingPropertyChanges[ "source" ].toMap() : source;
+
+    // Out of process, LibretroCoreProxy takes the place of LibretroRunner and the host process has its own LibretroLoader
+    bool outOfProcess = pendingSource[ "outOfProcess" ].toBool();
+    Node *libretroCoreNode = outOfProcess ? static_cast<Node *>( libretroCoreProxy ) : static_cast<Node *>( libretroRunner );
+
+    // Disconnect PhoenixWindow from MicroTimer, insert libretroLoader in between (unless the host process is loading)
     disconnectNodes( phoenixWindow, microTimer );
-    sessionConnections << connectNodes( phoenixWindow, libretroLoader );
-    sessionConnections << connectNodes( libretroLoader, microTimer );
+
+    if( outOfProcess ) {
+        sessionConnections << connectNodes( phoenixWindow, microTimer );
+    } else {
+        sessionConnections << connectNodes( phoenixWindow, libretroLoader );
+        sessionConnections << connectNodes( libretroLoader, microTimer );
+    }
 
     // Disconnect SDLRunner from Remapper, it'll get inserted after LibretroRunner
     disconnectNodes( remapper, sdlUnloader );
 
     // Connect LibretroVariableForwarder to the global pipeline
     sessionConnections << connectNodes( remapper, libretroVariableForwarder );
-    sessionConnections << connectNodes( libretroVariableForwarder, libretroRunner );
+    sessionConnections << connectNodes( libretroVariableForwarder, libretroCoreNode );
 
     // Connect LibretroRunner to its children
 
-    sessionConnections << connectNodes( libretroRunner, audioOutput );
-    sessionConnections << connectNodes( libretroRunner, sdlUnloader );
+    sessionConnections << connectNodes( libretroCoreNode, audioOutput );
+    sessionConnections << connectNodes( libretroCoreNode, sdlUnloader );
 
     // It's very important that ControlOutput is always connected via a queued connection as things that handle
     // state changes (things that listen to ControlOutput) should not be at the top of a stack that contains
     // the function calls that changed the state in the first place. This only really applies when we're single-threaded.
-    sessionConnections << connectNodes( libretroRunner, controlOutput, Qt::QueuedConnection );
+    sessionConnections << connectNodes( libretroCoreNode, controlOutput, Qt::QueuedConnection );
 
-    sessionConnections << connectNodes( libretroRunner, videoOutput );
+    sessionConnections << connectNodes( libretroCoreNode, videoOutput );
+
+    // Movies are recorded and played right next to the core, the host process has its own player and recorder
+    // The player goes first so re-recording a movie records what the player fed in
+    if( !outOfProcess ) {
+        sessionConnections << connectNodes( libretroRunner, libretroMoviePlayer );
+        sessionConnections << connectNodes( libretroRunner, libretroMovieRecorder );
+    }
 
     // Hook LibretroCore so we know when commands have reached it
     // We can't hook ControlOutput as it lives on the main thread and if it's time to quit the main thread's event loop is dead
     // We care about this happening as LibretroCore needs to save its running game before quitting
-    sessionConnections << connect( libretroRunner, &Node::commandOut, libretroRunner, [ & ]( Command command, QVariant, qint64 ) {
+    sessionConnections << connect( libretroCoreNode, &Node::commandOut, libretroCoreNode, [ & ]( Command command, QVariant data, qint64 ) {
         switch( command ) {
             case Command::Stop: {
                 unloadLibretro();
                 break;
             }
 
+            // Sent from the game thread (or the proxy), the properties belong to the main thread
+            // The core may turn run-ahead off if it can't go back to the real frame, and back on for the next game
+            case Command::SetRunAhead: {
+                int frames = data.toInt();
+
+                QTimer::singleShot( 0, this, [ = ]() {
+                    if( runAhead != frames ) {
+                        runAhead = frames;
+                        emit runAheadChanged();
+                    }
+                } );
+                break;
+            }
+
+            case Command::SetMemoryExportName: {
+                QString name = data.toString();
+
+                QTimer::singleShot( 0, this, [ = ]() {
+                    if( memoryExportName != name ) {
+                        memoryExportName = name;
+                        emit memoryExportNameChanged();
+                    }
+                } );
+                break;
+            }
+
             default: {
                 break;
             }
@@ -252,6 +351,18 @@ void GameConsole::applyPendingPropertyChanges() {
         setPlaybackSpeed( pendingPropertyChanges[ "playbackSpeed" ].toReal() );
     }
 
+    if( pendingPropertyChanges.contains( "runAhead" ) ) {
+        setRunAhead( pendingPropertyChanges[ "runAhead" ].toInt() );
+    }
+
+    if( pendingPropertyChanges.contains( "memoryExport" ) ) {
+        setMemoryExport( pendingPropertyChanges[ "memoryExport" ].toInt() );
+    }
+
+    if( pendingPropertyChanges.contains( "keepCoreLoaded" ) ) {
+        setKeepCoreLoaded( pendingPropertyChanges[ "keepCoreLoaded" ].toBool() );
+    }
+
     if( pendingPropertyChanges.contains( "source" ) ) {
         setSource( pendingPropertyChanges[ "source" ].toMap() );
     }
@@ -308,7 +419,10 @@ void GameConsole::deleteLibretro() {
     // Bottom to top
     audioOutput->deleteLater();
     sdlUnloader->deleteLater();
+    libretroCoreProxy->deleteLater();
     libretroLoader->deleteLater();
+    libretroMoviePlayer->deleteLater();
+    libretroMovieRecorder->deleteLater();
     libretroVariableForwarder->deleteLater();
     libretroRunner->deleteLater();
 }
@@ -317,7 +431,10 @@ void GameConsole::deleteMembers() {
     // Delete everything owned by this class
     // Alphabetical order because it doesn't matter
     audioOutput->deleteLater();
+    libretroCoreProxy->deleteLater();
     libretroLoader->deleteLater();
+    libretroMoviePlayer->deleteLater();
+    libretroMovieRecorder->deleteLater();
     libretroRunner->deleteLater();
     libretroVariableForwarder->deleteLater();
     microTimer->deleteLater();
@@ -360,6 +477,65 @@ void GameConsole::setPlaybackSpeed( qreal playbackSpeed ) {
     emit playbackSpeedChanged();
 }
 
+bool GameConsole::getKeepCoreLoaded() {
+    return keepCoreLoaded;
+}
+
+void GameConsole::setKeepCoreLoaded( bool keepCoreLoaded ) {
+    if( !dynamicPipelineReady() ) {
+        qCDebug( phxControl ) << Q_FUNC_INFO << ": Dynamic pipeline not yet fully hooked up, caching change for later...";
+        pendingPropertyChanges[ "keepCoreLoaded" ] = keepCoreLoaded;
+
+        // A core kept loaded from the last game sits in LibretroRunner while stopped, with no pipeline to reach it
+        // through. Tell the runner directly (on the game thread) so turning this off unloads that core right away
+        QTimer::singleShot( 0, libretroRunner, [ = ]() {
+            libretroRunner->commandIn( Command::SetKeepCoreLoaded, keepCoreLoaded, nodeCurrentTime() );
+        } );
+
+        return;
+    }
+
+    this->keepCoreLoaded = keepCoreLoaded;
+    emit commandOut( Command::SetKeepCoreLoaded, keepCoreLoaded, nodeCurrentTime() );
+    emit keepCoreLoadedChanged();
+}
+
+int GameConsole::getMemoryExport() {
+    return memoryExport;
+}
+
+void GameConsole::setMemoryExport( int memoryExport ) {
+    if( !dynamicPipelineReady() ) {
+        qCDebug( phxControl ) << Q_FUNC_INFO << ": Dynamic pipeline not yet fully hooked up, caching change for later...";
+        pendingPropertyChanges[ "memoryExport" ] = memoryExport;
+        return;
+    }
+
+    this->memoryExport = memoryExport;
+    emit commandOut( Command::SetMemoryExport, memoryExport, nodeCurrentTime() );
+    emit memoryExportChanged();
+}
+
+QString GameConsole::getMemoryExportName() {
+    return memoryExportName;
+}
+
+int GameConsole::getRunAhead() {
+    return runAhead;
+}
+
+void GameConsole::setRunAhead( int runAhead ) {
+    if( !dynamicPipelineReady() ) {
+        qCDebug( phxControl ) << Q_FUNC_INFO << ": Dynamic pipeline not yet fully hooked up, caching change for later...";
+        pendingPropertyChanges[ "runAhead" ] = runAhead;
+        return;
+    }
+
+    this->runAhead = runAhead;
+    emit commandOut( Command::SetRunAhead, runAhead, nodeCurrentTime() );
+    emit runAheadChanged();
+}
+
 QVariantMap GameConsole::getSource() {
     return source;
 }
@@ -12,7 +12,10 @@
 #include "sdlmanager.h"
 #include "controloutput.h"
 #include "globalgamepad.h"
+#include "libretrocoreproxy.h"
 #include "libretroloader.h"
+#include "libretromovieplayer.h"
+#include "libretromovierecorder.h"
 #include "libretrorunner.h"
 #include "microtimer.h"
 #include "phoenixwindow.h"
@@ -52,7 +55,11 @@ class GameConsole : public Node {
         Q_PROPERTY( VideoOutputNode *videoOutput MEMBER videoOutput NOTIFY videoOutputChanged )
 
         Q_PROPERTY( int aspectRatioMode READ getAspectRatioMode WRITE setAspectRatioMode NOTIFY aspectRatioModeChanged )
+        Q_PROPERTY( bool keepCoreLoaded READ getKeepCoreLoaded WRITE setKeepCoreLoaded NOTIFY keepCoreLoadedChanged )
+        Q_PROPERTY( int memoryExport READ getMemoryExport WRITE setMemoryExport NOTIFY memoryExportChanged )
+        Q_PROPERTY( QString memoryExportName READ getMemoryExportName NOTIFY memoryExportNameChanged )
         Q_PROPERTY( qreal playbackSpeed READ getPlaybackSpeed WRITE setPlaybackSpeed NOTIFY playbackSpeedChanged )
+        Q_PROPERTY( int runAhead READ getRunAhead WRITE setRunAhead NOTIFY runAheadChanged )
         Q_PROPERTY( QVariantMap source READ getSource WRITE setSource NOTIFY sourceChanged )
         Q_PROPERTY( qreal volume READ getVolume WRITE setVolume NOTIFY volumeChanged )
         Q_PROPERTY( bool vsync READ getVsync WRITE setVsync NOTIFY vsyncChanged )
@@ -71,6 +78,22 @@ class GameConsole : public Node {
         void stop();
         void reset();
 
+        // Save states, slots are numbered from 0
+        // Quick states are kept in memory and are lost once the game is stopped
+        void saveState( int slot );
+        void loadState( int slot );
+        void saveQuickState( int slot );
+        void loadQuickState( int slot );
+
+        // Search the game's RAM (see Node::Command::SearchMemory for comparisons), results arrive through
+        // ControlOutput::memorySearchResults()
+        void searchMemory( QString comparison, int value = 0 );
+
+        // Record the game's input into a movie file / replay one in place of the controllers (see
+        // Node::Command::RecordMovie and PlayMovie). An empty path stops recording/playback
+        void recordMovie( QString path );
+        void playMovie( QString path );
+
     private: // Startup
         void load();
 
@@ -127,7 +150,11 @@ class GameConsole : public Node {
         //     - Add to deleteMembers() and to delete_____() for each core type (dynamic pipeline) it's used by
         //     - Move to gameThread in the constructor
         AudioOutput *audioOutput { nullptr };
+        // Only one session at a time, out of process or not
+        LibretroCoreProxy *libretroCoreProxy { nullptr };
         LibretroLoader *libretroLoader { nullptr };
+        LibretroMoviePlayer *libretroMoviePlayer { nullptr };
+        LibretroMovieRecorder *libretroMovieRecorder { nullptr };
         LibretroRunner *libretroRunner { nullptr };
         LibretroVariableForwarder *libretroVariableForwarder { nullptr };
 
@@ -145,9 +172,20 @@ class GameConsole : public Node {
         int aspectRatioMode { 0 };
         int getAspectRatioMode();
         void setAspectRatioMode( int aspectRatioMode );
+        bool keepCoreLoaded { false };
+        bool getKeepCoreLoaded();
+        void setKeepCoreLoaded( bool keepCoreLoaded );
+        int memoryExport { 0 };
+        int getMemoryExport();
+        void setMemoryExport( int memoryExport );
+        QString memoryExportName;
+        QString getMemoryExportName();
         qreal playbackSpeed { 1.0 };
         qreal getPlaybackSpeed();
         void setPlaybackSpeed( qreal playbackSpeed );
+        int runAhead { 0 };
+        int getRunAhead();
+        void setRunAhead( int runAhead );
         QVariantMap source;
         QVariantMap getSource();
         void setSource( QVariantMap source );
@@ -168,7 +206,11 @@ class GameConsole : public Node {
         void variableModelChanged();
 
         void aspectRatioModeChanged();
+        void keepCoreLoadedChanged();
+        void memoryExportChanged();
+        void memoryExportNameChanged();
         void playbackSpeedChanged();
+        void runAheadChanged();
         void sourceChanged();
         void volumeChanged();
         void vsyncChanged();
@@ -13,7 +13,9 @@ using QStringMap = QMap<QString, QString>;
  *
  * Core is a producer of both audio and video data. At regular intervals, Core will send out signals containing pointers
  * to buffers. These pointers will internally be part of a circular buffer that will remain valid for the lifetime of Core.
- * To safely copy their contents, obtain a lock using either audioMutex or videoMutex.
+ * To safely copy video, lock the mutex sent along with it. Hardware-rendered video is sent as LibretroGLFrames instead,
+ * handed back and forth with fences (take frames from a single consumer). Audio is sent as a pointer to an AudioRing,
+ * read from it (from a single consumer) instead.
  *
  * Core is also a consumer of input data.
  */
@@ -1,4 +1,5 @@
 #include "libretrocore.h"
+#include "hash64.h"
 #include "SDL.h"
 #include "SDL_gamecontroller.h"
 #include "SDL_haptic.h"
@@ -50,6 +51,9 @@ void LibretroCore::getAVInfo( retro_system_av_info *avInfo ) {
     libretroCore.videoFormat.videoBytesPerLine = avInfo->geometry.base_width * libretroCore.videoFormat.videoBytesPerPixel;
     libretroCore.videoFormat.videoFramerate = avInfo->timing.fps;
 
+    // Flush audio every ~1/2 of a frame's worth of data
+    libretroCore.audioFlushFrames = static_cast<size_t>( libretroCore.audioSampleRate / libretroCore.videoFormat.videoFramerate / 2 );
+
     libretroCore.videoFormat.videoSize.setWidth( avInfo->geometry.base_width );
     libretroCore.videoFormat.videoSize.setHeight( avInfo->geometry.base_height );
 
@@ -67,20 +71,25 @@ void LibretroCore::getAVInfo( retro_system_av_info *avInfo ) {
 
 LibretroCore libretroCore;
 
+QString LibretroCoreSaveDataPath() {
+    return libretroCore.savePathInfo.absolutePath() % QStringLiteral( "/" ) %
+           libretroCore.gameFileInfo.baseName() % QStringLiteral( ".sav" );
+}
+
 void LibretroCoreLoadSaveData() {
     libretroCore.saveDataBuf = ( libretroCore.symbols.retro_get_memory_data )( RETRO_MEMORY_SAVE_RAM );
+    libretroCore.saveDataSize = libretroCore.saveDataBuf ? libretroCore.symbols.retro_get_memory_size( RETRO_MEMORY_SAVE_RAM ) : 0;
 
     if( !libretroCore.saveDataBuf ) {
         qCInfo( phxCore ) << "The core will handle saving (passed a null pointer when asked for save buffer)";
         return;
     }
 
-    QFile file( libretroCore.savePathInfo.absolutePath() % QStringLiteral( "/" ) %
-                libretroCore.gameFileInfo.baseName() % QStringLiteral( ".sav" ) );
+    QFile file( LibretroCoreSaveDataPath() );
 
     if( file.open( QIODevice::ReadOnly ) ) {
         QByteArray data = file.readAll();
-        memcpy( libretroCore.saveDataBuf, data.data(), data.size() );
+        memcpy( libretroCore.saveDataBuf, data.data(), qMin( static_cast<size_t>( data.size() ), libretroCore.saveDataSize ) );
 
         qCDebug( phxCore ) << Q_FUNC_INFO << file.fileName() << "(true)";
         file.close();
@@ -89,144 +98,418 @@ void LibretroCoreLoadSaveData() {
     else {
         qCDebug( phxCore ) << Q_FUNC_INFO << file.fileName() << "(false)";
     }
+
+    // Whatever's in there now matches what's on disk (or is the core's blank save data), no need to write it back out
+    libretroCore.saveDataHash = hash64( libretroCore.saveDataBuf, libretroCore.saveDataSize );
 }
 
-void LibretroCoreStoreSaveData() {
-    QString localFile = libretroCore.savePathInfo.absolutePath() % QStringLiteral( "/" ) %
-                        libretroCore.gameFileInfo.baseName() % QStringLiteral( ".sav" );
+bool LibretroCoreSnapshotSaveData( QByteArray &buffer ) {
+    if( !libretroCore.saveDataBuf || !libretroCore.saveDataSize ) {
+        return false;
+    }
 
-    qCDebug( phxCore ).nospace() << "Saving: " << localFile;
+    quint64 hash = hash64( libretroCore.saveDataBuf, libretroCore.saveDataSize );
 
-    if( libretroCore.saveDataBuf == nullptr ) {
-        qCDebug( phxCore ).nospace() << "Skipping, the core has done the save by itself";
-        return;
+    if( hash == libretroCore.saveDataHash ) {
+        return false;
     }
 
-    QFile file( localFile );
+    buffer = QByteArray( static_cast<const char *>( libretroCore.saveDataBuf ), static_cast<int>( libretroCore.saveDataSize ) );
+    libretroCore.saveDataHash = hash;
+    return true;
+}
 
-    if( file.open( QIODevice::WriteOnly ) ) {
-        char *data = static_cast<char *>( libretroCore.saveDataBuf );
-        size_t size = libretroCore.symbols.retro_get_memory_size( RETRO_MEMORY_SAVE_RAM );
-        file.write( data, size );
-        file.close();
-        qCDebug( phxCore ) << "Save successful";
-    }
+bool LibretroCoreUnserialize( const void *data, size_t size ) {
+    libretroCore.memoryExport.beginFrames();
+    bool unserialized = libretroCore.symbols.retro_unserialize( data, size );
+    libretroCore.memoryExport.endFrames( libretroCore.frameCount );
+    return unserialized;
+}
 
-    else {
-        qCDebug( phxCore ).nospace() << "Failed: " << file.errorString();
-    }
+QString LibretroCoreStatePath( int slot ) {
+    return libretroCore.savePathInfo.absolutePath() % QStringLiteral( "/" ) %
+           libretroCore.gameFileInfo.baseName() % QStringLiteral( ".state" ) % QString::number( slot );
 }
 
 void LibretroCoreGrowBufferPool( retro_system_av_info *avInfo ) {
     // Allocate a bit extra as some cores' numbers do not add up...
     // Assume 16-bit stereo audio, 32-bit video
-    size_t newAudioSize = static_cast<size_t>( avInfo->timing.sample_rate * 3 );
+    size_t newAudioFrames = static_cast<size_t>( avInfo->timing.sample_rate / 2 );
     size_t newVideoSize = static_cast<size_t>( avInfo->geometry.max_width * avInfo->geometry.max_height * 4 );
 
     // Reallocate buffers if necessary
 
-    if( newAudioSize > libretroCore.audioPoolIndividualBufferSize ) {
-        libretroCore.audioMutex.lock();
-
-        qDebug() << "Growing audio buffer pool buffers from" << libretroCore.audioPoolIndividualBufferSize << "to" << newAudioSize;
-
-        libretroCore.audioPoolIndividualBufferSize = newAudioSize;
-
-        for( int i = 0; i < POOL_SIZE; i++ ) {
-            libretroCore.audioBufferPool[ i ] = new int16_t[ newAudioSize ]();
-        }
-
-        libretroCore.audioMutex.unlock();
+    // ~500ms of audio, rounded up to a power of two
+    // An attached ring was sized by whoever owns it
+    if( !libretroCore.audioRing.isExternal() && newAudioFrames > libretroCore.audioRing.capacity() ) {
+        qDebug() << "Growing audio ring from" << libretroCore.audioRing.capacity() << "to at least" << newAudioFrames << "frames";
+        libretroCore.audioRing.init( newAudioFrames );
     }
 
     if( newVideoSize > libretroCore.videoPoolIndividualBufferSize ) {
-        libretroCore.videoMutex.lock();
+        LibretroCoreReturnSoftwareFramebuffer();
+
+        for( QMutex &mutex : libretroCore.videoMutexes ) {
+            mutex.lock();
+        }
 
         qDebug() << "Growing video buffer pool buffers from" << libretroCore.videoPoolIndividualBufferSize << "to" << newVideoSize;
 
         libretroCore.videoPoolIndividualBufferSize = newVideoSize;
+        libretroCore.videoPoolSequences = nullptr;
+
+        uint8_t *block = libretroCore.videoPoolAllocator ? libretroCore.videoPoolAllocator( newVideoSize * POOL_SIZE ) : nullptr;
+        libretroCore.videoPoolExternal = block != nullptr;
 
         for( int i = 0; i < POOL_SIZE; i++ ) {
-            libretroCore.videoBufferPool[ i ] = new quint8[ newVideoSize ]();
+            libretroCore.videoBufferPool[ i ] = block ? block + i * newVideoSize : new quint8[ newVideoSize ]();
         }
 
-        libretroCore.videoMutex.unlock();
+        for( QMutex &mutex : libretroCore.videoMutexes ) {
+            mutex.unlock();
+        }
     }
 }
 
 void LibretroCoreFreeBufferPool() {
-    libretroCore.audioMutex.lock();
+    libretroCore.audioRing.free();
+
+    LibretroCoreReturnSoftwareFramebuffer();
+
+    for( QMutex &mutex : libretroCore.videoMutexes ) {
+        mutex.lock();
+    }
 
     for( int i = 0; i < POOL_SIZE; i++ ) {
-        delete libretroCore.audioBufferPool[ i ];
-        libretroCore.audioBufferPool[ i ] = nullptr;
+        if( !libretroCore.videoPoolExternal ) {
+            delete libretroCore.videoBufferPool[ i ];
+        }
+
+        libretroCore.videoBufferPool[ i ] = nullptr;
     }
 
-    libretroCore.audioPoolIndividualBufferSize = 0;
+    libretroCore.videoPoolIndividualBufferSize = 0;
+    libretroCore.videoPoolExternal = false;
+    libretroCore.videoPoolSequences = nullptr;
+
+    for( QMutex &mutex : libretroCore.videoMutexes ) {
+        mutex.unlock();
+    }
+}
 
-    libretroCore.audioMutex.unlock();
+void LibretroCoreAllocateFramebuffers( QSize size ) {
+    LibretroCoreFreeFramebuffers();
 
-    libretroCore.videoMutex.lock();
+    libretroCore.glFences.init( libretroCore.context );
+    libretroCore.fboSize = size;
 
-    for( int i = 0; i < POOL_SIZE; i++ ) {
-        delete libretroCore.videoBufferPool[ i ];
-        libretroCore.videoBufferPool[ i ] = nullptr;
+    for( int i = 0; i < LIBRETRO_FBO_COUNT; i++ ) {
+        libretroCore.fbos[ i ] = LibretroCoreTakeFramebuffer( size );
+
+        LibretroGLFrame &frame = libretroCore.glFrames.slot( i );
+        frame.index = i;
+        frame.texture = libretroCore.fbos[ i ]->texture();
+        frame.textureSize = size;
+        frame.size = size;
     }
 
-    libretroCore.videoPoolIndividualBufferSize = 0;
+    // Whatever the last game left behind that this one didn't take won't be used
+    qDeleteAll( libretroCore.fboPool );
+    libretroCore.fboPool.clear();
+
+    libretroCore.fbo = libretroCore.fbos[ libretroCore.glFrames.writeSlot().index ];
+    libretroCore.fbo->bind();
+}
+
+void LibretroCoreFreeFramebuffers() {
+    if( !libretroCore.fbo ) {
+        return;
+    }
+
+    // Fences can only be deleted with a context current
+    if( libretroCore.context && libretroCore.surface ) {
+        libretroCore.context->makeCurrent( libretroCore.surface );
+    }
+
+    for( int i = 0; i < LIBRETRO_FBO_COUNT; i++ ) {
+        LibretroGLFrame &frame = libretroCore.glFrames.slot( i );
+        libretroCore.glFences.remove( frame.ready );
+        libretroCore.glFences.remove( frame.released );
+        frame = LibretroGLFrame();
+
+        LibretroCoreReturnFramebuffer( libretroCore.fbos[ i ] );
+        libretroCore.fbos[ i ] = nullptr;
+    }
+
+    libretroCore.fbo = nullptr;
+    libretroCore.fboSize = QSize();
+}
+
+void LibretroCoreFreeFramebufferPool() {
+    if( libretroCore.fboPool.isEmpty() ) {
+        return;
+    }
+
+    if( libretroCore.context && libretroCore.surface ) {
+        libretroCore.context->makeCurrent( libretroCore.surface );
+    }
+
+    qDeleteAll( libretroCore.fboPool );
+    libretroCore.fboPool.clear();
+}
+
+QOpenGLFramebufferObject *LibretroCoreTakeFramebuffer( QSize size ) {
+    quint64 key = LibretroCoreFramebufferKey( size, libretroCore.fboAttachment );
+    QOpenGLFramebufferObject *fbo = libretroCore.fboPool.take( key );
+
+    if( !fbo ) {
+        qCDebug( phxCore ) << "Allocating a" << size << "FBO";
+
+        fbo = new QOpenGLFramebufferObject( size, libretroCore.fboAttachment );
+
+        // Clear the newly created FBO
+        fbo->bind();
+        libretroCore.context->functions()->glClear( GL_COLOR_BUFFER_BIT );
+    }
+
+    return fbo;
+}
+
+void LibretroCoreReturnFramebuffer( QOpenGLFramebufferObject *fbo ) {
+    libretroCore.fboPool.insert( LibretroCoreFramebufferKey( fbo->size(), fbo->attachment() ), fbo );
+}
+
+quint64 LibretroCoreFramebufferKey( QSize size, QOpenGLFramebufferObject::Attachment attachment ) {
+    return ( static_cast<quint64>( size.width() ) << 32 ) | ( static_cast<quint64>( size.height() ) << 2 )
+           | static_cast<quint64>( attachment );
+}
+
+void LibretroCoreBindFramebuffer() {
+    if( !libretroCore.fbo ) {
+        return;
+    }
+
+    LibretroGLFrame &frame = libretroCore.glFrames.writeSlot();
+
+    // Don't draw over the texture until the render thread is done sampling it
+    libretroCore.glFences.wait( frame.released );
+    libretroCore.glFences.remove( frame.released );
+    frame.released = nullptr;
+
+    // Published but overwritten by a newer frame before the render thread got to it
+    libretroCore.glFences.remove( frame.ready );
+    frame.ready = nullptr;
+
+    QOpenGLFramebufferObject *&fbo = libretroCore.fbos[ frame.index ];
+    QSize videoSize = libretroCore.videoFormat.videoSize;
+
+    // Cores can change the size of the video they output at any time. FBOs are as big as the core said its video could
+    // get so that usually only changes how much of one is shown, a core going past that gets bigger ones. The FBO is
+    // ours alone so swap it now. The one left behind is too small to ever be used again, don't pool it
+    if( videoSize.isValid() && ( videoSize.width() > fbo->width() || videoSize.height() > fbo->height() ) ) {
+        libretroCore.fboSize = libretroCore.fboSize.expandedTo( videoSize );
+
+        delete fbo;
+        fbo = LibretroCoreTakeFramebuffer( libretroCore.fboSize );
+
+        frame.texture = fbo->texture();
+        frame.textureSize = fbo->size();
+    }
+
+    libretroCore.fbo = fbo;
+    libretroCore.fbo->bind();
+}
+
+void LibretroCorePublishFramebuffer() {
+    if( !libretroCore.fbo ) {
+        return;
+    }
+
+    // The core drew into the bottom-left corner of the FBO (its viewport), that's the frame
+    LibretroGLFrame &frame = libretroCore.glFrames.writeSlot();
+    frame.size = libretroCore.videoFormat.videoSize.boundedTo( frame.textureSize );
+    frame.ready = libretroCore.glFences.insert();
+
+    // Without fences the only way to be sure the frame is done before the render thread samples it
+    if( !frame.ready ) {
+        libretroCore.context->functions()->glFinish();
+    }
+
+    libretroCore.glFrames.publish();
+    LibretroCoreBindFramebuffer();
+}
+
+void LibretroCoreUnloadCore() {
+    libretroCore.symbols.retro_deinit();
+    libretroCore.symbols.clear();
+    libretroCore.coreFile.unload();
+    libretroCore.warmCorePath.clear();
+
+    // The counters were the core's statics
+    libretroCore.perf.clear();
+}
+
+void LibretroCoreUnloadWarmCore() {
+    if( libretroCore.warmCorePath.isEmpty() ) {
+        return;
+    }
+
+    qCDebug( phxCore ) << "Unloading core kept loaded:" << libretroCore.warmCorePath;
+    LibretroCoreUnloadCore();
+}
+
+void LibretroCoreFlushAudio() {
+    size_t frames = libretroCore.audioRing.pendingFrames();
+    qint64 timeStamp = nodeCurrentTime();
+
+    // If the consumer is too far behind to take another chunk, the frames stay pending and go out with the next flush
+    if( libretroCore.audioRing.commit( timeStamp ) ) {
+        libretroCore.fireDataOut( Node::DataType::Audio, nullptr, &libretroCore.audioRing, frames * 4, timeStamp );
+    }
+}
+
+void LibretroCoreUpdatePortState( const GamepadState &gamepad ) {
+    LibretroCoreSetPortState( gamepad.instanceID, LibretroCoreMakePortState( gamepad ) );
+}
 
-    libretroCore.videoMutex.unlock();
+LibretroPortState LibretroCoreMakePortState( const GamepadState &gamepad ) {
+    // SDL buttons in RETRO_DEVICE_ID_JOYPAD_* order, -1 for L2/R2 which are digitalL2/R2
+    static const int joypadButtons[ RETRO_DEVICE_ID_JOYPAD_R3 + 1 ] = {
+        SDL_CONTROLLER_BUTTON_B,
+        SDL_CONTROLLER_BUTTON_Y,
+        SDL_CONTROLLER_BUTTON_BACK,
+        SDL_CONTROLLER_BUTTON_START,
+        SDL_CONTROLLER_BUTTON_DPAD_UP,
+        SDL_CONTROLLER_BUTTON_DPAD_DOWN,
+        SDL_CONTROLLER_BUTTON_DPAD_LEFT,
+        SDL_CONTROLLER_BUTTON_DPAD_RIGHT,
+        SDL_CONTROLLER_BUTTON_A,
+        SDL_CONTROLLER_BUTTON_X,
+        SDL_CONTROLLER_BUTTON_LEFTSHOULDER,
+        SDL_CONTROLLER_BUTTON_RIGHTSHOULDER,
+        -1,
+        -1,
+        SDL_CONTROLLER_BUTTON_LEFTSTICK,
+        SDL_CONTROLLER_BUTTON_RIGHTSTICK,
+    };
+
+    LibretroPortState snapshot {};
+
+    for( int id = 0; id <= RETRO_DEVICE_ID_JOYPAD_R3; id++ ) {
+        bool pressed = joypadButtons[ id ] >= 0 ? gamepad.button[ joypadButtons[ id ] ] : false;
+        pressed |= id == RETRO_DEVICE_ID_JOYPAD_L2 && gamepad.digitalL2;
+        pressed |= id == RETRO_DEVICE_ID_JOYPAD_R2 && gamepad.digitalR2;
+        snapshot.buttons |= pressed << id;
+    }
+
+    snapshot.analog[ RETRO_DEVICE_INDEX_ANALOG_LEFT ][ RETRO_DEVICE_ID_ANALOG_X ] = gamepad.axis[ SDL_CONTROLLER_AXIS_LEFTX ];
+    snapshot.analog[ RETRO_DEVICE_INDEX_ANALOG_LEFT ][ RETRO_DEVICE_ID_ANALOG_Y ] = gamepad.axis[ SDL_CONTROLLER_AXIS_LEFTY ];
+    snapshot.analog[ RETRO_DEVICE_INDEX_ANALOG_RIGHT ][ RETRO_DEVICE_ID_ANALOG_X ] = gamepad.axis[ SDL_CONTROLLER_AXIS_RIGHTX ];
+    snapshot.analog[ RETRO_DEVICE_INDEX_ANALOG_RIGHT ][ RETRO_DEVICE_ID_ANALOG_Y ] = gamepad.axis[ SDL_CONTROLLER_AXIS_RIGHTY ];
+
+    return snapshot;
+}
+
+void LibretroCoreSetPortState( int instanceID, const LibretroPortState &snapshot ) {
+    // Plug the controller in if this is the first we've heard from it
+    if( !libretroCore.gamepadPorts.contains( instanceID ) ) {
+        int port = 0;
+
+        if( instanceID != -1 ) {
+            QList<int> taken = libretroCore.gamepadPorts.values();
+            taken.removeOne( libretroCore.gamepadPorts.value( -1, -1 ) );
+
+            while( port < LIBRETRO_MAX_PORTS && taken.contains( port ) ) {
+                port++;
+            }
+
+            // Out of ports, this controller won't do anything
+            if( port == LIBRETRO_MAX_PORTS ) {
+                return;
+            }
+        }
+
+        qCDebug( phxCore ) << "Controller" << instanceID << "plugged into port" << port;
+        libretroCore.gamepadPorts[ instanceID ] = port;
+    }
+
+    libretroCore.gamepadSnapshots[ instanceID ] = snapshot;
+    LibretroCoreRebuildPort( libretroCore.gamepadPorts[ instanceID ] );
+}
+
+void LibretroCoreReleasePort( int instanceID ) {
+    if( !libretroCore.gamepadPorts.contains( instanceID ) ) {
+        return;
+    }
+
+    int port = libretroCore.gamepadPorts.take( instanceID );
+    libretroCore.gamepadSnapshots.remove( instanceID );
+    LibretroCoreRebuildPort( port );
+
+    qCDebug( phxCore ) << "Controller" << instanceID << "unplugged from port" << port;
+}
+
+void LibretroCoreRebuildPort( int port ) {
+    LibretroPortState merged {};
+
+    // Usually one controller, two if the keyboard is on this port too
+    for( auto it = libretroCore.gamepadPorts.constBegin(); it != libretroCore.gamepadPorts.constEnd(); ++it ) {
+        if( it.value() != port ) {
+            continue;
+        }
+
+        const LibretroPortState &snapshot = libretroCore.gamepadSnapshots[ it.key() ];
+        merged.buttons |= snapshot.buttons;
+
+        // Whichever stick is pushed furthest wins
+        for( int stick = 0; stick < 2; stick++ ) {
+            for( int axis = 0; axis < 2; axis++ ) {
+                if( qAbs( static_cast<int>( snapshot.analog[ stick ][ axis ] ) ) > qAbs( static_cast<int>( merged.analog[ stick ][ axis ] ) ) ) {
+                    merged.analog[ stick ][ axis ] = snapshot.analog[ stick ][ axis ];
+                }
+            }
+        }
+    }
+
+    libretroCore.ports[ port ] = merged;
+}
+
+void LibretroCorePublishVariables() {
+    // Special case: Force DeSmuME's pointer type variable to "touch" in order to work with our touch code
+    if( libretroCore.variables.contains( "desmume_pointer_type" ) ) {
+        libretroCore.variables[ "desmume_pointer_type" ].setValue( QByteArrayLiteral( "touch" ) );
+    }
+
+    std::shared_ptr<const LibretroVariableTable> table = std::make_shared<const LibretroVariableTable>( libretroCore.variables );
+    std::atomic_store( &libretroCore.publishedVariables, table );
+    libretroCore.variablesGeneration.fetch_add( 1, std::memory_order_release );
 }
 
 // Callbacks
 
 void LibretroCoreAudioSampleCallback( int16_t left, int16_t right ) {
-    // Sanity check
-    Q_ASSERT_X( libretroCore.audioBufferCurrentByte < libretroCore.audioSampleRate * 5,
-                "audio batch callback", QString( "Buffer pool overflow (%1)" ).arg( libretroCore.audioBufferCurrentByte ).toLocal8Bit() );
-
-    // Stereo audio is interleaved, left then right
-    libretroCore.audioMutex.lock();
-    libretroCore.audioBufferPool[ libretroCore.audioPoolCurrentBuffer ][ libretroCore.audioBufferCurrentByte / 2 ] = left;
-    libretroCore.audioBufferPool[ libretroCore.audioPoolCurrentBuffer ][ libretroCore.audioBufferCurrentByte / 2 + 1 ] = right;
-    libretroCore.audioMutex.unlock();
+    if( libretroCore.audioSuppressed ) {
+        return;
+    }
 
-    // Each frame is 4 bytes (16-bit stereo)
-    libretroCore.audioBufferCurrentByte += 4;
+    libretroCore.audioRing.writeFrame( left, right );
 
     // Flush if we have more than 1/2 of a frame's worth of data
-    if( libretroCore.audioBufferCurrentByte > libretroCore.audioSampleRate * 4 / libretroCore.videoFormat.videoFramerate / 2 ) {
-        libretroCore.fireDataOut( Node::DataType::Audio, &libretroCore.audioMutex, &libretroCore.audioBufferPool[ libretroCore.audioPoolCurrentBuffer ],
-                                  libretroCore.audioBufferCurrentByte, nodeCurrentTime() );
-        libretroCore.audioBufferCurrentByte = 0;
-        libretroCore.audioPoolCurrentBuffer = ( libretroCore.audioPoolCurrentBuffer + 1 ) % POOL_SIZE;
+    if( libretroCore.audioRing.pendingFrames() > libretroCore.audioFlushFrames ) {
+        LibretroCoreFlushAudio();
     }
 }
 
 size_t LibretroCoreAudioSampleBatchCallback( const int16_t *data, size_t frames ) {
-    // Sanity check
-    Q_ASSERT_X( libretroCore.audioBufferCurrentByte < libretroCore.audioSampleRate * 5,
-                "audio batch callback",
-                QString( "Buffer pool overflow (%1)" ).arg( libretroCore.audioBufferCurrentByte ).toLocal8Bit() );
-
-    // Need to do a bit of pointer arithmetic to get the right offset (the buffer is indexed in increments of shorts -- 2 bytes)
-    int16_t *dst_init = libretroCore.audioBufferPool[ libretroCore.audioPoolCurrentBuffer ];
-    int16_t *dst = dst_init + ( libretroCore.audioBufferCurrentByte / 2 );
-
-    // Copy the incoming data
-    libretroCore.audioMutex.lock();
-    memcpy( dst, data, frames * 4 );
-    libretroCore.audioMutex.unlock();
+    if( libretroCore.audioSuppressed ) {
+        return frames;
+    }
 
-    // Each frame is 4 bytes (16-bit stereo)
-    libretroCore.audioBufferCurrentByte += frames * 4;
+    libretroCore.audioRing.write( data, frames );
 
     // Flush if we have 1/2 of a frame's worth of data or more
-    if( libretroCore.audioBufferCurrentByte >= libretroCore.audioSampleRate * 4 / libretroCore.videoFormat.videoFramerate / 2 ) {
-        libretroCore.fireDataOut( Node::DataType::Audio, &libretroCore.audioMutex, &libretroCore.audioBufferPool[ libretroCore.audioPoolCurrentBuffer ],
-                                  libretroCore.audioBufferCurrentByte, nodeCurrentTime() );
-        libretroCore.audioBufferCurrentByte = 0;
-        libretroCore.audioPoolCurrentBuffer = ( libretroCore.audioPoolCurrentBuffer + 1 ) % POOL_SIZE;
+    if( libretroCore.audioRing.pendingFrames() >= libretroCore.audioFlushFrames ) {
+        LibretroCoreFlushAudio();
     }
 
     return frames;
@@ -326,6 +609,12 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
         case RETRO_ENVIRONMENT_SET_HW_RENDER: { // 14
             qDebug() << "\tRETRO_ENVIRONMENT_SET_HW_RENDER (14) (handled)";
 
+            // No OpenGL available (headless)
+            if( !libretroCore.context || !libretroCore.surface ) {
+                qWarning() << "\t\tNo OpenGL context was provided, hardware rendering is unavailable";
+                return false;
+            }
+
             libretroCore.videoFormat.videoMode = HARDWARERENDER;
 
             retro_hw_render_callback *hardwareRenderData = static_cast<retro_hw_render_callback *>( data );
@@ -333,6 +622,11 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
             hardwareRenderData->get_current_framebuffer = LibretroCoreGetFramebufferCallback;
             hardwareRenderData->get_proc_address = LibretroCoreOpenGLProcAddressCallback;
 
+            // Give the core's FBOs the buffers it asked for
+            libretroCore.fboAttachment = hardwareRenderData->stencil ? QOpenGLFramebufferObject::CombinedDepthStencil :
+                                         hardwareRenderData->depth ? QOpenGLFramebufferObject::Depth :
+                                         QOpenGLFramebufferObject::NoAttachment;
+
             libretroCore.symbols.retro_hw_context_reset = hardwareRenderData->context_reset;
 
             switch( hardwareRenderData->context_type ) {
@@ -428,21 +722,25 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
             // qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_VARIABLE (15)(handled)";
             auto *retroVariable = static_cast<struct retro_variable *>( data );
 
-            if( libretroCore.variables.contains( retroVariable->key ) ) {
-                const auto &var = libretroCore.variables[ retroVariable->key ];
-
-                if( var.isValid() ) {
-                    retroVariable->value = var.value().data();
+            // Pick up the latest snapshot if there's been a publish since we last looked
+            quint64 generation = libretroCore.variablesGeneration.load( std::memory_order_acquire );
 
-                    if( !var.value().isEmpty() ) {
-                        //qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_VARIABLE (15)(handled)" << var.key().c_str() << var.value().c_str();
-                        return true;
-                    }
-                }
+            if( generation != libretroCore.activeVariablesGeneration ) {
+                libretroCore.retiredVariables = libretroCore.activeVariables;
+                libretroCore.activeVariables = std::atomic_load( &libretroCore.publishedVariables );
+                libretroCore.activeVariablesGeneration = generation;
             }
 
+            const char *value = libretroCore.activeVariables ? libretroCore.activeVariables->value( retroVariable->key ) : nullptr;
+
             // Variable was not found
-            return false;
+            if( !value ) {
+                return false;
+            }
+
+            //qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_VARIABLE (15)(handled)" << retroVariable->key << value;
+            retroVariable->value = value;
+            return true;
         }
 
         case RETRO_ENVIRONMENT_SET_VARIABLES: { // 16
@@ -458,6 +756,7 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
 
             }
 
+            LibretroCorePublishVariables();
             return true;
         }
 
@@ -466,11 +765,6 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
             // Let the core know we have some variable changes if we set our internal flag (clear it so the change only happens once)
             // TODO: Protect all variable-touching code with mutexes?
             if( libretroCore.variablesAreDirty ) {
-                // Special case: Force DeSmuME's pointer type variable to "touch" in order to work with our touch code
-                if( libretroCore.variables.contains( "desmume_pointer_type" ) ) {
-                    libretroCore.variables[ "desmume_pointer_type" ].setValue( QByteArrayLiteral( "touch" ) );
-                }
-
                 libretroCore.variablesAreDirty = false;
                 *static_cast<bool *>( data ) = true;
                 return true;
@@ -539,13 +833,13 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
 
         case RETRO_ENVIRONMENT_GET_PERF_INTERFACE: { // 28
             qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_PERF_INTERFACE (28) (handled)";
-            libretroCore.performanceCallback.get_cpu_features = 0;
-            libretroCore.performanceCallback.get_perf_counter = 0;
-            libretroCore.performanceCallback.get_time_usec = 0;
-            libretroCore.performanceCallback.perf_log = 0;
-            libretroCore.performanceCallback.perf_register = 0;
-            libretroCore.performanceCallback.perf_start = 0;
-            libretroCore.performanceCallback.perf_stop = 0;
+            libretroCore.performanceCallback.get_cpu_features = LibretroPerf::cpuFeatures;
+            libretroCore.performanceCallback.get_perf_counter = LibretroPerf::ticks;
+            libretroCore.performanceCallback.get_time_usec = LibretroPerf::timeUsec;
+            libretroCore.performanceCallback.perf_log = LibretroCorePerfLogCallback;
+            libretroCore.performanceCallback.perf_register = LibretroCorePerfRegisterCallback;
+            libretroCore.performanceCallback.perf_start = LibretroCorePerfStartCallback;
+            libretroCore.performanceCallback.perf_stop = LibretroCorePerfStopCallback;
             *( retro_perf_callback * )data = libretroCore.performanceCallback;
             return true;
         }
@@ -594,9 +888,23 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
 
         }
 
-        case RETRO_ENVIRONMENT_SET_MEMORY_MAPS: //36
-            qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_SET_MEMORY_MAPS (RETRO_ENVIRONMENT_EXPERIMENTAL)(36)";
-            break;
+        case RETRO_ENVIRONMENT_SET_MEMORY_MAPS: { //36
+            qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_SET_MEMORY_MAPS (RETRO_ENVIRONMENT_EXPERIMENTAL)(36) (handled)";
+            auto *memoryMap = static_cast<const struct retro_memory_map *>( data );
+
+            libretroCore.memoryDescriptors.clear();
+
+            for( unsigned i = 0; i < memoryMap->num_descriptors; i++ ) {
+                const retro_memory_descriptor &descriptor = memoryMap->descriptors[ i ];
+                libretroCore.memoryDescriptors.append( descriptor );
+
+                qCDebug( phxCore ).nospace() << "\t\t" << i << ": start = 0x" << hex << descriptor.start << ", length = 0x"
+                                             << descriptor.len << dec << ", flags = " << descriptor.flags
+                                             << ( descriptor.ptr ? "" : " (no pointer)" );
+            }
+
+            return true;
+        }
 
         case RETRO_ENVIRONMENT_SET_GEOMETRY: { // 37
             qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_SET_GEOMETRY (37) (handled)";
@@ -621,9 +929,10 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
             qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_LANGUAGE (39)";
             break;
 
-        case RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER: // 40
-            //qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER (RETRO_ENVIRONMENT_EXPERIMENTAL) (40)";
-            break;
+        case RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER: { // 40
+            //qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER (RETRO_ENVIRONMENT_EXPERIMENTAL) (40) (handled)";
+            return LibretroCoreGetSoftwareFramebuffer( static_cast<retro_framebuffer *>( data ) );
+        }
 
         default:
             qCDebug( phxCore ) << "Error: Environment command " << cmd << " is not defined in the frontend's libretro.h!.";
@@ -636,68 +945,24 @@ bool LibretroCoreEnvironmentCallback( unsigned cmd, void *data ) {
 }
 
 void LibretroCoreInputPollCallback( void ) {
-    // Do nothing, this is handled before retro_run() is called
-    return;
+    // Input itself is updated before retro_run() is called, this only lets movies work frame by frame
+    if( libretroCore.frameUncounted ) {
+        return;
+    }
+
+    emit libretroCore.frameInputRequested( libretroCore.frameCount );
+    emit libretroCore.frameInputPolled( libretroCore.frameCount );
 }
 
 void LibretroCoreLogCallback( enum retro_log_level level, const char *fmt, ... ) {
-    QVarLengthArray<char, 1024> outbuf( 1024 );
+    // Formatted here, queued for the logger thread to write out (see logCoreMessage())
     va_list args;
     va_start( args, fmt );
-    int ret = vsnprintf( outbuf.data(), outbuf.size(), fmt, args );
-
-    if( ret < 0 ) {
-        qCDebug( phxCore ) << "logCallback: could not format string";
-        va_end( args );
-        return;
-    } else if( ( ret + 1 ) > outbuf.size() ) {
-        outbuf.resize( ret + 1 );
-        ret = vsnprintf( outbuf.data(), outbuf.size(), fmt, args );
-
-        if( ret < 0 ) {
-            qCDebug( phxCore ) << "logCallback: could not format string";
-            va_end( args );
-            return;
-        }
-    }
-
+    logCoreMessage( level, fmt, args );
     va_end( args );
-
-    // remove trailing newline, which are already added by qCDebug
-    if( outbuf.value( ret - 1 ) == '\n' ) {
-        outbuf[ret - 1] = '\0';
-
-        if( outbuf.value( ret - 2 ) == '\r' ) {
-            outbuf[ret - 2] = '\0';
-        }
-    }
-
-    switch( level ) {
-        case RETRO_LOG_DEBUG:
-            qCDebug( phxCore ) << "RETRO_LOG_DEBUG:" << outbuf.data();
-            break;
-
-        case RETRO_LOG_INFO:
-            qCDebug( phxCore ) << "RETRO_LOG_INFO:" << outbuf.data();
-            break;
-
-        case RETRO_LOG_WARN:
-            qCWarning( phxCore ) << "RETRO_LOG_WARN:" << outbuf.data();
-            break;
-
-        case RETRO_LOG_ERROR:
-            qCCritical( phxCore ) << "RETRO_LOG_ERROR:" << outbuf.data();
-            break;
-
-        default:
-            qCWarning( phxCore ) << "RETRO_LOG (unknown category!?):" << outbuf.data();
-            break;
-    }
 }
 
 int16_t LibretroCoreInputStateCallback( unsigned port, unsigned device, unsigned index, unsigned id ) {
-    Q_UNUSED( port );
-
 
     // Touch input
     // TODO: Multitouch?
@@ -825,119 +1090,126 @@ int16_t LibretroCoreInputStateCallback( unsigned port, unsigned device, unsigned
         }
     }
 
+    if( port >= LIBRETRO_MAX_PORTS ) {
+        return 0;
+    }
+
+    const LibretroPortState &portState = libretroCore.ports[ port ];
+
     // Analog input
     // index is the stick and id is the axis
-    // TODO: Don't add all controller axes together!
     if( device == RETRO_DEVICE_ANALOG ) {
-        int64_t value = 0;
-
-        for( GamepadState gamepad : libretroCore.gamepads ) {
-            switch( index ) {
-                case RETRO_DEVICE_INDEX_ANALOG_LEFT:
-                    value += gamepad.axis[ id == RETRO_DEVICE_ID_ANALOG_X ? SDL_CONTROLLER_AXIS_LEFTX : SDL_CONTROLLER_AXIS_LEFTY ];
-                    break;
-
-                case RETRO_DEVICE_INDEX_ANALOG_RIGHT:
-                    value += gamepad.axis[ id == RETRO_DEVICE_ID_ANALOG_X ? SDL_CONTROLLER_AXIS_RIGHTX : SDL_CONTROLLER_AXIS_RIGHTY ];
-                    break;
-
-                default:
-                    break;
-            }
+        if( index > RETRO_DEVICE_INDEX_ANALOG_RIGHT || id > RETRO_DEVICE_ID_ANALOG_Y ) {
+            return 0;
         }
 
-        // Clamp value to [-0x8000, 0x7fff]
-        if( value < -0x8000 ) {
-            value = -0x8000;
-        }
+        return portState.analog[ index ][ id ];
+    }
 
-        if( value > 0x7FFF ) {
-            value = 0x7FFF;
+    // Joypad input
+    if( device == RETRO_DEVICE_JOYPAD ) {
+        if( id > RETRO_DEVICE_ID_JOYPAD_R3 ) {
+            return 0;
         }
 
-        return static_cast<int16_t>( value );
+        return ( portState.buttons >> id ) & 1;
     }
 
-    // Joypad input
-    // TODO: Don't OR all controllers buttons together!
-    if( device == RETRO_DEVICE_JOYPAD ) {
-        int16_t value = 0;
+    return 0;
+}
 
-        for( GamepadState gamepad : libretroCore.gamepads ) {
-            if( gamepad.button[ SDL_CONTROLLER_BUTTON_A ] && id == RETRO_DEVICE_ID_JOYPAD_A ) {
-                value |= 1;
-            }
+bool LibretroCoreGetSoftwareFramebuffer( retro_framebuffer *framebuffer ) {
+    if( !framebuffer || libretroCore.videoFormat.videoMode == HARDWARERENDER ) {
+        return false;
+    }
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_B ] && id == RETRO_DEVICE_ID_JOYPAD_B ) {
-                value |= 1;
-            }
+    uint8_t *buffer = libretroCore.videoBufferPool[ libretroCore.videoPoolCurrentBuffer ];
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_X ] && id == RETRO_DEVICE_ID_JOYPAD_X ) {
-                value |= 1;
-            }
+    if( !buffer ) {
+        return false;
+    }
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_Y ] && id == RETRO_DEVICE_ID_JOYPAD_Y ) {
-                value |= 1;
-            }
+    // Hand out the buffer in the format the core already asked for, we don't convert anything
+    retro_pixel_format format;
+    size_t bytesPerPixel;
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_LEFTSHOULDER ] && id == RETRO_DEVICE_ID_JOYPAD_L ) {
-                value |= 1;
-            }
+    switch( libretroCore.videoFormat.videoPixelFormat ) {
+        case QImage::Format_RGB555:
+            format = RETRO_PIXEL_FORMAT_0RGB1555;
+            bytesPerPixel = 2;
+            break;
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_RIGHTSHOULDER ] && id == RETRO_DEVICE_ID_JOYPAD_R ) {
-                value |= 1;
-            }
+        case QImage::Format_RGB16:
+            format = RETRO_PIXEL_FORMAT_RGB565;
+            bytesPerPixel = 2;
+            break;
 
-            else if( gamepad.digitalL2 && id == RETRO_DEVICE_ID_JOYPAD_L2 ) {
-                value |= 1;
-            }
+        case QImage::Format_RGB32:
+            format = RETRO_PIXEL_FORMAT_XRGB8888;
+            bytesPerPixel = 4;
+            break;
 
-            else if( gamepad.digitalR2 && id == RETRO_DEVICE_ID_JOYPAD_R2 ) {
-                value |= 1;
-            }
+        default:
+            return false;
+    }
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_LEFTSTICK ] && id == RETRO_DEVICE_ID_JOYPAD_L3 ) {
-                value |= 1;
-            }
+    // Pool buffers are sized for the maximum geometry the core reported, the core may ask for more than that
+    size_t pitch = framebuffer->width * bytesPerPixel;
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_RIGHTSTICK ] && id == RETRO_DEVICE_ID_JOYPAD_R3 ) {
-                value |= 1;
-            }
+    if( pitch * framebuffer->height > libretroCore.videoPoolIndividualBufferSize ) {
+        return false;
+    }
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_DPAD_UP ] && id == RETRO_DEVICE_ID_JOYPAD_UP ) {
-                value |= 1;
-            }
+    framebuffer->data = buffer;
+    framebuffer->pitch = pitch;
+    framebuffer->format = format;
+    framebuffer->memory_flags = RETRO_MEMORY_TYPE_CACHED;
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_DPAD_DOWN ] && id == RETRO_DEVICE_ID_JOYPAD_DOWN ) {
-                value |= 1;
-            }
+    // Consumers can't read the buffer while the core draws into it, the video callback hands it back
+    if( !libretroCore.videoPoolBufferCheckedOut ) {
+        libretroCore.videoMutexes[ libretroCore.videoPoolCurrentBuffer ].lock();
+        libretroCore.videoPoolBufferCheckedOut = true;
+        LibretroCoreBeginVideoWrite( libretroCore.videoPoolCurrentBuffer );
+    }
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_DPAD_LEFT ] && id == RETRO_DEVICE_ID_JOYPAD_LEFT ) {
-                value |= 1;
-            }
+    return true;
+}
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_DPAD_RIGHT ] && id == RETRO_DEVICE_ID_JOYPAD_RIGHT ) {
-                value |= 1;
-            }
+void LibretroCoreReturnSoftwareFramebuffer() {
+    if( !libretroCore.videoPoolBufferCheckedOut ) {
+        return;
+    }
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_BACK ] && id == RETRO_DEVICE_ID_JOYPAD_SELECT ) {
-                value |= 1;
-            }
+    LibretroCoreEndVideoWrite( libretroCore.videoPoolCurrentBuffer );
+    libretroCore.videoMutexes[ libretroCore.videoPoolCurrentBuffer ].unlock();
+    libretroCore.videoPoolBufferCheckedOut = false;
+}
 
-            else if( gamepad.button[ SDL_CONTROLLER_BUTTON_START ] && id == RETRO_DEVICE_ID_JOYPAD_START ) {
-                value |= 1;
-            }
-        }
+void LibretroCoreBeginVideoWrite( int buffer ) {
+    if( !libretroCore.videoPoolSequences ) {
+        return;
+    }
 
-        return value;
+    std::atomic<quint64> &sequence = libretroCore.videoPoolSequences[ buffer ];
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+}
+
+void LibretroCoreEndVideoWrite( int buffer ) {
+    if( !libretroCore.videoPoolSequences ) {
+        return;
     }
 
-    return 0;
+    std::atomic<quint64> &sequence = libretroCore.videoPoolSequences[ buffer ];
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
 }
 
 void LibretroCoreVideoRefreshCallback( const void *data, unsigned width, unsigned height, size_t pitch ) {
     Q_UNUSED( width );
 
+    // Whatever the core drew into the current buffer, it's done with it
+    LibretroCoreReturnSoftwareFramebuffer();
+
     // Send out blank data if this session is hardware-accelerated
     if( data == RETRO_HW_FRAME_BUFFER_VALID || libretroCore.videoFormat.videoMode == HARDWARERENDER ) {
         // Cores can change the size of the video they output (within the bounds they set on load) at any time
@@ -954,26 +1226,43 @@ void LibretroCoreVideoRefreshCallback( const void *data, unsigned width, unsigne
             variant.setValue( libretroCore.videoFormat );
             libretroCore.fireCommandOut( Node::Command::SetLibretroVideoFormat, variant, nodeCurrentTime() );
 
-            // Recreate the FBO, send out the new FBO and texture ID
-            delete libretroCore.fbo;
-            libretroCore.fbo = new QOpenGLFramebufferObject( libretroCore.videoFormat.videoSize, QOpenGLFramebufferObject::CombinedDepthStencil );
+            // The frames get cropped out of the FBOs at the new size, LibretroCoreBindFramebuffer() swaps each one for
+            // a bigger one as it comes around if it's too small
+        }
 
-            // Clear the newly created FBO
-            libretroCore.fbo->bind();
-            libretroCore.context->functions()->glClear( GL_COLOR_BUFFER_BIT );
+        // The core has already drawn into the FBO, just don't tell consumers about it and let the next frame draw over it
+        if( libretroCore.videoSuppressed ) {
+            return;
+        }
 
-            libretroCore.fireCommandOut( Node::Command::SetOpenGLTexture, libretroCore.fbo->texture(), nodeCurrentTime() );
+        // Current frame is a dupe if data is nullptr, the last frame published is still the newest one
+        if( data == RETRO_HW_FRAME_BUFFER_VALID ) {
+            LibretroCorePublishFramebuffer();
         }
 
-        libretroCore.fireDataOut( Node::DataType::VideoGL, &libretroCore.videoMutex, nullptr, 0, nodeCurrentTime() );
+        libretroCore.fireDataOut( Node::DataType::VideoGL, nullptr, &libretroCore.glFrames, 0, nodeCurrentTime() );
+        return;
+    }
+
+    // Nobody will see this frame, skip the copy
+    if( libretroCore.videoSuppressed ) {
         return;
     }
 
     // Current frame exists, send it on its way
     if( data ) {
-        libretroCore.videoMutex.lock();
-        memcpy( libretroCore.videoBufferPool[ libretroCore.videoPoolCurrentBuffer ], data, height * pitch );
-        libretroCore.videoMutex.unlock();
+        // The core rendered straight into the buffer we gave it via GET_CURRENT_SOFTWARE_FRAMEBUFFER, nothing to copy
+        if( data == libretroCore.videoBufferPool[ libretroCore.videoPoolCurrentBuffer ] ) {
+            libretroCore.videoFramesZeroCopy++;
+        } else {
+            QMutex &mutex = libretroCore.videoMutexes[ libretroCore.videoPoolCurrentBuffer ];
+            mutex.lock();
+            LibretroCoreBeginVideoWrite( libretroCore.videoPoolCurrentBuffer );
+            memcpy( libretroCore.videoBufferPool[ libretroCore.videoPoolCurrentBuffer ], data, height * pitch );
+            LibretroCoreEndVideoWrite( libretroCore.videoPoolCurrentBuffer );
+            mutex.unlock();
+            libretroCore.videoFramesCopied++;
+        }
 
         size_t bytes = pitch * height;
         {
@@ -992,14 +1281,17 @@ void LibretroCoreVideoRefreshCallback( const void *data, unsigned width, unsigne
                 libretroCore.fireCommandOut( Node::Command::SetLibretroVideoFormat, variant, nodeCurrentTime() );
             }
         }
-        libretroCore.fireDataOut( Node::DataType::Video, &libretroCore.videoMutex, &libretroCore.videoBufferPool[ libretroCore.videoPoolCurrentBuffer ],
+        int buffer = libretroCore.videoPoolCurrentBuffer;
+        libretroCore.fireDataOut( Node::DataType::Video, &libretroCore.videoMutexes[ buffer ], &libretroCore.videoBufferPool[ buffer ],
                                   bytes, nodeCurrentTime() );
-        libretroCore.videoPoolCurrentBuffer = ( libretroCore.videoPoolCurrentBuffer + 1 ) % POOL_SIZE;
+        libretroCore.videoPoolCurrentBuffer = ( buffer + 1 ) % POOL_SIZE;
     }
 
     // Current frame is a dupe, send the last actual frame again
+    // That's the buffer before the current one, the current one is what the core renders into next
     else {
-        libretroCore.fireDataOut( Node::DataType::Video, &libretroCore.videoMutex, &libretroCore.videoBufferPool[ libretroCore.videoPoolCurrentBuffer ],
+        int buffer = ( libretroCore.videoPoolCurrentBuffer + POOL_SIZE - 1 ) % POOL_SIZE;
+        libretroCore.fireDataOut( Node::DataType::Video, &libretroCore.videoMutexes[ buffer ], &libretroCore.videoBufferPool[ buffer ],
                                   pitch * height, nodeCurrentTime() );
     }
 
@@ -1023,13 +1315,16 @@ retro_proc_address_t LibretroCoreOpenGLProcAddressCallback( const char *sym ) {
 }
 
 bool LibretroCoreRumbleCallback( unsigned port, enum retro_rumble_effect effect, uint16_t strength ) {
-    Q_UNUSED( port );
-
     for( GamepadState &gamepad : libretroCore.gamepads ) {
         if( gamepad.instanceID == -1 || !gamepad.haptic ) {
             continue;
         }
 
+        // Only rumble the controllers plugged into this port
+        if( libretroCore.gamepadPorts.value( gamepad.instanceID, -1 ) != static_cast<int>( port ) ) {
+            continue;
+        }
+
         if( effect == RETRO_RUMBLE_STRONG ) {
             gamepad.fallbackRumbleRequestedStrength += static_cast<qreal>( strength ) / 65535.0;
         } else {
@@ -1049,6 +1344,22 @@ bool LibretroCoreRumbleCallback( unsigned port, enum retro_rumble_effect effect,
     return true;
 }
 
+void LibretroCorePerfRegisterCallback( retro_perf_counter *counter ) {
+    libretroCore.perf.registerCounter( counter );
+}
+
+void LibretroCorePerfStartCallback( retro_perf_counter *counter ) {
+    libretroCore.perf.start( counter );
+}
+
+void LibretroCorePerfStopCallback( retro_perf_counter *counter ) {
+    libretroCore.perf.stop( counter );
+}
+
+void LibretroCorePerfLogCallback( void ) {
+    libretroCore.perf.log();
+}
+
 // Helpers
 
 QString LibretroCoreInputTupleToString( unsigned port, unsigned device, unsigned index, unsigned id ) {
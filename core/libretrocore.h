@@ -11,11 +11,20 @@
 #include <QRect>
 #include <QSurface>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "audioring.h"
 #include "core.h"
 #include "gamepadstate.h"
 #include "libretro.h"
+#include "libretroperf.h"
+#include "libretromemoryexport.h"
+#include "libretrorewind.h"
 #include "libretrosymbols.h"
 #include "libretrovariable.h"
+#include "libretrovariabletable.h"
 #include "logging.h"
 #include "node.h"
 #include "mousestate.h"
@@ -23,9 +32,25 @@
 // Since each buffer holds one frame, depending on core, 30 frames = ~500ms
 #define POOL_SIZE 30
 
+// Number of controller ports presented to the core
+#define LIBRETRO_MAX_PORTS 8
+
+// Framebuffers 3D cores draw to, one per slot of LibretroGLFrames
+#define LIBRETRO_FBO_COUNT 3
+
+// Everything the input state callback needs to answer a joypad or analog query for one port
+struct LibretroPortState {
+    // Bit n is set if RETRO_DEVICE_ID_JOYPAD_n is pressed
+    uint16_t buttons;
+
+    // Indexed by [ RETRO_DEVICE_INDEX_ANALOG_* ][ RETRO_DEVICE_ID_ANALOG_* ]
+    int16_t analog[ 2 ][ 2 ];
+};
+
 /*
  * C++ wrapper around a Libretro core. Currently, only one LibretroCore instance may safely exist at any time due to the
- * lack of a context pointer for callbacks to use.
+ * lack of a context pointer for callbacks to use. LibretroCoreProxy gets around that by running each one in a process of
+ * its own.
  *
  * The following keys are mandatory for source from Node::Command::SetSource:
  * "type": "libretro"
@@ -34,6 +59,9 @@
  * "systemPath": Absolute path to the system directory (contents of which depend on the core)
  * "savePath": Absolute path to the save directory
  *
+ * Optional:
+ * "outOfProcess": true to run the core in a phoenix-corehost process of its own (see LibretroCoreProxy)
+ *
  * LibretroCore expects some kind of input producer (such as InputManager) to produce input which LibretroCore will then
  * consume. This input production also drives the production of frames (retro_run()), so time it such that it's as close
  * as possible to the console's native framerate!
@@ -53,6 +81,14 @@ class LibretroCore : public Core {
         void commandOut( Node::Command command, QVariant data, qint64 timeStamp );
         void dataOut( Node::DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp );
 
+        // Fired from LibretroCoreInputPollCallback() when the core polls input for the frame it's emulating, frame being
+        // frameCount as of that frame. Not fired for frames that don't count (see frameUncounted). Cores that poll more
+        // than once per frame fire these more than once, cores that don't poll in a frame don't fire them at all
+        // Connect with Qt::DirectConnection: frameInputRequested is for whoever supplies the frame's input (the ports
+        // are read right after), frameInputPolled for whoever records it
+        void frameInputRequested( quint64 frame );
+        void frameInputPolled( quint64 frame );
+
     public:
         // Fire commandOut from a static context
         void fireCommandOut( Node::Command command, QVariant data, qint64 timeStamp );
@@ -92,12 +128,23 @@ class LibretroCore : public Core {
         const char *systemPathCString{ nullptr };
         const char *savePathCString{ nullptr };
 
-        // Raw ROM/ISO data, empty if (systemInfo->need_fullpath)
-        QByteArray gameData;
+        // True if retro_load_game() accepted the game, until it's unloaded
+        bool gameLoaded { false };
+
+        // Read-only memory mapping of the ROM/ISO (gameFile stays open while it's mapped), nullptr if
+        // (systemInfo->need_fullpath)
+        uchar *gameData { nullptr };
+
+        // Fallback copy of the ROM/ISO for when the file can't be mapped
+        QByteArray gameDataCopy;
 
         // SRAM
 
         void *saveDataBuf{ nullptr };
+        size_t saveDataSize { 0 };
+
+        // Hash of the save data as it was last read from or written to disk, used to skip writes when nothing changed
+        quint64 saveDataHash { 0 };
 
         // Core-specific constants
 
@@ -106,6 +153,9 @@ class LibretroCore : public Core {
 
         retro_perf_callback performanceCallback;
 
+        // Backs performanceCallback, aggregates the core's performance counters for the session
+        LibretroPerf perf;
+
         // Node data
 
         Node::State currentState;
@@ -118,17 +168,56 @@ class LibretroCore : public Core {
         // Video
 
         // Buffer pool (aka circular buffer of buffers), ensures thread safety (via the pipeline's unload/shutdown mechanism),
-        // ensures atomic reads and writes (via a mutex) and prevents per-frame heap allocations
-        QMutex videoMutex;
+        // ensures atomic reads and writes (via mutexes) and prevents per-frame heap allocations
+        // Each buffer has its own mutex, sent out along with it. Lock all of them to swap the buffers
+        // The current buffer is also what GET_CURRENT_SOFTWARE_FRAMEBUFFER hands to the core to render into directly. Its
+        // mutex is held from then until the video callback, so a consumer that fell POOL_SIZE frames behind waits for the
+        // frame to be done instead of reading it half-drawn
+        QMutex videoMutexes[ POOL_SIZE ];
         uint8_t *videoBufferPool[ POOL_SIZE ] { nullptr };
         int videoPoolCurrentBuffer { 0 };
+
+        // True while the core has the current buffer (and its mutex) to render into
+        bool videoPoolBufferCheckedOut { false };
         size_t videoPoolIndividualBufferSize { 0 };
 
+        // If set, LibretroCoreGrowBufferPool() gets the pool's memory from here (one block, POOL_SIZE buffers back to back)
+        // instead of allocating it. The core host uses this to put frames in shared memory. The block belongs to whoever
+        // provided it, return nullptr to fall back to allocating
+        std::function<uint8_t *( size_t bytes )> videoPoolAllocator;
+        bool videoPoolExternal { false };
+
+        // Optionally set by videoPoolAllocator: a sequence word per buffer for readers in other processes, who can't take
+        // videoMutexes. Odd while the buffer is written (rendered or copied into), see LibretroCoreBeginVideoWrite()
+        std::atomic<quint64> *videoPoolSequences { nullptr };
+
+        // Software frames that were rendered directly into the pool vs. copied into it
+        quint64 videoFramesZeroCopy { 0 };
+        quint64 videoFramesCopied { 0 };
+
         // An OpenGL context for 3D cores to draw with
         QOpenGLContext *context { nullptr };
 
-        // An FBO that serves as the target for the 3D core
+        // FBOs that serve as the target for the 3D core, handed to the render thread through glFrames: the core draws
+        // into fbo (the write slot's) while the render thread samples another, fences tell each side when the other is
+        // done with one instead of a lock
+        // They're allocated at the biggest size the core said its video could be (fboSize) and the core draws into the
+        // bottom-left corner at the current size, so resolution changes don't allocate anything
+        QOpenGLFramebufferObject *fbos[ LIBRETRO_FBO_COUNT ] { nullptr };
         QOpenGLFramebufferObject *fbo { nullptr };
+        QSize fboSize;
+
+        // The buffers the core asked for besides color
+        QOpenGLFramebufferObject::Attachment fboAttachment { QOpenGLFramebufferObject::CombinedDepthStencil };
+
+        // FBOs not in use, keyed by LibretroCoreFramebufferKey(). The ones a game leaves behind are kept for the next
+        // one, context lives as long as the app so a game of the same size doesn't allocate anything
+        // It never holds more than one game's worth (LIBRETRO_FBO_COUNT): loading a 3D game frees what it didn't take,
+        // loading a 2D game frees all of it and FBOs a game outgrows are deleted right away
+        QMultiHash<quint64, QOpenGLFramebufferObject *> fboPool;
+
+        LibretroGLFrames glFrames;
+        GLFences glFences;
 
         // FIXME: Race condition with the render thread when making this current?
         QOffscreenSurface *surface { nullptr };
@@ -136,22 +225,23 @@ class LibretroCore : public Core {
         // Video geometry info for use by video consumers
         LibretroVideoFormat videoFormat;
 
+        // If true, the video callback discards frames instead of copying and sending them out
+        bool videoSuppressed { false };
+
         // Audio
 
         qreal audioSampleRate { 44100 };
 
-        // Buffer pool (aka circular buffer of buffers), ensures thread safety (via the pipeline's unload/shutdown mechanism),
-        // ensures atomic reads and writes (via a mutex) and prevents per-frame heap allocations
-        QMutex audioMutex;
-        int16_t *audioBufferPool[ POOL_SIZE ] { nullptr };
-        int audioPoolCurrentBuffer { 0 };
-        size_t audioPoolIndividualBufferSize { 0 };
-
-        // Amount audioBufferPool[ audioBufferPoolIndex ] has been filled
-        // Each frame, exactly ( sampleRate * 4 ) bytes should be copied to
-        // audioBufferPool[ audioBufferPoolIndex ][ audioBufferCurrentByte ] in total
+        // Lock-free hand-off to the audio consumer, sent out as the data pointer of DataType::Audio
+        // Each frame, ( sampleRate / fps ) frames should be written in total
         // FIXME: In practice, that's not always the case? Some cores only hit that *on average*
-        int audioBufferCurrentByte { 0 };
+        AudioRing audioRing;
+
+        // Once this many frames are pending in audioRing, they're committed and sent out (~1/2 of a video frame's worth)
+        size_t audioFlushFrames { 0 };
+
+        // If true, the audio callbacks discard samples instead of copying and sending them out
+        bool audioSuppressed { false };
 
         // Input
 
@@ -163,6 +253,17 @@ class LibretroCore : public Core {
         // Nothing you set will be preserved.
         QHash<int, GamepadState> gamepads;
 
+        // The port each controller is plugged into, indexed by instanceID. Controllers get the lowest free port when they
+        // first send input, the keyboard (instanceID -1) always shares port 0 with whichever controller is on it
+        QHash<int, int> gamepadPorts;
+
+        // Each controller's latest state reduced to a LibretroPortState, indexed by instanceID
+        QHash<int, LibretroPortState> gamepadSnapshots;
+
+        // The state of every controller on a port merged together, rebuilt whenever one of them sends input.
+        // This is all the input state callback looks at for joypad and analog queries
+        LibretroPortState ports[ LIBRETRO_MAX_PORTS ] {};
+
         // For fallback rumble, which requires us to explicitly stop and set a rumble effect each time we want to change
         // the strength, we must make sure not to waste time resetting it unless the value's actually changed. Store the value of the
         // current/active strength here. Indexed by instanceID, given a default of 0.0 on controller connect.
@@ -179,26 +280,145 @@ class LibretroCore : public Core {
         // Value is a human-readable description
         QMap<QString, QString> inputDescriptors;
 
+        // Memory maps
+
+        // Descriptors of the core's memory from RETRO_ENVIRONMENT_SET_MEMORY_MAPS, empty if the core never sent any.
+        // The pointers inside are only valid while the core is loaded
+        QVector<retro_memory_descriptor> memoryDescriptors;
+
+        // Frames emulated since the game was loaded: one per retro_run() that moves the game forward. Run-ahead's
+        // hidden frames are rolled back and rewinding steps back, neither counts
+        quint64 frameCount { 0 };
+
+        // True while retro_run() emulates a frame that doesn't count towards frameCount
+        bool frameUncounted { false };
+
+        // Publishes the core's memory to other processes. Anything that writes to the core's memory has to be wrapped in
+        // memoryExport.beginFrames()/endFrames() so readers know, LibretroCoreUnserialize() does it for loading states
+        LibretroMemoryExport memoryExport;
+
+        // Rewind
+
+        // History of serialized states, only active if the core supports serialization
+        LibretroRewind rewind;
+
+        // Take a rewind snapshot every this many frames
+        int rewindInterval { 1 };
+
+        // Run-ahead
+
+        // Frames to emulate ahead of the real state each heartbeat, 0 if disabled
+        int runAheadFrames { 0 };
+
+        // Warm core cache
+
+        // Keep the core loaded and initialized after Stop. If the next game uses the same core it's loaded right away,
+        // skipping loading the library and retro_init()
+        bool keepCoreLoaded { false };
+
+        // Absolute path of a core kept loaded this way (initialized, no game loaded), empty if there isn't one
+        QString warmCorePath;
+
         // Misc
 
         // Core-specific variables
+        // This is the master copy, the core only ever sees the snapshots LibretroCorePublishVariables() makes of it
         QMap<QByteArray, LibretroVariable> variables;
 
         // True if variables are dirty and the core needs to reload them from us
         bool variablesAreDirty{ false };
+
+        // The latest snapshot of variables, only accessed with std::atomic_load()/std::atomic_store()
+        std::shared_ptr<const LibretroVariableTable> publishedVariables;
+
+        // Bumped after every publish so the core thread can cheaply tell when it needs to pick up a new snapshot
+        std::atomic<quint64> variablesGeneration { 0 };
+
+        // Core thread only: the snapshot RETRO_ENVIRONMENT_GET_VARIABLE answers from and the one before it, which is kept
+        // alive in case the core is still holding one of its value pointers
+        std::shared_ptr<const LibretroVariableTable> activeVariables;
+        std::shared_ptr<const LibretroVariableTable> retiredVariables;
+        quint64 activeVariablesGeneration { 0 };
 };
 
 // Libretro is a C API. This limits us to one LibretroCore per process.
 extern LibretroCore libretroCore;
 
 // SRAM
+QString LibretroCoreSaveDataPath();
 void LibretroCoreLoadSaveData();
-void LibretroCoreStoreSaveData();
+
+// Hash the save data and, if it's changed since saveDataHash, copy it into buffer and update saveDataHash
+// Returns false if nothing changed (or the core handles saving itself)
+bool LibretroCoreSnapshotSaveData( QByteArray &buffer );
+
+// retro_unserialize(), letting memoryExport's readers know the core's memory is being rewritten
+bool LibretroCoreUnserialize( const void *data, size_t size );
+
+// Save states
+QString LibretroCoreStatePath( int slot );
 
 // Should only be called on load time (consumers expect buffers to be valid while Core is active)
 void LibretroCoreGrowBufferPool( retro_system_av_info *avInfo );
 void LibretroCoreFreeBufferPool();
 
+// 3D cores' FBOs. All but the two Free functions need context to be current
+// Allocate takes them from fboPool if it can and frees what it didn't take, Free gives them back to fboPool
+void LibretroCoreAllocateFramebuffers( QSize size );
+void LibretroCoreFreeFramebuffers();
+
+// Delete the pooled FBOs, must be done before context changes
+void LibretroCoreFreeFramebufferPool();
+
+// Take an FBO of the given size with fboAttachment from fboPool, allocating (and clearing) one if there isn't one
+QOpenGLFramebufferObject *LibretroCoreTakeFramebuffer( QSize size );
+void LibretroCoreReturnFramebuffer( QOpenGLFramebufferObject *fbo );
+quint64 LibretroCoreFramebufferKey( QSize size, QOpenGLFramebufferObject::Attachment attachment );
+
+// Wait (on the GPU) for the render thread to be done with the FBO the core draws into next, swap it for a bigger one
+// if the video outgrew it and bind it
+void LibretroCoreBindFramebuffer();
+
+// Hand the frame the core just drew to the render thread and bind the next FBO
+void LibretroCorePublishFramebuffer();
+
+// Deinit and unload the core, which must not have a game loaded
+void LibretroCoreUnloadCore();
+
+// Unload the core kept loaded after its last game (see keepCoreLoaded), does nothing if there isn't one
+void LibretroCoreUnloadWarmCore();
+
+// Commit pending audio frames and send them out
+void LibretroCoreFlushAudio();
+
+// Store the new state of a controller, assigning it a port if it doesn't have one yet, and rebuild its port's snapshot
+void LibretroCoreUpdatePortState( const GamepadState &gamepad );
+
+// Reduce a controller's state to what the input state callback needs
+LibretroPortState LibretroCoreMakePortState( const GamepadState &gamepad );
+
+// Same as LibretroCoreUpdatePortState(), for a controller state that was already reduced (by another process, for instance)
+void LibretroCoreSetPortState( int instanceID, const LibretroPortState &snapshot );
+
+// Unplug a controller from its port
+void LibretroCoreReleasePort( int instanceID );
+
+// Merge the snapshots of every controller on a port into ports[ port ]
+void LibretroCoreRebuildPort( int port );
+
+// Snapshot variables and make the snapshot available to the core, safe to call from any thread that owns variables
+void LibretroCorePublishVariables();
+
+// Point the core at the current video pool buffer so it can render into it directly (GET_CURRENT_SOFTWARE_FRAMEBUFFER)
+bool LibretroCoreGetSoftwareFramebuffer( retro_framebuffer *framebuffer );
+
+// Take the current video pool buffer back from the core, letting consumers read it again
+void LibretroCoreReturnSoftwareFramebuffer();
+
+// Bump the buffer's sequence word (if the pool has them) before and after writing into it
+void LibretroCoreBeginVideoWrite( int buffer );
+void LibretroCoreEndVideoWrite( int buffer );
+
 // Callbacks
 void LibretroCoreAudioSampleCallback( int16_t left, int16_t right );
 size_t LibretroCoreAudioSampleBatchCallback( const int16_t *data, size_t frames );
@@ -212,6 +432,10 @@ void LibretroCoreVideoRefreshCallback( const void *data, unsigned width, unsigne
 uintptr_t LibretroCoreGetFramebufferCallback( void );
 retro_proc_address_t LibretroCoreOpenGLProcAddressCallback( const char *sym );
 bool LibretroCoreRumbleCallback( unsigned port, enum retro_rumble_effect effect, uint16_t strength );
+void LibretroCorePerfRegisterCallback( retro_perf_counter *counter );
+void LibretroCorePerfStartCallback( retro_perf_counter *counter );
+void LibretroCorePerfStopCallback( retro_perf_counter *counter );
+void LibretroCorePerfLogCallback( void );
 
 // Helper that generates key for looking up the inputDescriptors
 QString LibretroCoreInputTupleToString( unsigned port, unsigned device, unsigned index, unsigned id );
@@ -0,0 +1,167 @@
+#include "libretrocorehost.h"
+#include "libretrovariable.h"
+#include "logging.h"
+
+#include <QByteArrayList>
+#include <QDataStream>
+#include <QMetaType>
+
+#include <string.h>
+
+namespace {
+    inline size_t alignUp( size_t value ) {
+        return ( value + 63 ) & ~static_cast<size_t>( 63 );
+    }
+}
+
+// Stream operators for the user types commands carry
+
+QDataStream &operator<<( QDataStream &stream, const LibretroVideoFormat &format ) {
+    stream << format.videoAspectRatio << static_cast<quint64>( format.videoBytesPerLine )
+           << static_cast<quint64>( format.videoBytesPerPixel ) << format.videoFramerate
+           << static_cast<qint32>( format.videoMode ) << static_cast<qint32>( format.videoPixelFormat ) << format.videoSize;
+    return stream;
+}
+
+QDataStream &operator>>( QDataStream &stream, LibretroVideoFormat &format ) {
+    quint64 bytesPerLine = 0;
+    quint64 bytesPerPixel = 0;
+    qint32 mode = 0;
+    qint32 pixelFormat = 0;
+
+    stream >> format.videoAspectRatio >> bytesPerLine >> bytesPerPixel >> format.videoFramerate >> mode >> pixelFormat
+           >> format.videoSize;
+
+    format.videoBytesPerLine = static_cast<size_t>( bytesPerLine );
+    format.videoBytesPerPixel = static_cast<size_t>( bytesPerPixel );
+    format.videoMode = static_cast<VideoRendererType>( mode );
+    format.videoPixelFormat = static_cast<QImage::Format>( pixelFormat );
+    return stream;
+}
+
+QDataStream &operator<<( QDataStream &stream, const LibretroVariable &variable ) {
+    stream << variable.key() << variable.value() << variable.description() << variable.choices();
+    return stream;
+}
+
+QDataStream &operator>>( QDataStream &stream, LibretroVariable &variable ) {
+    QByteArray key;
+    QByteArray value;
+    QByteArray description;
+    QVector<QByteArray> choices;
+    stream >> key >> value >> description >> choices;
+
+    // Rebuild it the way the core described it in the first place
+    QByteArray definition = choices.isEmpty() ? description : description + "; " + QByteArrayList( choices.toList() ).join( '|' );
+    retro_variable raw { key.constData(), definition.constData() };
+    variable = LibretroVariable( &raw );
+    variable.setValue( value );
+    return stream;
+}
+
+size_t CoreHostAudioRingOffset() {
+    return alignUp( sizeof( CoreHostSegment ) );
+}
+
+size_t CoreHostSegmentSize() {
+    return CoreHostAudioRingOffset() + AudioRing::sharedMemorySize( COREHOST_AUDIO_FRAMES );
+}
+
+void CoreHostChannel::setSocket( QLocalSocket *socket ) {
+    m_socket = socket;
+    m_failed = false;
+    buffer.clear();
+}
+
+QLocalSocket *CoreHostChannel::socket() const {
+    return m_socket;
+}
+
+bool CoreHostChannel::canSend( const QVariant &data ) {
+    int type = data.userType();
+    return type < QMetaType::User || type == qMetaTypeId<LibretroVideoFormat>() || type == qMetaTypeId<LibretroVariable>();
+}
+
+void CoreHostChannel::send( const CoreHostMessage &message ) {
+    if( !m_socket || m_socket->state() != QLocalSocket::ConnectedState ) {
+        return;
+    }
+
+    QByteArray payload;
+    {
+        QDataStream stream( &payload, QIODevice::WriteOnly );
+        stream << static_cast<quint8>( message.type ) << static_cast<qint32>( message.command ) << message.data
+               << message.bytes << message.timeStamp;
+    }
+
+    quint32 length = static_cast<quint32>( payload.size() );
+    m_socket->write( reinterpret_cast<const char *>( &length ), sizeof( length ) );
+    m_socket->write( payload );
+
+    // Don't wait for the event loop, the other side is waiting on this
+    m_socket->flush();
+}
+
+bool CoreHostChannel::receive( CoreHostMessage &message ) {
+    if( m_failed ) {
+        return false;
+    }
+
+    if( m_socket ) {
+        buffer.append( m_socket->readAll() );
+    }
+
+    quint32 length = 0;
+
+    if( static_cast<size_t>( buffer.size() ) < sizeof( length ) ) {
+        return false;
+    }
+
+    memcpy( &length, buffer.constData(), sizeof( length ) );
+
+    if( length > COREHOST_MAX_MESSAGE_SIZE ) {
+        qCCritical( phxCore ) << "Received a message of" << length << "bytes, dropping the connection";
+        fail();
+        return false;
+    }
+
+    if( static_cast<size_t>( buffer.size() ) < sizeof( length ) + length ) {
+        return false;
+    }
+
+    QByteArray payload = buffer.mid( sizeof( length ), static_cast<int>( length ) );
+    buffer.remove( 0, static_cast<int>( sizeof( length ) + length ) );
+
+    QDataStream stream( payload );
+    quint8 type = 0;
+    qint32 command = 0;
+    stream >> type >> command >> message.data >> message.bytes >> message.timeStamp;
+    message.type = static_cast<CoreHostMessage::Type>( type );
+    message.command = static_cast<Node::Command>( command );
+
+    if( stream.status() != QDataStream::Ok || type > static_cast<quint8>( CoreHostMessage::Type::AudioChunk ) ) {
+        qCCritical( phxCore ) << "Received a message that could not be decoded, dropping the connection";
+        fail();
+        return false;
+    }
+
+    return true;
+}
+
+bool CoreHostChannel::failed() const {
+    return m_failed;
+}
+
+void CoreHostChannel::fail() {
+    m_failed = true;
+    buffer.clear();
+
+    if( m_socket ) {
+        m_socket->abort();
+    }
+}
+
+void CoreHostRegisterTypes() {
+    qRegisterMetaTypeStreamOperators<LibretroVideoFormat>( "LibretroVideoFormat" );
+    qRegisterMetaTypeStreamOperators<LibretroVariable>( "LibretroVariable" );
+}
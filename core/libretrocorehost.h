@@ -0,0 +1,151 @@
+#pragma once
+
+#include <QByteArray>
+#include <QLocalSocket>
+#include <QVariant>
+#include <QtGlobal>
+
+#include <atomic>
+#include <stddef.h>
+
+#include "audioring.h"
+#include "libretrocore.h"
+#include "node.h"
+
+// Both sides must be built from the same sources, bump this whenever the layout or the messages below change
+#define COREHOST_VERSION 3
+
+// "PHXHOST1" as a little-endian integer
+#define COREHOST_MAGIC Q_UINT64_C( 0x3154534F48584850 )
+
+// Most controllers the backend forwards to the host at once
+#define COREHOST_MAX_CONTROLLERS 16
+
+// Size of the audio ring in the shared segment. LibretroCoreGrowBufferPool() wants room for half a second, this covers
+// sample rates up to 128kHz
+#define COREHOST_AUDIO_FRAMES 65536
+
+// How long the backend waits for the host process to start and connect, in ms
+#define COREHOST_CONNECT_TIMEOUT 10000
+
+// Largest message either side accepts, in bytes. Messages are commands and notifications, nothing comes close
+#define COREHOST_MAX_MESSAGE_SIZE ( 1024 * 1024 )
+
+/*
+ * Shared memory and messages between LibretroCoreProxy (in the backend) and phoenix-corehost, the process it runs the
+ * core in. See libretrocoreproxy.h for the big picture.
+ *
+ * The backend creates the "<key>-io" segment before starting the host: a CoreHostSegment followed by the AudioRing the
+ * host's audio callbacks write into and AudioOutput reads from. Controller and mouse state go through the
+ * CoreHostInput block, a seqlock written by the backend whenever input arrives and read by the host once per heartbeat.
+ *
+ * The host creates a "<key>-video-<n>" segment when the core is loaded and carves LibretroCore's video buffer pool out
+ * of it (see LibretroCore::videoPoolAllocator), so frames are rendered or copied into shared memory exactly once. The
+ * segment starts with a CoreHostVideoHeader. The host's videoMutexes don't reach the backend, so the backend copies
+ * each frame out under the buffer's sequence word and drops it if the host wrote over it meanwhile. Each time the pool grows
+ * it's a new segment with the next n, the backend attaches to it then detaches from the old one.
+ *
+ * Everything else goes through a local socket as small length-prefixed messages: pipeline commands both ways plus a
+ * notification for each video frame and audio chunk that's ready in shared memory.
+ */
+
+struct CoreHostController {
+    qint32 instanceID;
+    LibretroPortState state;
+};
+
+struct alignas( 64 ) CoreHostInput {
+    // Odd while the backend is writing. Readers copy everything out then check it didn't change (or become odd)
+    std::atomic<quint32> generation;
+
+    qint32 controllerCount;
+    CoreHostController controllers[ COREHOST_MAX_CONTROLLERS ];
+
+    double mouseX;
+    double mouseY;
+    quint32 mouseButtons;
+};
+
+struct alignas( 64 ) CoreHostVideoHeader {
+    // One per pool buffer (LibretroCore::videoPoolSequences), odd while the host writes into the buffer. The backend
+    // copies a frame out then checks it didn't change (or start out odd)
+    std::atomic<quint64> sequences[ POOL_SIZE ];
+};
+
+struct alignas( 64 ) CoreHostSegment {
+    quint64 magic;
+    quint32 version;
+    quint32 reserved;
+
+    CoreHostInput input;
+};
+
+// Where the AudioRing starts in the "<key>-io" segment, and the segment's total size
+size_t CoreHostAudioRingOffset();
+size_t CoreHostSegmentSize();
+
+struct CoreHostMessage {
+    enum class Type : quint8 {
+        // Either way: a pipeline command. command, data and timeStamp are set
+        Command,
+
+        // Host to backend: the video buffer pool is now in the segment named by data (QString, "<key>-video-<n>"),
+        // after a CoreHostVideoHeader. bytes is the size of each buffer
+        VideoPool,
+
+        // Host to backend: a software frame is ready. data is the buffer's index in the pool (int), bytes its size
+        VideoFrame,
+
+        // Host to backend: an audio chunk was committed to the ring. bytes is its size
+        AudioChunk,
+    };
+
+    Type type { Type::Command };
+    Node::Command command { Node::Command::Heartbeat };
+    QVariant data;
+    quint64 bytes { 0 };
+    qint64 timeStamp { 0 };
+};
+
+/*
+ * Message framing over a QLocalSocket. Each message is sent as a 32-bit length followed by the message serialized with
+ * QDataStream.
+ *
+ * A length over COREHOST_MAX_MESSAGE_SIZE or a message that doesn't decode means the stream can't be trusted anymore:
+ * the channel aborts the connection and reports it through failed() instead of waiting for more data.
+ */
+
+class CoreHostChannel {
+    public:
+        CoreHostChannel() = default;
+
+        void setSocket( QLocalSocket *socket );
+        QLocalSocket *socket() const;
+
+        // True if data can be sent in a message: built-in types, LibretroVideoFormat and LibretroVariable. Pointers
+        // (contexts, surfaces, threads) and GamepadStates mean nothing to the other process
+        static bool canSend( const QVariant &data );
+
+        // Queue a message and push it out right away
+        void send( const CoreHostMessage &message );
+
+        // Read whatever has arrived and take the next complete message out of it. Returns false if there's none yet
+        // or the channel failed
+        bool receive( CoreHostMessage &message );
+
+        // True once a bad message was received and the connection aborted
+        bool failed() const;
+
+    private:
+        QLocalSocket *m_socket { nullptr };
+        bool m_failed { false };
+
+        // Give up on the stream: mark the channel failed and abort the connection
+        void fail();
+
+        // Bytes received that don't make up a complete message yet
+        QByteArray buffer;
+};
+
+// Register the stream operators the messages need, call once on both sides before using a channel
+void CoreHostRegisterTypes();
@@ -0,0 +1,446 @@
+#include "libretrocoreproxy.h"
+#include "libretrocore.h"
+#include "logging.h"
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QTimer>
+
+#include <string.h>
+
+// How long the host gets to exit on its own once it's stopped, in ms
+#define COREHOST_EXIT_TIMEOUT 5000
+
+namespace {
+    // Sessions started by this process so far, makes each key unique
+    int sessionCount { 0 };
+}
+
+LibretroCoreProxy::LibretroCoreProxy( Node *parent ) : Node( parent ),
+    server( new QLocalServer( this ) ),
+    process( new QProcess( this ) ) {
+
+    CoreHostRegisterTypes();
+
+    // The host's log messages come through its stderr as records (see setLogRecordOutput()), relayed into our log with
+    // their own type and category. Whatever the core prints to stdout or stderr itself is relayed as info
+    process->setProcessChannelMode( QProcess::SeparateChannels );
+
+    connect( process, &QProcess::readyReadStandardError, this, [ this ]() {
+        relayOutput( QProcess::StandardError, false );
+    } );
+
+    connect( process, &QProcess::readyReadStandardOutput, this, [ this ]() {
+        relayOutput( QProcess::StandardOutput, false );
+    } );
+
+    connect( process, static_cast<void( QProcess::* )( int, QProcess::ExitStatus )>( &QProcess::finished ),
+             this, &LibretroCoreProxy::hostFinished );
+}
+
+LibretroCoreProxy::~LibretroCoreProxy() {
+    if( hostRunning ) {
+        stopHost();
+    }
+}
+
+void LibretroCoreProxy::commandIn( Command command, QVariant data, qint64 timeStamp ) {
+    // Command is not relayed to children automatically, the host sends back what its runner relays
+
+    CoreHostMessage message;
+    message.command = command;
+    message.data = data;
+    message.timeStamp = timeStamp;
+
+    switch( command ) {
+        case Command::SetSource: {
+            if( !hostRunning && !startHost() ) {
+                qCCritical( phxCore ) << "Could not start the core host, stopping";
+                emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+                return;
+            }
+
+            channel.send( message );
+            break;
+        }
+
+        case Command::Heartbeat: {
+            // Our children don't need to wait for the host, and the host doesn't send heartbeats back
+            emit commandOut( command, data, timeStamp );
+
+            if( hostRunning ) {
+                channel.send( message );
+            }
+
+            break;
+        }
+
+        case Command::Stop: {
+            // Nothing running, stop right here
+            if( !hostRunning ) {
+                emit commandOut( Command::Unload, QVariant(), nodeCurrentTime() );
+                emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+                break;
+            }
+
+            stopping = true;
+            channel.send( message );
+
+            // Don't let a hung host hold up unloading forever, killing it goes down the same path as a crash
+            QString session = key;
+            QTimer::singleShot( COREHOST_EXIT_TIMEOUT, this, [ this, session ]() {
+                if( hostRunning && stopping && key == session ) {
+                    qCWarning( phxCore ) << "Core host did not stop, killing it";
+                    process->kill();
+                }
+            } );
+
+            break;
+        }
+
+        case Command::RemoveController: {
+            controllers.remove( data.value<GamepadState>().instanceID );
+            publishInput();
+            emit commandOut( command, data, timeStamp );
+            break;
+        }
+
+        default: {
+            if( !CoreHostChannel::canSend( data ) ) {
+                emit commandOut( command, data, timeStamp );
+            } else if( hostRunning ) {
+                channel.send( message );
+            } else {
+                pendingMessages.append( message );
+            }
+
+            break;
+        }
+    }
+}
+
+void LibretroCoreProxy::dataIn( DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp ) {
+    emit dataOut( type, mutex, data, bytes, timeStamp );
+
+    switch( type ) {
+        case DataType::Input: {
+            mutex->lock();
+            const GamepadState *gamepad = static_cast<GamepadState *>( data );
+            int instanceID = gamepad->instanceID;
+            LibretroPortState state = LibretroCoreMakePortState( *gamepad );
+            mutex->unlock();
+
+            controllers[ instanceID ] = state;
+            publishInput();
+            break;
+        }
+
+        case DataType::MouseInput: {
+            mutex->lock();
+            mouse = *static_cast<MouseState *>( data );
+            mutex->unlock();
+
+            publishInput();
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// Private
+
+bool LibretroCoreProxy::startHost() {
+    key = QStringLiteral( "phoenix-corehost-%1-%2" ).arg( QCoreApplication::applicationPid() ).arg( sessionCount++ );
+
+    // Input and audio
+    {
+        ioSegment.setKey( key + QStringLiteral( "-io" ) );
+
+        if( !ioSegment.create( static_cast<int>( CoreHostSegmentSize() ) ) ) {
+            qCWarning( phxCore ).nospace() << "Could not create shared memory segment " << ioSegment.key() << ": "
+                                           << ioSegment.errorString();
+            return false;
+        }
+
+        uint8_t *base = static_cast<uint8_t *>( ioSegment.data() );
+        memset( base, 0, CoreHostAudioRingOffset() );
+
+        segment = reinterpret_cast<CoreHostSegment *>( base );
+        segment->magic = COREHOST_MAGIC;
+        segment->version = COREHOST_VERSION;
+
+        audioRing.attach( base + CoreHostAudioRingOffset(), COREHOST_AUDIO_FRAMES, AUDIORING_DEFAULT_CHUNKS, true );
+        publishInput();
+    }
+
+    // Start the host and wait for it to connect
+    {
+        QLocalServer::removeServer( key );
+
+        if( !server->listen( key ) ) {
+            qCWarning( phxCore ).nospace() << "Could not listen on " << key << ": " << server->errorString();
+            stopHost();
+            return false;
+        }
+
+        QString hostPath = QCoreApplication::applicationDirPath() + QStringLiteral( "/phoenix-corehost" );
+        qCDebug( phxCore ).nospace() << "Starting core host " << hostPath << " (" << key << ")";
+        process->start( hostPath, QStringList() << QStringLiteral( "--key" ) << key );
+
+        if( !process->waitForStarted( COREHOST_CONNECT_TIMEOUT ) || !server->waitForNewConnection( COREHOST_CONNECT_TIMEOUT ) ) {
+            qCWarning( phxCore ).nospace() << "Core host did not start: " << process->errorString();
+            stopHost();
+            return false;
+        }
+
+        QLocalSocket *socket = server->nextPendingConnection();
+        connect( socket, &QLocalSocket::readyRead, this, &LibretroCoreProxy::readMessages );
+        channel.setSocket( socket );
+        server->close();
+    }
+
+    hostRunning = true;
+
+    for( const CoreHostMessage &message : pendingMessages ) {
+        channel.send( message );
+    }
+
+    pendingMessages.clear();
+
+    return true;
+}
+
+void LibretroCoreProxy::stopHost() {
+    hostRunning = false;
+    stopping = false;
+
+    if( process->state() != QProcess::NotRunning && !process->waitForFinished( COREHOST_EXIT_TIMEOUT ) ) {
+        qCWarning( phxCore ) << "Core host did not exit, killing it";
+        process->kill();
+        process->waitForFinished( COREHOST_EXIT_TIMEOUT );
+    }
+
+    if( channel.socket() ) {
+        channel.socket()->disconnect( this );
+        channel.socket()->deleteLater();
+        channel.setSocket( nullptr );
+    }
+
+    server->close();
+    pendingMessages.clear();
+
+    audioRing.free();
+    segment = nullptr;
+
+    if( ioSegment.isAttached() ) {
+        ioSegment.detach();
+    }
+
+    for( QMutex &mutex : videoMutexes ) {
+        mutex.lock();
+    }
+
+    for( int i = 0; i < POOL_SIZE; i++ ) {
+        hostVideoBuffers[ i ] = nullptr;
+        delete[] videoBuffers[ i ];
+        videoBuffers[ i ] = nullptr;
+    }
+
+    hostVideoHeader = nullptr;
+    videoBufferSize = 0;
+    videoCurrentBuffer = 0;
+
+    delete videoSegment;
+    videoSegment = nullptr;
+
+    for( QMutex &mutex : videoMutexes ) {
+        mutex.unlock();
+    }
+
+    controllers.clear();
+}
+
+void LibretroCoreProxy::hostFinished( int exitCode, QProcess::ExitStatus exitStatus ) {
+    // Whatever it logged last, a crash in particular, goes before our own messages about it
+    relayOutput( QProcess::StandardError, true );
+    relayOutput( QProcess::StandardOutput, true );
+
+    // We stopped it ourselves
+    if( !hostRunning ) {
+        return;
+    }
+
+    // Pick up whatever it managed to send before exiting, that includes Stop if it exited normally
+    readMessages();
+
+    if( !hostRunning ) {
+        return;
+    }
+
+    qCCritical( phxCore ).nospace() << "Core host exited unexpectedly (exit code " << exitCode << ", "
+                                    << ( exitStatus == QProcess::CrashExit ? "crashed" : "exited" ) << "), stopping";
+
+    // Let the rest of the pipeline unload as if the core had stopped normally
+    emit commandOut( Command::Unload, QVariant(), nodeCurrentTime() );
+    emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+
+    stopHost();
+}
+
+void LibretroCoreProxy::readMessages() {
+    CoreHostMessage message;
+
+    while( hostRunning && channel.receive( message ) ) {
+        switch( message.type ) {
+            case CoreHostMessage::Type::Command: {
+                emit commandOut( message.command, message.data, message.timeStamp );
+
+                // The host exits after sending this
+                if( message.command == Command::Stop ) {
+                    stopHost();
+                }
+
+                break;
+            }
+
+            case CoreHostMessage::Type::VideoPool: {
+                // Attach to the new pool before letting go of the old one, the host has already moved on from it
+                QSharedMemory *newSegment = new QSharedMemory( message.data.toString(), this );
+
+                quint64 poolSize = sizeof( CoreHostVideoHeader ) + message.bytes * POOL_SIZE;
+
+                if( !newSegment->attach( QSharedMemory::ReadOnly ) || static_cast<quint64>( newSegment->size() ) < poolSize ) {
+                    qCWarning( phxCore ).nospace() << "Could not attach to the core host's video " << newSegment->key()
+                                                   << ": " << newSegment->errorString();
+                    delete newSegment;
+                    newSegment = nullptr;
+                }
+
+                uint8_t *base = newSegment ? static_cast<uint8_t *>( newSegment->data() ) : nullptr;
+                hostVideoHeader = reinterpret_cast<CoreHostVideoHeader *>( base );
+
+                for( int i = 0; i < POOL_SIZE; i++ ) {
+                    hostVideoBuffers[ i ] = base ? base + sizeof( CoreHostVideoHeader ) + i * message.bytes : nullptr;
+                }
+
+                delete videoSegment;
+                videoSegment = newSegment;
+
+                // Grow our pool to match, consumers may still be reading it
+                if( message.bytes > videoBufferSize ) {
+                    for( QMutex &mutex : videoMutexes ) {
+                        mutex.lock();
+                    }
+
+                    videoBufferSize = static_cast<size_t>( message.bytes );
+
+                    for( uint8_t *&buffer : videoBuffers ) {
+                        delete[] buffer;
+                        buffer = new uint8_t[ videoBufferSize ]();
+                    }
+
+                    for( QMutex &mutex : videoMutexes ) {
+                        mutex.unlock();
+                    }
+                }
+
+                break;
+            }
+
+            case CoreHostMessage::Type::VideoFrame: {
+                int index = message.data.toInt();
+                size_t bytes = static_cast<size_t>( message.bytes );
+
+                if( index < 0 || index >= POOL_SIZE || !hostVideoBuffers[ index ] || bytes > videoBufferSize ) {
+                    break;
+                }
+
+                // Torn frames are dropped, the next one is on its way
+                copyVideoFrame( index, bytes, message.timeStamp );
+                break;
+            }
+
+            case CoreHostMessage::Type::AudioChunk: {
+                emit dataOut( DataType::Audio, nullptr, &audioRing, static_cast<size_t>( message.bytes ), message.timeStamp );
+                break;
+            }
+        }
+    }
+
+    // We can't talk to the host anymore, take it down the same way as a crash
+    if( hostRunning && channel.failed() && process->state() != QProcess::NotRunning ) {
+        qCCritical( phxCore ) << "Lost the connection to the core host, killing it";
+        process->kill();
+    }
+}
+
+bool LibretroCoreProxy::copyVideoFrame( int index, size_t bytes, qint64 timeStamp ) {
+    std::atomic<quint64> &sequence = hostVideoHeader->sequences[ index ];
+    quint64 before = sequence.load( std::memory_order_acquire );
+
+    // The host is writing into it again, we fell POOL_SIZE frames behind
+    if( before & 1 ) {
+        return false;
+    }
+
+    int buffer = videoCurrentBuffer;
+    videoMutexes[ buffer ].lock();
+    memcpy( videoBuffers[ buffer ], hostVideoBuffers[ index ], bytes );
+    videoMutexes[ buffer ].unlock();
+
+    std::atomic_thread_fence( std::memory_order_acquire );
+
+    if( sequence.load( std::memory_order_relaxed ) != before ) {
+        return false;
+    }
+
+    emit dataOut( DataType::Video, &videoMutexes[ buffer ], &videoBuffers[ buffer ], bytes, timeStamp );
+    videoCurrentBuffer = ( buffer + 1 ) % POOL_SIZE;
+    return true;
+}
+
+void LibretroCoreProxy::relayOutput( QProcess::ProcessChannel channel, bool flush ) {
+    QString source = channel == QProcess::StandardError ? QStringLiteral( "corehost" ) : QStringLiteral( "corehost stdout" );
+    process->setReadChannel( channel );
+
+    while( process->canReadLine() || ( flush && process->bytesAvailable() ) ) {
+        QByteArray line = process->readLine();
+
+        while( line.endsWith( '\n' ) || line.endsWith( '\r' ) ) {
+            line.chop( 1 );
+        }
+
+        relayLogLine( line, source );
+    }
+}
+
+void LibretroCoreProxy::publishInput() {
+    if( !segment ) {
+        return;
+    }
+
+    CoreHostInput &input = segment->input;
+    quint32 generation = input.generation.load( std::memory_order_relaxed );
+
+    // Odd while writing
+    input.generation.store( generation + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    int count = 0;
+
+    for( auto it = controllers.constBegin(); it != controllers.constEnd() && count < COREHOST_MAX_CONTROLLERS; ++it ) {
+        input.controllers[ count ].instanceID = it.key();
+        input.controllers[ count ].state = it.value();
+        count++;
+    }
+
+    input.controllerCount = count;
+    input.mouseX = mouse.position.x();
+    input.mouseY = mouse.position.y();
+    input.mouseButtons = static_cast<quint32>( mouse.buttons );
+
+    input.generation.store( generation + 2, std::memory_order_release );
+}
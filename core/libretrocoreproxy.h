@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QHash>
+#include <QLocalServer>
+#include <QMutex>
+#include <QObject>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QString>
+
+#include "audioring.h"
+#include "libretrocorehost.h"
+#include "mousestate.h"
+#include "node.h"
+
+/*
+ * LibretroCoreProxy stands in for LibretroLoader and LibretroRunner, running them in a phoenix-corehost child process
+ * instead. Each process only gets one LibretroCore (the Libretro API has no context pointer), so proxies are what would
+ * let several sessions run side by side; GameConsole only drives one session (one proxy) for now. A core that crashes
+ * only takes its host down: the proxy notices and stops the session instead of the whole frontend going with it.
+ *
+ * The host is started on SetSource and exits once it's been told to Stop. In between:
+ * - Commands are forwarded to the host, which runs them through its own LibretroLoader -> LibretroRunner pipeline and
+ *   sends back whatever comes out the other end. Those are emitted to our children as if they came from a local runner.
+ *   Heartbeats are the exception: they go to our children right away and aren't sent back
+ * - Controller and mouse input is reduced to LibretroPortStates and written to shared memory, the host picks up the
+ *   latest state at the start of each heartbeat
+ * - Video and audio stay in shared memory (see libretrocorehost.h), only a small notification goes over the socket for
+ *   each frame and audio chunk. Each video frame is copied out of the host's video buffer pool into our own, guarded by
+ *   the host buffer's sequence word: a frame the host wrote over while we copied it is dropped instead of shown torn.
+ *   Consumers lock our pool's mutexes, which the host never sees
+ *
+ * Commands carrying pointers or GamepadStates are only relayed to our children, the host can't use them. That means
+ * hardware rendered cores (no OpenGL context) and rumble are not available out of process.
+ */
+
+class LibretroCoreProxy : public Node {
+        Q_OBJECT
+
+    public:
+        explicit LibretroCoreProxy( Node *parent = nullptr );
+        ~LibretroCoreProxy();
+
+    public slots:
+        void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
+        void dataIn( DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp ) override;
+
+    private:
+        // Create the shared memory, start the host and wait for it to connect. Returns false if any of that failed
+        bool startHost();
+
+        // Wait for the host to exit (killing it if it won't) and release everything it was using
+        void stopHost();
+
+        void hostFinished( int exitCode, QProcess::ExitStatus exitStatus );
+
+        // Handle every complete message the host has sent so far
+        void readMessages();
+
+        // Copy the latest controller and mouse state into shared memory
+        void publishInput();
+
+        // Log the complete lines the host has written to channel so far (see relayLogLine()), the rest too if flush is set
+        void relayOutput( QProcess::ProcessChannel channel, bool flush );
+
+        QLocalServer *server;
+        QProcess *process;
+        CoreHostChannel channel;
+        bool hostRunning { false };
+
+        // Set once Stop has been sent, so the host exiting isn't mistaken for a crash
+        bool stopping { false };
+
+        // Base name of the socket and shared memory segments, unique to this session
+        QString key;
+
+        // Commands that arrived before the host was up, sent as soon as it connects
+        QList<CoreHostMessage> pendingMessages;
+
+        // "<key>-io": input and the audio ring, created by us
+        QSharedMemory ioSegment;
+        CoreHostSegment *segment { nullptr };
+
+        // Consumer end of the host's audio ring, sent out as the data pointer of DataType::Audio
+        AudioRing audioRing;
+
+        // "<key>-video-<n>": the host's video buffer pool, created by the host
+        QSharedMemory *videoSegment { nullptr };
+        CoreHostVideoHeader *hostVideoHeader { nullptr };
+        uint8_t *hostVideoBuffers[ POOL_SIZE ] { nullptr };
+
+        // Our own pool the host's frames are copied into and sent out from, same rules as LibretroCore's
+        QMutex videoMutexes[ POOL_SIZE ];
+        uint8_t *videoBuffers[ POOL_SIZE ] { nullptr };
+        size_t videoBufferSize { 0 };
+        int videoCurrentBuffer { 0 };
+
+        // Copy the host's buffer index out into our pool and send it out. Returns false if the host wrote over it while
+        // it was being copied
+        bool copyVideoFrame( int index, size_t bytes, qint64 timeStamp );
+
+        // Latest state of each controller, indexed by instanceID
+        QHash<int, LibretroPortState> controllers;
+        MouseState mouse;
+};
@@ -1,5 +1,7 @@
 #include "libretroloader.h"
+#include "memoryusage.h"
 
+#include <QElapsedTimer>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
@@ -9,6 +11,10 @@
 #include "SDL.h"
 #include "SDL_gamecontroller.h"
 
+#if defined( Q_OS_UNIX )
+#include <sys/mman.h>
+#endif
+
 void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp ) {
     // Command is not relayed to children automatically
 
@@ -31,7 +37,15 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
             libretroCore.systemPathInfo.setFile( libretroCore.source[ "systemPath" ] );
             libretroCore.savePathInfo.setFile( libretroCore.source[ "savePath" ] );
 
-            libretroCore.coreFile.setFileName( libretroCore.coreFileInfo.absoluteFilePath() );
+            // A core kept loaded from the last game can only be reused by a game on the same core
+            bool coreIsWarm = !libretroCore.warmCorePath.isEmpty() &&
+                              libretroCore.warmCorePath == libretroCore.coreFileInfo.absoluteFilePath();
+
+            if( !coreIsWarm ) {
+                LibretroCoreUnloadWarmCore();
+                libretroCore.coreFile.setFileName( libretroCore.coreFileInfo.absoluteFilePath() );
+            }
+
             libretroCore.gameFile.setFileName( libretroCore.gameFileInfo.absoluteFilePath() );
 
             libretroCore.contentPath.setPath( libretroCore.gameFileInfo.absolutePath() );
@@ -65,8 +79,16 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
                 libretroCore.videoFormat.videoPixelFormat = QImage::Format_RGB555;
             }
 
+            QElapsedTimer coreLoadTimer;
+            coreLoadTimer.start();
+
             // Load core
-            {
+            if( coreIsWarm ) {
+                qCDebug( phxCore ) << "Reusing core kept loaded:" << libretroCore.warmCorePath;
+
+                // Ask again anyway, the core is free to answer differently from one game to the next
+                libretroCore.symbols.retro_get_system_info( libretroCore.systemInfo );
+            } else {
                 qCDebug( phxCore ) << "Loading core:" << libretroCore.coreFileInfo.absoluteFilePath();
 
                 libretroCore.coreFile.load();
@@ -119,13 +141,19 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
                 qDebug() << "";
             }
 
-            // Flush stderr, some cores may still write to it despite having RETRO_LOG
-            fflush( stderr );
+            qCDebug( phxCore ).nospace() << "Core " << ( coreIsWarm ? "reused" : "loaded" ) << " in "
+                                         << coreLoadTimer.nsecsElapsed() / 1000000.0 << "ms";
+
+            // Count the core's performance counters from here on
+            libretroCore.perf.beginSession();
 
             // Load game
             {
                 qCDebug( phxCore ) << "Loading game:" << libretroCore.gameFileInfo.absoluteFilePath();
 
+                QElapsedTimer loadTimer;
+                loadTimer.start();
+
                 // Argument struct for symbols.retro_load_game()
                 retro_game_info gameInfo;
 
@@ -138,30 +166,61 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
                     gameInfo.meta = "";
                 }
 
-                // Full path not needed, read the file to memory and pass that to the core
+                // Full path not needed, map the file into memory and pass that to the core
+                // The file must stay open for as long as it's mapped, it's closed on unload
                 else {
-                    qCDebug( phxCore ) << "Copying game contents to memory...";
+                    qCDebug( phxCore ) << "Mapping game contents to memory...";
                     libretroCore.gameFile.open( QIODevice::ReadOnly );
 
-                    // Read into memory
-                    libretroCore.gameData = libretroCore.gameFile.readAll();
+                    qint64 size = libretroCore.gameFile.size();
+                    libretroCore.gameData = size > 0 ? libretroCore.gameFile.map( 0, size ) : nullptr;
+
+                    if( libretroCore.gameData ) {
+#if defined( Q_OS_UNIX )
+                        // The core will most likely read (copy) the whole thing front to back right away
+                        madvise( libretroCore.gameData, static_cast<size_t>( size ), MADV_SEQUENTIAL );
+                        madvise( libretroCore.gameData, static_cast<size_t>( size ), MADV_WILLNEED );
+#endif
+                        gameInfo.data = libretroCore.gameData;
+                    }
 
-                    libretroCore.gameFile.close();
+                    // Not mappable, fall back to reading the whole file in
+                    else {
+                        qCDebug( phxCore ) << "Could not map game, copying game contents to memory instead...";
+                        libretroCore.gameDataCopy = libretroCore.gameFile.readAll();
+                        libretroCore.gameFile.close();
+                        gameInfo.data = libretroCore.gameDataCopy.constData();
+                    }
 
                     gameInfo.path = nullptr;
-                    gameInfo.data = libretroCore.gameData.constData();
-                    gameInfo.size = libretroCore.gameFile.size();
+                    gameInfo.size = static_cast<size_t>( size );
                     gameInfo.meta = "";
                 }
 
-                libretroCore.symbols.retro_load_game( &gameInfo );
+                libretroCore.gameLoaded = libretroCore.symbols.retro_load_game( &gameInfo );
+
+                if( !libretroCore.gameLoaded ) {
+                    qCCritical( phxCore ) << "The core could not load" << libretroCore.gameFileInfo.absoluteFilePath();
+                }
+
+                // The core has a game again, it's no longer just being kept loaded
+                libretroCore.warmCorePath.clear();
+
+#if defined( Q_OS_UNIX )
+                // Most cores have made their own copy by now. Drop our pages from memory so the game isn't resident
+                // twice, they're faulted back in from the file if the core does read from the mapping again
+                if( libretroCore.gameData ) {
+                    madvise( libretroCore.gameData, static_cast<size_t>( libretroCore.gameFile.size() ), MADV_DONTNEED );
+                }
+#endif
+
+                qCDebug( phxCore ).nospace() << "Game loaded in " << loadTimer.nsecsElapsed() / 1000000.0 << "ms, RSS: "
+                                             << currentResidentSetSize() / ( 1024.0 * 1024.0 ) << " MB (peak: "
+                                             << peakResidentSetSize() / ( 1024.0 * 1024.0 ) << " MB)";
 
                 qDebug() << "";
             }
 
-            // Flush stderr, some cores may still write to it despite having RETRO_LOG
-            fflush( stderr );
-
             // Load save data
             LibretroCoreLoadSaveData();
 
@@ -174,32 +233,19 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
                 qCDebug( phxCore ).nospace() << "coreFPS: " << avInfo->timing.fps;
                 emit commandOut( Command::SetCoreFPS, ( qreal )( avInfo->timing.fps ), nodeCurrentTime() );
 
-                // Create the FBO which contains the texture 3d cores will draw to
+                // Create the FBOs which contain the textures 3d cores will draw to
                 if( libretroCore.videoFormat.videoMode == HARDWARERENDER ) {
                     libretroCore.context->makeCurrent( libretroCore.surface );
 
-                    // If the core has made available its max width/height at this stage, recreate the FBO with those settings
-                    // Otherwise, use a sensible default size, the core will probably set the proper size in the first frame
+                    // If the core has made available its max width/height at this stage, make the FBOs that big so the
+                    // core can switch resolutions without us allocating new ones, the frames are cropped out of them
+                    // Otherwise, use a sensible default size, the FBOs will grow if the core's video does
                     if( avInfo->geometry.max_width != 0 && avInfo->geometry.max_height != 0 ) {
-                        if( libretroCore.fbo ) {
-                            delete libretroCore.fbo;
-                        }
-
-                        libretroCore.fbo = new QOpenGLFramebufferObject( avInfo->geometry.base_width, avInfo->geometry.base_height, QOpenGLFramebufferObject::CombinedDepthStencil );
-
-                        // Clear the newly created FBO
-                        libretroCore.fbo->bind();
-                        libretroCore.context->functions()->glClear( GL_COLOR_BUFFER_BIT );
+                        QSize baseSize( avInfo->geometry.base_width, avInfo->geometry.base_height );
+                        QSize maxSize( avInfo->geometry.max_width, avInfo->geometry.max_height );
+                        LibretroCoreAllocateFramebuffers( maxSize.expandedTo( baseSize ) );
                     } else {
-                        if( libretroCore.fbo ) {
-                            delete libretroCore.fbo;
-                        }
-
-                        libretroCore.fbo = new QOpenGLFramebufferObject( 640, 480, QOpenGLFramebufferObject::CombinedDepthStencil );
-
-                        // Clear the newly created FBO
-                        libretroCore.fbo->bind();
-                        libretroCore.context->functions()->glClear( GL_COLOR_BUFFER_BIT );
+                        LibretroCoreAllocateFramebuffers( QSize( 640, 480 ) );
 
                         avInfo->geometry.max_width = 640;
                         avInfo->geometry.max_height = 480;
@@ -207,16 +253,32 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
                         avInfo->geometry.base_height = 480;
                     }
 
-                    // Tell any video output children about this texture
-                    emit commandOut( Command::SetOpenGLTexture, libretroCore.fbo->texture(), nodeCurrentTime() );
-
                     libretroCore.symbols.retro_hw_context_reset();
+                } else {
+                    // The last 3D game's FBOs won't be used by this one
+                    LibretroCoreFreeFramebufferPool();
                 }
 
                 libretroCore.getAVInfo( avInfo );
                 delete avInfo;
             }
 
+            // Set up rewind history if the core is able to serialize its state, it's allocated once snapshots are taken
+            {
+                size_t stateSize = libretroCore.symbols.retro_serialize_size();
+
+                if( stateSize ) {
+                    libretroCore.rewind.init( stateSize );
+                    libretroCore.rewindable = true;
+                    qCDebug( phxCore ).nospace() << "Rewind enabled (state size = " << stateSize / 1024.0 << " KB)";
+                } else {
+                    libretroCore.rewindable = false;
+                    qCDebug( phxCore ) << "Core cannot serialize its state, rewind disabled";
+                }
+
+                emit commandOut( Command::SetRewindable, libretroCore.rewindable, nodeCurrentTime() );
+            }
+
             // Set all variables to their defaults, mark all variables as dirty
             {
                 for( const auto &key : libretroCore.variables.keys() ) {
@@ -241,6 +303,7 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
                     emit commandOut( Command::SetLibretroVariable, var, nodeCurrentTime() );
                 }
 
+                LibretroCorePublishVariables();
                 libretroCore.variablesAreDirty = true;
             }
 
@@ -249,9 +312,6 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
             disconnect( &libretroCore, &LibretroCore::commandOut, this, &Node::commandOut );
             connectedToCore = false;
 
-            // Flush stderr, some cores may still write to it despite having RETRO_LOG
-            fflush( stderr );
-
             libretroCore.pausable = true;
             emit commandOut( Command::SetPausable, true, nodeCurrentTime() );
 
@@ -284,6 +344,12 @@ void LibretroLoader::commandIn( Command command, QVariant data, qint64 timeStamp
 
         case Command::SetOpenGLContext: {
             emit commandOut( command, data, timeStamp );
+
+            // Pooled FBOs belong to the old context
+            if( libretroCore.context != data.value<QOpenGLContext *>() ) {
+                LibretroCoreFreeFramebufferPool();
+            }
+
             libretroCore.context = data.value<QOpenGLContext *>();
             break;
         }
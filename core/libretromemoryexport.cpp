@@ -0,0 +1,334 @@
+#include "libretromemoryexport.h"
+#include "libretrocore.h"
+#include "logging.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+
+#include <errno.h>
+#include <string.h>
+
+#if defined( Q_OS_UNIX )
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const unsigned exportedTypes[ MEMORY_EXPORT_MAX_REGIONS ] = {
+        RETRO_MEMORY_SAVE_RAM,
+        RETRO_MEMORY_RTC,
+        RETRO_MEMORY_SYSTEM_RAM,
+        RETRO_MEMORY_VIDEO_RAM,
+    };
+
+    // Keep each region's data on its own cache lines
+    inline size_t alignUp( size_t value ) {
+        return ( value + 63 ) & ~static_cast<size_t>( 63 );
+    }
+
+    // Write the region's data into the segment under its seqlock
+    void copyRegion( uint8_t *base, MemoryExportRegion &region, const uint8_t *data, size_t size, quint64 frame ) {
+        quint64 generation = region.generation.load( std::memory_order_relaxed );
+
+        // Odd while writing
+        region.generation.store( generation + 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+
+        memcpy( base + region.offset, data, qMin( size, static_cast<size_t>( region.size ) ) );
+        region.frame.store( frame, std::memory_order_relaxed );
+
+        region.generation.store( generation + 2, std::memory_order_release );
+    }
+
+    // True unless something keeps other processes from reading ours, which in-place readers have to do
+    bool readableInPlace() {
+#if defined( Q_OS_LINUX )
+        QFile yama( QStringLiteral( "/proc/sys/kernel/yama/ptrace_scope" ) );
+
+        // No Yama, any process running as the same user may read ours
+        if( !yama.open( QIODevice::ReadOnly ) ) {
+            return true;
+        }
+
+        return yama.readAll().trimmed().toInt() == 0;
+#else
+        return true;
+#endif
+    }
+
+#if defined( Q_OS_UNIX )
+    // True if the segment shmName was left behind by a process that's gone (or by this one)
+    bool segmentIsStale( const QByteArray &shmName ) {
+        int fd = shm_open( shmName.constData(), O_RDONLY, 0 );
+
+        if( fd < 0 ) {
+            return errno == ENOENT;
+        }
+
+        quint64 pid = 0;
+        struct stat info;
+
+        if( fstat( fd, &info ) == 0 && info.st_size >= static_cast<off_t>( sizeof( MemoryExportHeader ) ) ) {
+            void *mapping = mmap( nullptr, sizeof( MemoryExportHeader ), PROT_READ, MAP_SHARED, fd, 0 );
+
+            if( mapping != MAP_FAILED ) {
+                pid = static_cast<const MemoryExportHeader *>( mapping )->pid;
+                munmap( mapping, sizeof( MemoryExportHeader ) );
+            }
+        }
+
+        close( fd );
+
+        // The process that made it died before it got to write its ID
+        if( !pid || pid == static_cast<quint64>( QCoreApplication::applicationPid() ) ) {
+            return true;
+        }
+
+        return kill( static_cast<pid_t>( pid ), 0 ) != 0 && errno == ESRCH;
+    }
+#endif
+}
+
+LibretroMemoryExport::~LibretroMemoryExport() {
+    stop();
+}
+
+bool LibretroMemoryExport::start( int copyInterval, QString name ) {
+    stop();
+
+    if( name.isEmpty() ) {
+        name = QStringLiteral( MEMORY_EXPORT_NAME_PREFIX ) + QString::number( QCoreApplication::applicationPid() );
+    }
+
+    this->copyInterval = qMax( 0, copyInterval );
+
+    if( !this->copyInterval && !readableInPlace() ) {
+        qCWarning( phxCore ) << "Other processes aren't allowed to read Phoenix's memory (kernel.yama.ptrace_scope is"
+                             << "not 0), exporting memory by copying it every frame instead of in place";
+        this->copyInterval = 1;
+    }
+
+    bool inPlace = !this->copyInterval;
+
+    sourceCount = 0;
+    size_t segmentSize = alignUp( sizeof( MemoryExportHeader ) );
+
+    for( unsigned type : exportedTypes ) {
+        void *data = libretroCore.symbols.retro_get_memory_data( type );
+        size_t size = libretroCore.symbols.retro_get_memory_size( type );
+
+        if( !data || !size ) {
+            continue;
+        }
+
+        sources[ sourceCount ] = Source { type, static_cast<const uint8_t *>( data ), size };
+        sourceCount++;
+
+        if( !inPlace ) {
+            segmentSize += alignUp( size );
+        }
+    }
+
+    if( !sourceCount ) {
+        qCWarning( phxCore ) << "Cannot export memory, the core does not expose any";
+        return false;
+    }
+
+    if( !createSegment( name, segmentSize ) ) {
+        return false;
+    }
+
+    header = reinterpret_cast<MemoryExportHeader *>( base );
+    memset( static_cast<void *>( base ), 0, segmentSize );
+
+    header->version = MEMORY_EXPORT_VERSION;
+    header->regionCount = MEMORY_EXPORT_MAX_REGIONS;
+    header->sessionID = static_cast<quint64>( QDateTime::currentMSecsSinceEpoch() );
+    header->pid = static_cast<quint64>( QCoreApplication::applicationPid() );
+
+    size_t offset = alignUp( sizeof( MemoryExportHeader ) );
+
+    for( int i = 0; i < sourceCount; i++ ) {
+        MemoryExportRegion &region = header->regions[ i ];
+        region.type = sources[ i ].type;
+        region.flags = inPlace ? MEMORY_EXPORT_REGION_IN_PLACE : 0;
+        region.size = sources[ i ].size;
+        region.address = reinterpret_cast<quintptr>( sources[ i ].data );
+        region.frame.store( libretroCore.frameCount, std::memory_order_relaxed );
+
+        if( !inPlace ) {
+            region.offset = offset;
+            offset += alignUp( sources[ i ].size );
+            copyRegion( base, region, sources[ i ].data, sources[ i ].size, libretroCore.frameCount );
+        }
+    }
+
+    lastCopyFrame = libretroCore.frameCount;
+    segmentName = name;
+
+    // Readers check this last, so write it last
+    std::atomic_thread_fence( std::memory_order_release );
+    header->magic = MEMORY_EXPORT_MAGIC;
+
+    qCDebug( phxCore ).nospace() << "Exporting " << sourceCount << " memory regions "
+                                 << ( inPlace ? "in place" : "by copy" ) << " (" << segmentSize / 1024.0
+                                 << " KB) as shared memory segment " << name;
+
+    return true;
+}
+
+void LibretroMemoryExport::stop() {
+    if( header ) {
+        header->magic = 0;
+        header = nullptr;
+    }
+
+    destroySegment();
+    sourceCount = 0;
+    segmentName.clear();
+}
+
+bool LibretroMemoryExport::isActive() const {
+    return header != nullptr;
+}
+
+QString LibretroMemoryExport::name() const {
+    return segmentName;
+}
+
+void LibretroMemoryExport::beginFrames() {
+    // Only the outermost pair counts, loading a state during a heartbeat happens inside the heartbeat's
+    if( frameDepth++ || !header || copyInterval ) {
+        return;
+    }
+
+    // The core is about to write to its memory, readers reading in place should wait
+    for( int i = 0; i < sourceCount; i++ ) {
+        MemoryExportRegion &region = header->regions[ i ];
+        region.generation.store( region.generation.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    }
+
+    std::atomic_thread_fence( std::memory_order_release );
+}
+
+void LibretroMemoryExport::endFrames( quint64 frame ) {
+    if( --frameDepth || !header ) {
+        return;
+    }
+
+    if( !copyInterval ) {
+        for( int i = 0; i < sourceCount; i++ ) {
+            MemoryExportRegion &region = header->regions[ i ];
+            updateAddress( region, sources[ i ] );
+            region.frame.store( frame, std::memory_order_relaxed );
+            region.generation.store( region.generation.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        return;
+    }
+
+    if( frame - lastCopyFrame < static_cast<quint64>( copyInterval ) ) {
+        return;
+    }
+
+    lastCopyFrame = frame;
+
+    for( int i = 0; i < sourceCount; i++ ) {
+        MemoryExportRegion &region = header->regions[ i ];
+        updateAddress( region, sources[ i ] );
+        copyRegion( base, region, sources[ i ].data, sources[ i ].size, frame );
+    }
+}
+
+// Private
+
+bool LibretroMemoryExport::createSegment( const QString &name, size_t size ) {
+#if defined( Q_OS_UNIX )
+    shmName = '/' + name.toUtf8();
+
+    int fd = shm_open( shmName.constData(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+
+    // A segment left behind by a crash sticks around until it's unlinked, one still in use is left alone
+    if( fd < 0 && errno == EEXIST ) {
+        if( !segmentIsStale( shmName ) ) {
+            qCWarning( phxCore ).nospace() << "Could not create shared memory segment " << name
+                                           << ": another running process is using it";
+            shmName.clear();
+            return false;
+        }
+
+        shm_unlink( shmName.constData() );
+        fd = shm_open( shmName.constData(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+    }
+
+    if( fd < 0 ) {
+        qCWarning( phxCore ).nospace() << "Could not create shared memory segment " << name << ": " << strerror( errno );
+        shmName.clear();
+        return false;
+    }
+
+    void *mapping = MAP_FAILED;
+
+    if( ftruncate( fd, static_cast<off_t>( size ) ) == 0 ) {
+        mapping = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    }
+
+    int error = errno;
+    close( fd );
+
+    if( mapping == MAP_FAILED ) {
+        qCWarning( phxCore ).nospace() << "Could not map shared memory segment " << name << ": " << strerror( error );
+        shm_unlink( shmName.constData() );
+        shmName.clear();
+        return false;
+    }
+
+    base = static_cast<uint8_t *>( mapping );
+    mappingSize = size;
+    return true;
+#else
+    // The native key is used as the file mapping object's name as-is, so tools that aren't built with Qt can open it
+    segment.setNativeKey( name );
+
+    if( !segment.create( static_cast<int>( size ) ) ) {
+        qCWarning( phxCore ).nospace() << "Could not create shared memory segment " << name << ": " << segment.errorString();
+        return false;
+    }
+
+    base = static_cast<uint8_t *>( segment.data() );
+    return true;
+#endif
+}
+
+void LibretroMemoryExport::destroySegment() {
+#if defined( Q_OS_UNIX )
+    if( base ) {
+        munmap( base, mappingSize );
+        mappingSize = 0;
+    }
+
+    if( !shmName.isEmpty() ) {
+        shm_unlink( shmName.constData() );
+        shmName.clear();
+    }
+#else
+    if( segment.isAttached() ) {
+        segment.detach();
+    }
+#endif
+
+    base = nullptr;
+}
+
+void LibretroMemoryExport::updateAddress( MemoryExportRegion &region, Source &source ) {
+    void *data = libretroCore.symbols.retro_get_memory_data( source.type );
+
+    if( data && data != source.data ) {
+        source.data = static_cast<const uint8_t *>( data );
+        region.address = reinterpret_cast<quintptr>( data );
+    }
+}
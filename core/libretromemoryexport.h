@@ -0,0 +1,149 @@
+#pragma once
+
+#include <QSharedMemory>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// The shared memory segment is named this followed by the ID of the process exporting (the core host's out of process),
+// so sessions never step on each other: shm_open( "/phoenix-memory-1234" ) on Unix (on Linux that's
+// /dev/shm/phoenix-memory-1234), a file mapping object named "phoenix-memory-1234" on Windows
+#define MEMORY_EXPORT_NAME_PREFIX "phoenix-memory-"
+
+// "PHXMEM01" as a little-endian integer
+#define MEMORY_EXPORT_MAGIC Q_UINT64_C( 0x31304D454D584850 )
+#define MEMORY_EXPORT_VERSION 2
+
+// One slot per RETRO_MEMORY_* type exported: SAVE_RAM, RTC, SYSTEM_RAM, VIDEO_RAM
+#define MEMORY_EXPORT_MAX_REGIONS 4
+
+// MemoryExportRegion::flags: the region's data isn't copied into the segment, it's at address in process pid
+#define MEMORY_EXPORT_REGION_IN_PLACE 0x1
+
+/*
+ * Layout of the shared memory segment, for external tools (trackers, analysis scripts...) to read the game's memory
+ * without going through Phoenix.
+ *
+ * The segment starts with a MemoryExportHeader. Regions with a size of 0 aren't exposed by the running core. The layout
+ * only changes when a game is loaded: check magic, version and sessionID before trusting it. Where a region's data is
+ * depends on the mode the export was started in:
+ *     Copy mode: the data is copied into the segment at offset every N frames
+ *     In-place mode (MEMORY_EXPORT_REGION_IN_PLACE): nothing is copied, the data is the core's own buffer at address in
+ *     Phoenix's address space. Read it with process_vm_readv() (Linux), mach_vm_read_overwrite() (macOS) or
+ *     ReadProcessMemory() (Windows). address may change between frames if the core reallocates. The reader needs
+ *     permission to read another process's memory: on Linux that's ptrace access, which Yama (kernel.yama.ptrace_scope
+ *     1 or more, the default on Ubuntu and others) denies to processes that aren't Phoenix's ancestors unless they have
+ *     CAP_SYS_PTRACE. Phoenix falls back to copy mode when Yama is in the way
+ *
+ * Each region is guarded by its own generation counter (a seqlock), so any number of readers can poll without locks and
+ * without ever stalling the game:
+ *     1. Read generation. If it's odd, the region is being written, try again
+ *     2. Copy what you need out of the region
+ *     3. Read generation again. If it changed, your copy may be torn, try again
+ * In copy mode it's odd while the copy is written. In in-place mode it's odd while the core is emulating or loading a
+ * state, so it goes up by 2 every heartbeat.
+ *
+ * frame is the number of frames the game had emulated (LibretroCore::frameCount) as of the data in the region.
+ */
+
+struct alignas( 64 ) MemoryExportRegion {
+    // RETRO_MEMORY_* type
+    quint32 type;
+    quint32 flags;
+
+    // Copy mode: where this region's data is, relative to the start of the segment
+    quint64 offset;
+    quint64 size;
+
+    // Where the core keeps this region, in the address space of process pid
+    quint64 address;
+
+    std::atomic<quint64> generation;
+    std::atomic<quint64> frame;
+};
+
+struct alignas( 64 ) MemoryExportHeader {
+    quint64 magic;
+    quint32 version;
+    quint32 regionCount;
+
+    // Changes every time a game is loaded, readers should start over when it does
+    quint64 sessionID;
+
+    // Phoenix's process ID, for reading regions in place
+    quint64 pid;
+
+    MemoryExportRegion regions[ MEMORY_EXPORT_MAX_REGIONS ];
+};
+
+/*
+ * LibretroMemoryExport publishes the memory a Libretro core exposes through retro_get_memory_data() in a shared memory
+ * segment with the layout above.
+ *
+ * In copy mode each region is copied into the segment every copyInterval frames, between frames on the game thread
+ * (never inside retro_run()). In in-place mode the only work per heartbeat is bumping a few counters, readers read the
+ * core's buffers directly.
+ *
+ * Not thread-safe, only use this from the game thread.
+ */
+
+class LibretroMemoryExport {
+    public:
+        LibretroMemoryExport() = default;
+        ~LibretroMemoryExport();
+
+        // Create the segment for the core's current memory regions, copying them into it every copyInterval frames or
+        // exporting them in place if copyInterval is 0 (and readers would be allowed to, copying every frame otherwise).
+        // An empty name uses MEMORY_EXPORT_NAME_PREFIX and this process's ID. Returns false if it could not be created
+        bool start( int copyInterval, QString name = QString() );
+
+        // Destroy the segment
+        void stop();
+
+        bool isActive() const;
+
+        // Name of the segment, empty if inactive
+        QString name() const;
+
+        // Call around emulating frames or anything else that writes to the core's memory, endFrames() with
+        // libretroCore.frameCount as of afterwards. Pairs can be nested, only the outermost one counts
+        void beginFrames();
+        void endFrames( quint64 frame );
+
+    private:
+        struct Source {
+            unsigned type;
+            const uint8_t *data;
+            size_t size;
+        };
+
+        // Create and map a segment of the given size, fills in base. A segment left behind under that name is replaced
+        // if the process that made it is gone
+        bool createSegment( const QString &name, size_t size );
+        void destroySegment();
+
+        // Point region at where the core keeps source now
+        void updateAddress( MemoryExportRegion &region, Source &source );
+
+#if defined( Q_OS_UNIX )
+        QByteArray shmName;
+        size_t mappingSize { 0 };
+#else
+        QSharedMemory segment;
+#endif
+
+        QString segmentName;
+        uint8_t *base { nullptr };
+        MemoryExportHeader *header { nullptr };
+        Source sources[ MEMORY_EXPORT_MAX_REGIONS ] {};
+        int sourceCount { 0 };
+
+        int copyInterval { 0 };
+        quint64 lastCopyFrame { 0 };
+
+        // beginFrames() calls not yet matched by endFrames()
+        int frameDepth { 0 };
+};
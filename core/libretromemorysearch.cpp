@@ -0,0 +1,269 @@
+#include "libretromemorysearch.h"
+#include "libretro.h"
+
+#include <QtAlgorithms>
+
+#include <string.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define MEMORYSEARCH_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Bytes compared per step, one SSE2 register's worth and one candidate word's worth
+    const size_t blockSize = 16;
+
+    typedef LibretroMemorySearch::Comparison Comparison;
+
+    inline bool comparedToSnapshot( Comparison comparison ) {
+        return comparison == Comparison::Changed || comparison == Comparison::Unchanged ||
+               comparison == Comparison::Increased || comparison == Comparison::Decreased;
+    }
+
+    template<Comparison comparison>
+    inline bool matchesByte( uint8_t current, uint8_t other ) {
+        switch( comparison ) {
+            case Comparison::Changed:
+            case Comparison::NotEqual:
+                return current != other;
+
+            case Comparison::Unchanged:
+            case Comparison::Equal:
+                return current == other;
+
+            case Comparison::Increased:
+            case Comparison::Greater:
+                return current > other;
+
+            case Comparison::Decreased:
+            case Comparison::Less:
+                return current < other;
+        }
+
+        return false;
+    }
+
+    // Bit i is set if byte i of current matches against byte i of other (the snapshot or the value, broadcast)
+    template<Comparison comparison>
+    inline quint16 matchBlock( const uint8_t *current, const uint8_t *other ) {
+#if defined( MEMORYSEARCH_USE_SSE2 )
+        __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i *>( current ) );
+        __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i *>( other ) );
+
+        // SSE2 only has signed byte comparisons, flipping the top bit turns unsigned order into signed order
+        const __m128i bias = _mm_set1_epi8( static_cast<char>( 0x80 ) );
+
+        switch( comparison ) {
+            case Comparison::Changed:
+            case Comparison::NotEqual:
+                return static_cast<quint16>( ~_mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) ) );
+
+            case Comparison::Unchanged:
+            case Comparison::Equal:
+                return static_cast<quint16>( _mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) ) );
+
+            case Comparison::Increased:
+            case Comparison::Greater:
+                return static_cast<quint16>( _mm_movemask_epi8(
+                    _mm_cmpgt_epi8( _mm_xor_si128( a, bias ), _mm_xor_si128( b, bias ) ) ) );
+
+            case Comparison::Decreased:
+            case Comparison::Less:
+                return static_cast<quint16>( _mm_movemask_epi8(
+                    _mm_cmpgt_epi8( _mm_xor_si128( b, bias ), _mm_xor_si128( a, bias ) ) ) );
+        }
+
+        return 0;
+#else
+        quint16 mask = 0;
+
+        for( size_t i = 0; i < blockSize; i++ ) {
+            mask |= static_cast<quint16>( matchesByte<comparison>( current[ i ], other[ i ] ) ) << i;
+        }
+
+        return mask;
+#endif
+    }
+
+    template<Comparison comparison>
+    qint64 searchRegion( const uint8_t *memory, uint8_t *snapshot, quint16 *candidates, size_t size, quint8 value ) {
+        const bool useSnapshot = comparedToSnapshot( comparison );
+        uint8_t broadcast[ blockSize ];
+        memset( broadcast, value, blockSize );
+
+        size_t blocks = size / blockSize;
+        qint64 count = 0;
+
+        for( size_t block = 0; block < blocks; block++ ) {
+            const uint8_t *current = memory + block * blockSize;
+            uint8_t *previous = snapshot + block * blockSize;
+
+            // Blocks with no candidates left only need their snapshot updated
+            if( candidates[ block ] ) {
+                candidates[ block ] &= matchBlock<comparison>( current, useSnapshot ? previous : broadcast );
+                count += qPopulationCount( candidates[ block ] );
+            }
+
+            memcpy( previous, current, blockSize );
+        }
+
+        // Leftover bytes at the end of the region
+        size_t tail = size % blockSize;
+
+        if( tail ) {
+            const uint8_t *current = memory + blocks * blockSize;
+            uint8_t *previous = snapshot + blocks * blockSize;
+            quint16 mask = 0;
+
+            for( size_t i = 0; i < tail; i++ ) {
+                mask |= static_cast<quint16>( matchesByte<comparison>( current[ i ], useSnapshot ? previous[ i ] : value ) ) << i;
+            }
+
+            candidates[ blocks ] &= mask;
+            count += qPopulationCount( candidates[ blocks ] );
+            memcpy( previous, current, tail );
+        }
+
+        return count;
+    }
+}
+
+qint64 LibretroMemorySearchRegion( const uint8_t *memory, uint8_t *snapshot, quint16 *candidates, size_t size,
+                                   Comparison comparison, quint8 value ) {
+    switch( comparison ) {
+        case Comparison::Changed:
+            return searchRegion<Comparison::Changed>( memory, snapshot, candidates, size, value );
+
+        case Comparison::Unchanged:
+            return searchRegion<Comparison::Unchanged>( memory, snapshot, candidates, size, value );
+
+        case Comparison::Increased:
+            return searchRegion<Comparison::Increased>( memory, snapshot, candidates, size, value );
+
+        case Comparison::Decreased:
+            return searchRegion<Comparison::Decreased>( memory, snapshot, candidates, size, value );
+
+        case Comparison::Equal:
+            return searchRegion<Comparison::Equal>( memory, snapshot, candidates, size, value );
+
+        case Comparison::NotEqual:
+            return searchRegion<Comparison::NotEqual>( memory, snapshot, candidates, size, value );
+
+        case Comparison::Greater:
+            return searchRegion<Comparison::Greater>( memory, snapshot, candidates, size, value );
+
+        case Comparison::Less:
+            return searchRegion<Comparison::Less>( memory, snapshot, candidates, size, value );
+    }
+
+    return 0;
+}
+
+QVector<LibretroMemoryRegion> LibretroMemorySearch::regionsFromDescriptors( const QVector<retro_memory_descriptor> &descriptors ) {
+    QVector<LibretroMemoryRegion> result;
+
+    for( const retro_memory_descriptor &descriptor : descriptors ) {
+        // Nothing there (open bus, registers) or ROM
+        if( !descriptor.ptr || !descriptor.len || ( descriptor.flags & RETRO_MEMDESC_CONST ) ) {
+            continue;
+        }
+
+        uint8_t *data = static_cast<uint8_t *>( descriptor.ptr ) + descriptor.offset;
+        bool mirror = false;
+
+        for( const LibretroMemoryRegion &region : result ) {
+            if( data >= region.data && data < region.data + region.size ) {
+                mirror = true;
+                break;
+            }
+        }
+
+        if( !mirror ) {
+            result.append( LibretroMemoryRegion { data, descriptor.len, descriptor.start } );
+        }
+    }
+
+    return result;
+}
+
+void LibretroMemorySearch::reset( const QVector<LibretroMemoryRegion> &regions ) {
+    clear();
+
+    for( const LibretroMemoryRegion &memory : regions ) {
+        Region region;
+        region.memory = memory;
+        region.snapshot.resize( static_cast<int>( memory.size ) );
+        memcpy( region.snapshot.data(), memory.data, memory.size );
+
+        // Every byte starts out a candidate, except for the padding past the end of the last block
+        int blocks = static_cast<int>( ( memory.size + blockSize - 1 ) / blockSize );
+        region.candidates.fill( 0xFFFF, blocks );
+
+        if( memory.size % blockSize ) {
+            region.candidates[ blocks - 1 ] = static_cast<quint16>( ( 1u << ( memory.size % blockSize ) ) - 1 );
+        }
+
+        candidateCount += static_cast<qint64>( memory.size );
+        this->regions.append( region );
+    }
+}
+
+void LibretroMemorySearch::clear() {
+    regions.clear();
+    candidateCount = 0;
+}
+
+bool LibretroMemorySearch::isActive() const {
+    return !regions.isEmpty();
+}
+
+qint64 LibretroMemorySearch::search( Comparison comparison, quint8 value ) {
+    candidateCount = 0;
+
+    for( Region &region : regions ) {
+        candidateCount += LibretroMemorySearchRegion( region.memory.data, region.snapshot.data(), region.candidates.data(),
+                                                      region.memory.size, comparison, value );
+    }
+
+    return candidateCount;
+}
+
+qint64 LibretroMemorySearch::count() const {
+    return candidateCount;
+}
+
+QVector<LibretroMemoryMatch> LibretroMemorySearch::matches( int maxMatches ) const {
+    QVector<LibretroMemoryMatch> result;
+
+    for( const Region &region : regions ) {
+        for( int block = 0; block < region.candidates.size(); block++ ) {
+            quint16 mask = region.candidates[ block ];
+
+            for( size_t bit = 0; mask; bit++, mask >>= 1 ) {
+                if( !( mask & 1 ) ) {
+                    continue;
+                }
+
+                if( result.size() == maxMatches ) {
+                    return result;
+                }
+
+                size_t offset = static_cast<size_t>( block ) * blockSize + bit;
+                result.append( LibretroMemoryMatch { region.memory.address + offset, region.snapshot[ static_cast<int>( offset ) ] } );
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t LibretroMemorySearch::size() const {
+    size_t total = 0;
+
+    for( const Region &region : regions ) {
+        total += region.memory.size;
+    }
+
+    return total;
+}
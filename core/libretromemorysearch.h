@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct retro_memory_descriptor;
+
+// A contiguous block of the core's memory and where it sits in the emulated address space
+struct LibretroMemoryRegion {
+    uint8_t *data;
+    size_t size;
+    size_t address;
+};
+
+// A byte still matching every search so far
+struct LibretroMemoryMatch {
+    size_t address;
+    quint8 value;
+};
+
+/*
+ * LibretroMemorySearch narrows down which bytes of the core's RAM hold a value of interest (lives, health, a timer...)
+ * by repeatedly comparing RAM against the snapshot taken at the previous search, or against a constant.
+ *
+ * reset() snapshots every region and makes every byte a candidate. Each search() then drops the candidates that don't
+ * satisfy the comparison and re-snapshots RAM for the next one. Comparisons are unsigned and byte-sized.
+ *
+ * Comparisons run 16 bytes at a time with SSE2 (scalar elsewhere) and candidates are kept as a bitmap, so a search costs
+ * about one pass over RAM and its snapshot: a few milliseconds for 8MB, quick enough to run between two frames.
+ *
+ * Not thread-safe. The regions point straight into the core's memory, only search from the game thread and reset() again
+ * (or clear()) whenever the core is reloaded.
+ */
+
+class LibretroMemorySearch {
+    public:
+        enum class Comparison {
+            // Compared to the previous snapshot
+            Changed,
+            Unchanged,
+            Increased,
+            Decreased,
+
+            // Compared to the given value
+            Equal,
+            NotEqual,
+            Greater,
+            Less,
+        };
+
+        // Collect the writable, non-null memory described by a core's SET_MEMORY_MAPS descriptors. Descriptors that
+        // mirror memory another one already covers are skipped
+        static QVector<LibretroMemoryRegion> regionsFromDescriptors( const QVector<retro_memory_descriptor> &descriptors );
+
+        // Snapshot the given regions, every byte becomes a candidate
+        void reset( const QVector<LibretroMemoryRegion> &regions );
+
+        // Forget the regions and release all memory
+        void clear();
+
+        bool isActive() const;
+
+        // Drop every candidate that doesn't satisfy the comparison, then snapshot RAM again. value is ignored for the
+        // comparisons against the previous snapshot. Returns the number of candidates left
+        qint64 search( Comparison comparison, quint8 value = 0 );
+
+        // Number of candidates left
+        qint64 count() const;
+
+        // Up to maxMatches candidates in address order, with their value as of the last snapshot
+        QVector<LibretroMemoryMatch> matches( int maxMatches ) const;
+
+        // Total bytes being searched
+        size_t size() const;
+
+    private:
+        struct Region {
+            LibretroMemoryRegion memory;
+
+            // RAM as of the last reset() or search()
+            QVector<uint8_t> snapshot;
+
+            // Bit i of block b is set if byte ( b * 16 + i ) is still a candidate
+            QVector<quint16> candidates;
+        };
+
+        QVector<Region> regions;
+        qint64 candidateCount { 0 };
+};
+
+// Single region kernel, exposed for benchmarking and checking against a reference implementation
+// Returns the number of candidates left in the region
+qint64 LibretroMemorySearchRegion( const uint8_t *memory, uint8_t *snapshot, quint16 *candidates, size_t size,
+                                   LibretroMemorySearch::Comparison comparison, quint8 value );
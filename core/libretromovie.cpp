@@ -0,0 +1,118 @@
+#include "libretromovie.h"
+#include "logging.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+bool LibretroMovieWriteHeader( QIODevice *device, const LibretroMovieHeader &header ) {
+    uchar bytes[ LIBRETRO_MOVIE_HEADER_SIZE ] {};
+    qToLittleEndian<quint64>( header.magic, bytes );
+    qToLittleEndian<quint32>( header.version, bytes + 8 );
+    qToLittleEndian<quint32>( header.portCount, bytes + 12 );
+    qToLittleEndian<quint64>( header.frameCount, bytes + LIBRETRO_MOVIE_FRAME_COUNT_OFFSET );
+    qToLittleEndian<quint32>( header.stateSize, bytes + 24 );
+    memcpy( bytes + 32, header.library, sizeof( header.library ) );
+    bytes[ LIBRETRO_MOVIE_HEADER_SIZE - 1 ] = '\0';
+
+    return device->write( reinterpret_cast<const char *>( bytes ), sizeof( bytes ) ) == sizeof( bytes );
+}
+
+bool LibretroMovieReadHeader( QIODevice *device, LibretroMovieHeader &header ) {
+    uchar bytes[ LIBRETRO_MOVIE_HEADER_SIZE ];
+
+    if( device->read( reinterpret_cast<char *>( bytes ), sizeof( bytes ) ) != sizeof( bytes ) ) {
+        qCWarning( phxCore ) << "Not a movie: file is too short";
+        return false;
+    }
+
+    header.magic = qFromLittleEndian<quint64>( bytes );
+    header.version = qFromLittleEndian<quint32>( bytes + 8 );
+    header.portCount = qFromLittleEndian<quint32>( bytes + 12 );
+    header.frameCount = qFromLittleEndian<quint64>( bytes + LIBRETRO_MOVIE_FRAME_COUNT_OFFSET );
+    header.stateSize = qFromLittleEndian<quint32>( bytes + 24 );
+    memcpy( header.library, bytes + 32, sizeof( header.library ) );
+    header.library[ sizeof( header.library ) - 1 ] = '\0';
+
+    if( header.magic != LIBRETRO_MOVIE_MAGIC ) {
+        qCWarning( phxCore ) << "Not a movie: bad magic";
+        return false;
+    }
+
+    if( header.version != LIBRETRO_MOVIE_VERSION || header.portCount != LIBRETRO_MAX_PORTS ) {
+        qCWarning( phxCore ) << "Unsupported movie version" << header.version << "with" << header.portCount << "ports";
+        return false;
+    }
+
+    return true;
+}
+
+QByteArray LibretroMovieLibrary() {
+    QByteArray library = QByteArray( libretroCore.systemInfo->library_name ) + ' ' +
+                         QByteArray( libretroCore.systemInfo->library_version );
+    return library.left( static_cast<int>( sizeof( LibretroMovieHeader::library ) ) - 1 );
+}
+
+void LibretroMovieEncodeFrame( QByteArray &out, const LibretroPortState *ports, LibretroPortState *previous ) {
+    quint8 changedPorts = 0;
+
+    for( int port = 0; port < LIBRETRO_MAX_PORTS; port++ ) {
+        if( memcmp( &ports[ port ], &previous[ port ], sizeof( LibretroPortState ) ) ) {
+            changedPorts |= 1 << port;
+        }
+    }
+
+    out.append( static_cast<char>( changedPorts ) );
+
+    for( int port = 0; port < LIBRETRO_MAX_PORTS; port++ ) {
+        if( !( changedPorts & ( 1 << port ) ) ) {
+            continue;
+        }
+
+        uchar bytes[ LIBRETRO_MOVIE_PORT_SIZE ];
+        qToLittleEndian<quint16>( ports[ port ].buttons, bytes );
+        qToLittleEndian<qint16>( ports[ port ].analog[ 0 ][ 0 ], bytes + 2 );
+        qToLittleEndian<qint16>( ports[ port ].analog[ 0 ][ 1 ], bytes + 4 );
+        qToLittleEndian<qint16>( ports[ port ].analog[ 1 ][ 0 ], bytes + 6 );
+        qToLittleEndian<qint16>( ports[ port ].analog[ 1 ][ 1 ], bytes + 8 );
+        out.append( reinterpret_cast<const char *>( bytes ), sizeof( bytes ) );
+
+        previous[ port ] = ports[ port ];
+    }
+}
+
+size_t LibretroMovieDecodeFrame( const char *data, size_t size, LibretroPortState *ports ) {
+    if( size < 1 ) {
+        return 0;
+    }
+
+    quint8 changedPorts = static_cast<quint8>( data[ 0 ] );
+    size_t recordSize = 1;
+
+    for( int port = 0; port < LIBRETRO_MAX_PORTS; port++ ) {
+        if( changedPorts & ( 1 << port ) ) {
+            recordSize += LIBRETRO_MOVIE_PORT_SIZE;
+        }
+    }
+
+    if( size < recordSize ) {
+        return 0;
+    }
+
+    const uchar *bytes = reinterpret_cast<const uchar *>( data ) + 1;
+
+    for( int port = 0; port < LIBRETRO_MAX_PORTS; port++ ) {
+        if( !( changedPorts & ( 1 << port ) ) ) {
+            continue;
+        }
+
+        ports[ port ].buttons = qFromLittleEndian<quint16>( bytes );
+        ports[ port ].analog[ 0 ][ 0 ] = qFromLittleEndian<qint16>( bytes + 2 );
+        ports[ port ].analog[ 0 ][ 1 ] = qFromLittleEndian<qint16>( bytes + 4 );
+        ports[ port ].analog[ 1 ][ 0 ] = qFromLittleEndian<qint16>( bytes + 6 );
+        ports[ port ].analog[ 1 ][ 1 ] = qFromLittleEndian<qint16>( bytes + 8 );
+        bytes += LIBRETRO_MOVIE_PORT_SIZE;
+    }
+
+    return recordSize;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QtGlobal>
+
+#include <stddef.h>
+
+#include "libretrocore.h"
+
+// "PHXMOV01" as a little-endian integer
+#define LIBRETRO_MOVIE_MAGIC Q_UINT64_C( 0x3130564F4D584850 )
+#define LIBRETRO_MOVIE_VERSION 1
+
+// Bytes taken by the fixed part of the header
+#define LIBRETRO_MOVIE_HEADER_SIZE 96
+
+// Where frameCount is in the header, it's only known once recording stops
+#define LIBRETRO_MOVIE_FRAME_COUNT_OFFSET 16
+
+// Bytes taken by each changed port in a frame record: buttons then the four analog axes
+#define LIBRETRO_MOVIE_PORT_SIZE 10
+
+/*
+ * A movie is the input a Libretro core saw, frame by frame, starting from a serialized state. Replaying it on the same
+ * core and game makes the core produce the very same frames again, however fast or slow the heartbeat goes.
+ *
+ * File layout, all integers little-endian:
+ *     Header (LIBRETRO_MOVIE_HEADER_SIZE bytes):
+ *         quint64 magic, quint32 version, quint32 portCount, quint64 frameCount, quint32 stateSize, quint32 reserved,
+ *         char library[ 64 ] (the core's library_name and library_version, NUL-terminated)
+ *     uint8_t state[ stateSize ] (retro_serialize() as of the first frame, empty if the core can't serialize)
+ *     Frame records, one per frame that moved the game forward (LibretroCore::frameCount), in order:
+ *         quint8 changedPorts (bit n is set if port n's state differs from the previous frame's, all ports start out
+ *         released and centered), then for each changed port in order: quint16 buttons, qint16 analog[ 2 ][ 2 ]
+ *
+ * A frame in which nobody touched anything costs a byte.
+ *
+ * Only joypad and analog input (libretroCore.ports) is recorded, pointer input depends on the window and isn't.
+ */
+
+static_assert( LIBRETRO_MAX_PORTS <= 8, "A movie frame's changedPorts only has room for 8 ports" );
+
+struct LibretroMovieHeader {
+    quint64 magic { LIBRETRO_MOVIE_MAGIC };
+    quint32 version { LIBRETRO_MOVIE_VERSION };
+    quint32 portCount { LIBRETRO_MAX_PORTS };
+    quint64 frameCount { 0 };
+    quint32 stateSize { 0 };
+    char library[ 64 ] {};
+};
+
+// Write header to device. Returns false on a short write
+bool LibretroMovieWriteHeader( QIODevice *device, const LibretroMovieHeader &header );
+
+// Read a header from device and check it's one we understand. Returns false otherwise
+bool LibretroMovieReadHeader( QIODevice *device, LibretroMovieHeader &header );
+
+// The library field of a movie made with the loaded core
+QByteArray LibretroMovieLibrary();
+
+// Append the record of a frame whose input is ports to out, previous is the input of the frame before (updated to ports)
+void LibretroMovieEncodeFrame( QByteArray &out, const LibretroPortState *ports, LibretroPortState *previous );
+
+// Apply the frame record at data to ports. Returns the record's size, 0 if it's cut short
+size_t LibretroMovieDecodeFrame( const char *data, size_t size, LibretroPortState *ports );
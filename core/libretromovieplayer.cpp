@@ -0,0 +1,133 @@
+#include "libretromovieplayer.h"
+#include "libretromovie.h"
+#include "logging.h"
+
+#include <QFile>
+
+#include <string.h>
+
+quint64 LibretroMoviePlayer::framesPlayed() const {
+    return framesPlayedCount;
+}
+
+bool LibretroMoviePlayer::isPlaying() const {
+    return playing;
+}
+
+void LibretroMoviePlayer::commandIn( Command command, QVariant data, qint64 timeStamp ) {
+    emit commandOut( command, data, timeStamp );
+
+    switch( command ) {
+        case Command::PlayMovie: {
+            stop();
+
+            if( !data.toString().isEmpty() ) {
+                start( data.toString() );
+            }
+
+            break;
+        }
+
+        case Command::Stop: {
+            stop();
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+// Private
+
+void LibretroMoviePlayer::start( QString path ) {
+    if( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) {
+        qCWarning( phxCore ) << "Cannot play a movie, no game is loaded";
+        return;
+    }
+
+    QFile file( path );
+    LibretroMovieHeader header;
+
+    if( !file.open( QIODevice::ReadOnly ) ) {
+        qCWarning( phxCore ).nospace() << "Could not open movie " << path << ": " << file.errorString();
+        return;
+    }
+
+    if( !LibretroMovieReadHeader( &file, header ) ) {
+        return;
+    }
+
+    QByteArray library = LibretroMovieLibrary();
+
+    if( library != header.library ) {
+        qCWarning( phxCore ).nospace() << "Movie was recorded with " << header.library << ", not " << library
+                                       << ", it probably won't replay faithfully";
+    }
+
+    QByteArray state = file.read( header.stateSize );
+
+    if( static_cast<quint32>( state.size() ) != header.stateSize ) {
+        qCWarning( phxCore ) << "Movie" << path << "is cut short";
+        return;
+    }
+
+    if( header.stateSize && !LibretroCoreUnserialize( state.constData(), static_cast<size_t>( state.size() ) ) ) {
+        qCWarning( phxCore ) << "Cannot play movie" << path << "- the core rejected its state";
+        return;
+    }
+
+    // A few bytes a frame, a whole movie fits in memory easily
+    frames = file.readAll();
+    position = 0;
+    memset( ports, 0, sizeof( ports ) );
+    frameCount = header.frameCount;
+    framesPlayedCount = 0;
+    startFrame = libretroCore.frameCount;
+    playing = true;
+
+    pollConnection = connect( &libretroCore, &LibretroCore::frameInputRequested, this, &LibretroMoviePlayer::playFrame,
+                              Qt::DirectConnection );
+
+    qCInfo( phxCore ).nospace() << "Playing movie " << path << " (" << frameCount << " frames)";
+}
+
+void LibretroMoviePlayer::stop() {
+    if( !playing ) {
+        return;
+    }
+
+    playing = false;
+    frames.clear();
+    disconnect( pollConnection );
+
+    // Put back what the controllers actually plugged in are doing
+    for( int port = 0; port < LIBRETRO_MAX_PORTS; port++ ) {
+        LibretroCoreRebuildPort( port );
+    }
+}
+
+void LibretroMoviePlayer::playFrame( quint64 frame ) {
+    // Apply every record up to frame's, frames in which the core didn't poll still have one
+    while( framesPlayedCount <= frame - startFrame ) {
+        // frameCount is 0 if the recording never finished, play whatever made it to disk
+        size_t recordSize = 0;
+
+        if( !frameCount || framesPlayedCount < frameCount ) {
+            recordSize = LibretroMovieDecodeFrame( frames.constData() + position,
+                                                   static_cast<size_t>( frames.size() - position ), ports );
+        }
+
+        if( !recordSize ) {
+            qCInfo( phxCore ) << "Movie finished after" << framesPlayedCount << "frames";
+            stop();
+            return;
+        }
+
+        position += static_cast<int>( recordSize );
+        framesPlayedCount++;
+    }
+
+    memcpy( libretroCore.ports, ports, sizeof( ports ) );
+}
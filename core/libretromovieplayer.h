@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+
+#include "libretrocore.h"
+#include "node.h"
+
+/*
+ * LibretroMoviePlayer replays a movie (see libretromovie.h) while Command::PlayMovie is in effect: it restores the state
+ * the movie starts from, then feeds the core the recorded input frame by frame in place of whatever SDLManager/Remapper
+ * send. Live input is ignored until the movie ends or is stopped.
+ *
+ * Connect it as a child of LibretroRunner. The player overwrites libretroCore.ports as the core polls the input of each
+ * frame (see LibretroCore::frameInputRequested), picking the record by frame number. Nothing depends on wall-clock time,
+ * heartbeats, playback speed or run-ahead: heartbeats can come as fast as the core can go (like HeadlessBenchmark's)
+ * and the same frames come out.
+ *
+ * Only works in-process (LibretroRunner), the player writes to libretroCore directly.
+ */
+
+class LibretroMoviePlayer : public Node {
+        Q_OBJECT
+
+    public:
+        LibretroMoviePlayer() = default;
+
+        // Frames fed to the core since the movie started
+        quint64 framesPlayed() const;
+
+        bool isPlaying() const;
+
+    public slots:
+        void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
+
+    private:
+        // Load the movie at path and restore the state it starts from
+        void start( QString path );
+
+        // Hand the ports back to live input
+        void stop();
+
+        // Feed the core the input of frame
+        void playFrame( quint64 frame );
+
+        // Every frame record in the movie
+        QByteArray frames;
+        int position { 0 };
+
+        // Input of the current frame
+        LibretroPortState ports[ LIBRETRO_MAX_PORTS ] {};
+
+        quint64 frameCount { 0 };
+        quint64 framesPlayedCount { 0 };
+        bool playing { false };
+
+        // libretroCore.frameCount as of the movie's first frame
+        quint64 startFrame { 0 };
+
+        QMetaObject::Connection pollConnection;
+};
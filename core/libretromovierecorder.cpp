@@ -0,0 +1,161 @@
+#include "libretromovierecorder.h"
+#include "libretromovie.h"
+#include "logging.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+LibretroMovieRecorder::~LibretroMovieRecorder() {
+    stop();
+}
+
+void LibretroMovieRecorder::commandIn( Command command, QVariant data, qint64 timeStamp ) {
+    emit commandOut( command, data, timeStamp );
+
+    switch( command ) {
+        case Command::RecordMovie: {
+            stop();
+
+            if( !data.toString().isEmpty() ) {
+                start( data.toString() );
+            }
+
+            break;
+        }
+
+        case Command::Heartbeat: {
+            if( !file.isOpen() || libretroCore.state != State::Playing ) {
+                break;
+            }
+
+            // Frames emulated backwards can't be replayed
+            if( libretroCore.playbackSpeed <= 0.0 && libretroCore.rewindable ) {
+                qCWarning( phxCore ) << "Rewinding, movie recording stopped";
+                stop();
+            }
+
+            break;
+        }
+
+        case Command::Stop: {
+            stop();
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+// Private
+
+void LibretroMovieRecorder::start( QString path ) {
+    if( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) {
+        qCWarning( phxCore ) << "Cannot record a movie, no game is loaded";
+        return;
+    }
+
+    LibretroMovieHeader header;
+    QByteArray library = LibretroMovieLibrary();
+    memcpy( header.library, library.constData(), static_cast<size_t>( library.size() ) );
+
+    // Where the movie starts from
+    QByteArray state;
+    size_t stateSize = libretroCore.symbols.retro_serialize_size();
+
+    if( stateSize ) {
+        state.resize( static_cast<int>( stateSize ) );
+
+        if( !libretroCore.symbols.retro_serialize( state.data(), stateSize ) ) {
+            qCWarning( phxCore ) << "Cannot record a movie, the core could not serialize its state";
+            return;
+        }
+    } else {
+        qCWarning( phxCore ) << "Core can't serialize, the movie will only replay faithfully from a freshly loaded game";
+    }
+
+    header.stateSize = static_cast<quint32>( state.size() );
+
+    file.setFileName( path );
+
+    if( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) || !LibretroMovieWriteHeader( &file, header ) ||
+        file.write( state ) != state.size() ) {
+        qCWarning( phxCore ).nospace() << "Could not write movie " << path << ": " << file.errorString();
+        file.close();
+        return;
+    }
+
+    buffer.clear();
+    buffer.reserve( LIBRETRO_MOVIE_WRITE_SIZE + LIBRETRO_MOVIE_PORT_SIZE * LIBRETRO_MAX_PORTS + 1 );
+    memset( previousPorts, 0, sizeof( previousPorts ) );
+    startFrame = libretroCore.frameCount;
+    nextFrame = startFrame;
+
+    pollConnection = connect( &libretroCore, &LibretroCore::frameInputPolled, this, &LibretroMovieRecorder::recordFrame,
+                              Qt::DirectConnection );
+
+    qCInfo( phxCore ).nospace() << "Recording movie to " << path << " (" << state.size() / 1024.0 << " KB state)";
+}
+
+void LibretroMovieRecorder::stop() {
+    if( !file.isOpen() ) {
+        return;
+    }
+
+    disconnect( pollConnection );
+
+    // Frames emulated since the core last polled (libretroCore.frameCount is already back to 0 if the game stopped)
+    recordSkippedFrames( libretroCore.frameCount );
+
+    bool written = writeBuffer();
+    quint64 frameCount = nextFrame - startFrame;
+
+    // Now that it's known
+    if( written && file.seek( LIBRETRO_MOVIE_FRAME_COUNT_OFFSET ) ) {
+        quint64 littleEndianFrameCount = qToLittleEndian( frameCount );
+        written = file.write( reinterpret_cast<const char *>( &littleEndianFrameCount ), sizeof( littleEndianFrameCount ) )
+                  == sizeof( littleEndianFrameCount );
+    } else {
+        written = false;
+    }
+
+    if( written ) {
+        qCInfo( phxCore ).nospace() << "Recorded " << frameCount << " frames to " << file.fileName() << " ("
+                                     << file.size() / 1024.0 << " KB)";
+    } else {
+        qCWarning( phxCore ).nospace() << "Could not finish movie " << file.fileName() << ": " << file.errorString();
+    }
+
+    file.close();
+    buffer.clear();
+}
+
+bool LibretroMovieRecorder::writeBuffer() {
+    bool written = file.write( buffer ) == buffer.size();
+    buffer.resize( 0 );
+    return written;
+}
+
+void LibretroMovieRecorder::recordFrame( quint64 frame ) {
+    // Already recorded, the core polled more than once
+    if( frame < nextFrame ) {
+        return;
+    }
+
+    recordSkippedFrames( frame );
+    LibretroMovieEncodeFrame( buffer, libretroCore.ports, previousPorts );
+    nextFrame = frame + 1;
+
+    if( buffer.size() >= LIBRETRO_MOVIE_WRITE_SIZE && !writeBuffer() ) {
+        qCWarning( phxCore ).nospace() << "Could not write movie " << file.fileName() << ": " << file.errorString();
+        stop();
+    }
+}
+
+void LibretroMovieRecorder::recordSkippedFrames( quint64 frame ) {
+    for( ; nextFrame < frame; nextFrame++ ) {
+        buffer.append( '\0' );
+    }
+}
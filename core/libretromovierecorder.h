@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+
+#include "libretrocore.h"
+#include "node.h"
+
+// Frame records are written out once this many bytes have piled up (about 18 minutes of untouched input at 60fps)
+#define LIBRETRO_MOVIE_WRITE_SIZE ( 64 * 1024 )
+
+/*
+ * LibretroMovieRecorder records the input LibretroRunner feeds the core into a movie (see libretromovie.h) while
+ * Command::RecordMovie is in effect.
+ *
+ * Connect it as a child of LibretroRunner. Frames are recorded as the core polls their input (see
+ * LibretroCore::frameInputPolled), so every frame that moves the game forward gets exactly one record whatever the
+ * heartbeat, playback speed or run-ahead setting, and the record is the input the frame read. If LibretroMoviePlayer is
+ * replaying a movie at the same time, this records what it fed in. Frames in which the core didn't poll are recorded as
+ * unchanged.
+ *
+ * Rewinding stops the recording, loading save states isn't recorded.
+ *
+ * Only works in-process (LibretroRunner), the recorder reads libretroCore directly.
+ */
+
+class LibretroMovieRecorder : public Node {
+        Q_OBJECT
+
+    public:
+        LibretroMovieRecorder() = default;
+        ~LibretroMovieRecorder();
+
+    public slots:
+        void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
+
+    private:
+        // Snapshot the core's state and start a movie at path
+        void start( QString path );
+
+        // Write out the rest of the movie and close it
+        void stop();
+
+        // Append what's in buffer to file
+        bool writeBuffer();
+
+        // Record the input of frame and any frames skipped since the last one recorded
+        void recordFrame( quint64 frame );
+
+        // Append unchanged records up to (not including) frame
+        void recordSkippedFrames( quint64 frame );
+
+        QFile file;
+
+        // Frame records not yet written out
+        QByteArray buffer;
+
+        // Input as of the last recorded frame
+        LibretroPortState previousPorts[ LIBRETRO_MAX_PORTS ] {};
+
+        // libretroCore.frameCount as of the first frame and the next frame to record
+        quint64 startFrame { 0 };
+        quint64 nextFrame { 0 };
+
+        QMetaObject::Connection pollConnection;
+};
@@ -0,0 +1,331 @@
+#include "libretroperf.h"
+#include "logging.h"
+
+#include <QList>
+#include <QMutexLocker>
+#include <QPair>
+#include <QVariantMap>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define LIBRETROPERF_X86
+#if defined( _MSC_VER )
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#if defined( Q_OS_UNIX )
+#include <time.h>
+#endif
+
+namespace {
+    inline int highestBit( quint64 value ) {
+#if defined( _MSC_VER ) && defined( _M_X64 )
+        unsigned long index;
+        _BitScanReverse64( &index, value );
+        return static_cast<int>( index );
+#elif defined( __GNUC__ )
+        return 63 - __builtin_clzll( value );
+#else
+        int index = 0;
+
+        while( value >>= 1 ) {
+            index++;
+        }
+
+        return index;
+#endif
+    }
+
+    inline quint64 monotonicNsecs() {
+#if defined( Q_OS_UNIX )
+        timespec now;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        return static_cast<quint64>( now.tv_sec ) * 1000000000 + static_cast<quint64>( now.tv_nsec );
+#else
+        return static_cast<quint64>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif
+    }
+}
+
+LibretroPerf::Stats::Stats() {
+    reset();
+}
+
+void LibretroPerf::Stats::reset() {
+    count.store( 0, std::memory_order_relaxed );
+    total.store( 0, std::memory_order_relaxed );
+
+    for( std::atomic<quint32> &bucket : histogram ) {
+        bucket.store( 0, std::memory_order_relaxed );
+    }
+}
+
+retro_perf_tick_t LibretroPerf::ticks() {
+#if defined( LIBRETROPERF_X86 )
+    return __rdtsc();
+#else
+    return monotonicNsecs();
+#endif
+}
+
+retro_time_t LibretroPerf::timeUsec() {
+    return static_cast<retro_time_t>( monotonicNsecs() / 1000 );
+}
+
+uint64_t LibretroPerf::cpuFeatures() {
+    uint64_t features = 0;
+
+#if defined( LIBRETROPERF_X86 ) && defined( __GNUC__ )
+    __builtin_cpu_init();
+
+    features |= __builtin_cpu_supports( "mmx" ) ? RETRO_SIMD_MMX : 0;
+    features |= __builtin_cpu_supports( "sse" ) ? RETRO_SIMD_SSE : 0;
+    features |= __builtin_cpu_supports( "sse2" ) ? RETRO_SIMD_SSE2 : 0;
+    features |= __builtin_cpu_supports( "sse3" ) ? RETRO_SIMD_SSE3 : 0;
+    features |= __builtin_cpu_supports( "ssse3" ) ? RETRO_SIMD_SSSE3 : 0;
+    features |= __builtin_cpu_supports( "sse4.1" ) ? RETRO_SIMD_SSE4 : 0;
+    features |= __builtin_cpu_supports( "sse4.2" ) ? RETRO_SIMD_SSE42 : 0;
+    features |= __builtin_cpu_supports( "popcnt" ) ? RETRO_SIMD_POPCNT : 0;
+    features |= __builtin_cpu_supports( "avx" ) ? RETRO_SIMD_AVX : 0;
+    features |= __builtin_cpu_supports( "avx2" ) ? RETRO_SIMD_AVX2 : 0;
+#elif defined( LIBRETROPERF_X86 ) && defined( _MSC_VER )
+    int info[ 4 ];
+    __cpuid( info, 1 );
+
+    features |= ( info[ 3 ] & ( 1 << 23 ) ) ? RETRO_SIMD_MMX : 0;
+    features |= ( info[ 3 ] & ( 1 << 25 ) ) ? RETRO_SIMD_SSE : 0;
+    features |= ( info[ 3 ] & ( 1 << 26 ) ) ? RETRO_SIMD_SSE2 : 0;
+    features |= ( info[ 2 ] & ( 1 << 0 ) ) ? RETRO_SIMD_SSE3 : 0;
+    features |= ( info[ 2 ] & ( 1 << 9 ) ) ? RETRO_SIMD_SSSE3 : 0;
+    features |= ( info[ 2 ] & ( 1 << 19 ) ) ? RETRO_SIMD_SSE4 : 0;
+    features |= ( info[ 2 ] & ( 1 << 20 ) ) ? RETRO_SIMD_SSE42 : 0;
+    features |= ( info[ 2 ] & ( 1 << 23 ) ) ? RETRO_SIMD_POPCNT : 0;
+
+    // AVX also needs the OS to save the YMM registers
+    bool osSavesYMM = ( info[ 2 ] & ( 1 << 27 ) ) && ( _xgetbv( 0 ) & 6 ) == 6;
+
+    if( osSavesYMM && ( info[ 2 ] & ( 1 << 28 ) ) ) {
+        features |= RETRO_SIMD_AVX;
+        __cpuidex( info, 7, 0 );
+        features |= ( info[ 1 ] & ( 1 << 5 ) ) ? RETRO_SIMD_AVX2 : 0;
+    }
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+    features |= RETRO_SIMD_NEON;
+#endif
+
+    return features;
+}
+
+void LibretroPerf::registerCounter( retro_perf_counter *counter ) {
+    QMutexLocker locker( &registerMutex );
+
+    // The core is only supposed to register once, but may not check registered first
+    if( find( counter ) ) {
+        counter->registered = true;
+        return;
+    }
+
+    int index = count.load( std::memory_order_relaxed );
+
+    if( index >= LIBRETROPERF_MAX_COUNTERS ) {
+        qCWarning( phxCore ) << "Too many performance counters, not tracking" << counter->ident;
+        counter->registered = true;
+        return;
+    }
+
+    stats[ index ].reset( new Stats );
+    stats[ index ]->name = counter->ident ? QByteArray( counter->ident ) : QByteArray( "(unnamed)" );
+
+    size_t slot = ( reinterpret_cast<quintptr>( counter ) >> 3 ) & ( LOOKUP_SIZE - 1 );
+
+    while( lookupKeys[ slot ].load( std::memory_order_relaxed ) ) {
+        slot = ( slot + 1 ) & ( LOOKUP_SIZE - 1 );
+    }
+
+    // Value first, find() goes by the key
+    lookupValues[ slot ].store( stats[ index ].get(), std::memory_order_relaxed );
+    lookupKeys[ slot ].store( counter, std::memory_order_release );
+    count.store( index + 1, std::memory_order_release );
+
+    counter->registered = true;
+}
+
+void LibretroPerf::start( retro_perf_counter *counter ) {
+    counter->start = ticks();
+}
+
+void LibretroPerf::stop( retro_perf_counter *counter ) {
+    retro_perf_tick_t elapsed = ticks() - counter->start;
+    counter->total += elapsed;
+    counter->call_cnt++;
+
+    Stats *counterStats = find( counter );
+
+    if( !counterStats ) {
+        return;
+    }
+
+    counterStats->count.store( counterStats->count.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    counterStats->total.store( counterStats->total.load( std::memory_order_relaxed ) + elapsed, std::memory_order_relaxed );
+
+    std::atomic<quint32> &bucket = counterStats->histogram[ histogramBucket( elapsed ) ];
+    bucket.store( bucket.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+}
+
+void LibretroPerf::beginSession() {
+    int counters = count.load( std::memory_order_acquire );
+
+    for( int i = 0; i < counters; i++ ) {
+        stats[ i ]->reset();
+    }
+
+    sessionStartTicks = ticks();
+    sessionStartUsecs = timeUsec();
+}
+
+void LibretroPerf::clear() {
+    QMutexLocker locker( &registerMutex );
+
+    for( int i = 0; i < LOOKUP_SIZE; i++ ) {
+        lookupKeys[ i ].store( nullptr, std::memory_order_relaxed );
+        lookupValues[ i ].store( nullptr, std::memory_order_relaxed );
+    }
+
+    for( std::unique_ptr<Stats> &counterStats : stats ) {
+        counterStats.reset();
+    }
+
+    count.store( 0, std::memory_order_release );
+}
+
+int LibretroPerf::counterCount() const {
+    return count.load( std::memory_order_acquire );
+}
+
+QVariantList LibretroPerf::snapshot() {
+    // Ticks per microsecond over the session so far
+    retro_time_t elapsedUsecs = timeUsec() - sessionStartUsecs;
+    qreal ticksPerUsec = elapsedUsecs > 0 ? static_cast<qreal>( ticks() - sessionStartTicks ) / elapsedUsecs : 1.0;
+
+    if( ticksPerUsec <= 0.0 ) {
+        ticksPerUsec = 1.0;
+    }
+
+    QList<QPair<quint64, QVariantMap>> counters;
+    int counterCount = count.load( std::memory_order_acquire );
+
+    for( int i = 0; i < counterCount; i++ ) {
+        const Stats &counterStats = *stats[ i ];
+        quint64 calls = counterStats.count.load( std::memory_order_relaxed );
+        quint64 total = counterStats.total.load( std::memory_order_relaxed );
+
+        if( !calls ) {
+            continue;
+        }
+
+        QVariantMap counter;
+        counter[ "name" ] = QString::fromUtf8( counterStats.name );
+        counter[ "count" ] = static_cast<qint64>( calls );
+        counter[ "totalMsecs" ] = total / ticksPerUsec / 1000.0;
+        counter[ "p50Usecs" ] = percentile( counterStats, calls, 0.50 ) / ticksPerUsec;
+        counter[ "p99Usecs" ] = percentile( counterStats, calls, 0.99 ) / ticksPerUsec;
+        counters.append( qMakePair( total, counter ) );
+    }
+
+    std::sort( counters.begin(), counters.end(), []( const QPair<quint64, QVariantMap> &a, const QPair<quint64, QVariantMap> &b ) {
+        return a.first > b.first;
+    } );
+
+    QVariantList list;
+
+    for( const auto &counter : counters ) {
+        list.append( counter.second );
+    }
+
+    return list;
+}
+
+void LibretroPerf::log() {
+    QVariantList counters = snapshot();
+
+    if( counters.isEmpty() ) {
+        return;
+    }
+
+    qCInfo( phxCore ) << "Performance counters (count, total ms, p50 us, p99 us):";
+
+    for( const QVariant &variant : counters ) {
+        QVariantMap counter = variant.toMap();
+        qCInfo( phxCore ).nospace() << "  " << counter[ "name" ].toString() << ": " << counter[ "count" ].toLongLong()
+                                    << ", " << counter[ "totalMsecs" ].toReal() << ", " << counter[ "p50Usecs" ].toReal()
+                                    << ", " << counter[ "p99Usecs" ].toReal();
+    }
+}
+
+// Private
+
+int LibretroPerf::histogramBucket( quint64 ticks ) {
+    // Small values get a bucket each
+    if( ticks < HISTOGRAM_SUB_BUCKETS ) {
+        return static_cast<int>( ticks );
+    }
+
+    // Otherwise the top bit picks the power of two and the HISTOGRAM_SUB_BITS below it the sub-bucket
+    int top = highestBit( ticks );
+    int sub = static_cast<int>( ( ticks >> ( top - HISTOGRAM_SUB_BITS ) ) & ( HISTOGRAM_SUB_BUCKETS - 1 ) );
+    return ( top - HISTOGRAM_SUB_BITS + 1 ) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+quint64 LibretroPerf::histogramBucketMidpoint( int bucket ) {
+    if( bucket < HISTOGRAM_SUB_BUCKETS ) {
+        return static_cast<quint64>( bucket );
+    }
+
+    int top = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+    int sub = bucket % HISTOGRAM_SUB_BUCKETS;
+    int shift = top - HISTOGRAM_SUB_BITS;
+    quint64 low = static_cast<quint64>( HISTOGRAM_SUB_BUCKETS + sub ) << shift;
+    return low + ( ( static_cast<quint64>( 1 ) << shift ) >> 1 );
+}
+
+quint64 LibretroPerf::percentile( const Stats &stats, quint64 count, qreal fraction ) {
+    quint64 target = qMax<quint64>( 1, static_cast<quint64>( fraction * count + 0.5 ) );
+    quint64 seen = 0;
+
+    for( int bucket = 0; bucket < HISTOGRAM_SIZE; bucket++ ) {
+        seen += stats.histogram[ bucket ].load( std::memory_order_relaxed );
+
+        if( seen >= target ) {
+            return histogramBucketMidpoint( bucket );
+        }
+    }
+
+    // Samples recorded since count was read
+    return histogramBucketMidpoint( HISTOGRAM_SIZE - 1 );
+}
+
+LibretroPerf::Stats *LibretroPerf::find( retro_perf_counter *counter ) const {
+    size_t slot = ( reinterpret_cast<quintptr>( counter ) >> 3 ) & ( LOOKUP_SIZE - 1 );
+
+    for( int probes = 0; probes < LOOKUP_SIZE; probes++ ) {
+        retro_perf_counter *key = lookupKeys[ slot ].load( std::memory_order_acquire );
+
+        if( key == counter ) {
+            return lookupValues[ slot ].load( std::memory_order_relaxed );
+        }
+
+        if( !key ) {
+            return nullptr;
+        }
+
+        slot = ( slot + 1 ) & ( LOOKUP_SIZE - 1 );
+    }
+
+    return nullptr;
+}
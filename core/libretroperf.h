@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QVariantList>
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+
+#include "libretro.h"
+
+// Most counters tracked per core, further registrations are accepted but ignored
+#define LIBRETROPERF_MAX_COUNTERS 256
+
+/*
+ * LibretroPerf backs the performance interface cores get through RETRO_ENVIRONMENT_GET_PERF_INTERFACE.
+ *
+ * Ticks come from rdtsc on x86 and from a monotonic clock (in ns) elsewhere. They're converted to time by calibrating
+ * against the monotonic clock over the session, so nothing assumes the TSC runs at any particular frequency.
+ *
+ * Besides keeping each retro_perf_counter's own total and call_cnt up to date like the API asks, every stop() records
+ * the duration in a log-linear histogram so snapshot() can report p50/p99 (to within 1/HISTOGRAM_SUB_BUCKETS) as well
+ * as totals. Registrations last for as long as the core is loaded since counters are the core's statics, the stats are
+ * reset by beginSession().
+ *
+ * start() and stop() never lock and may be called from any thread. A counter used from two threads at once may lose
+ * samples (so would its retro_perf_counter), but nothing worse. Registering takes a lock.
+ */
+
+class LibretroPerf {
+    public:
+        // retro_perf_callback backends
+        static retro_perf_tick_t ticks();
+        static retro_time_t timeUsec();
+        static uint64_t cpuFeatures();
+
+        void registerCounter( retro_perf_counter *counter );
+        void start( retro_perf_counter *counter );
+        void stop( retro_perf_counter *counter );
+
+        // Reset every counter's stats and restart the tick calibration, registrations are kept
+        void beginSession();
+
+        // Forget every counter, call when the core is unloaded (the counters live in its memory)
+        void clear();
+
+        int counterCount() const;
+
+        // One QVariantMap per counter that has been stopped at least once, most total time first. Keys: "name" (QString),
+        // "count" (qint64), "totalMsecs", "p50Usecs" and "p99Usecs" (qreal)
+        QVariantList snapshot();
+
+        // Write snapshot() to the log as a table
+        void log();
+
+    private:
+        // log2 buckets, each split into this many linear sub-buckets
+        static const int HISTOGRAM_SUB_BITS = 3;
+        static const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+        static const int HISTOGRAM_SIZE = 64 * HISTOGRAM_SUB_BUCKETS;
+
+        // Table size for looking counters up by address, a power of two well above LIBRETROPERF_MAX_COUNTERS
+        static const int LOOKUP_SIZE = LIBRETROPERF_MAX_COUNTERS * 4;
+
+        struct Stats {
+            QByteArray name;
+
+            // Relaxed loads and stores only, see above
+            std::atomic<quint64> count { 0 };
+            std::atomic<quint64> total { 0 };
+            std::atomic<quint32> histogram[ HISTOGRAM_SIZE ];
+
+            Stats();
+            void reset();
+        };
+
+        static int histogramBucket( quint64 ticks );
+        static quint64 histogramBucketMidpoint( int bucket );
+
+        // Ticks at or below which the given fraction of samples fall
+        static quint64 percentile( const Stats &stats, quint64 count, qreal fraction );
+
+        // Stats for a registered counter, nullptr if it isn't one of ours
+        Stats *find( retro_perf_counter *counter ) const;
+
+        // Open addressing, written under registerMutex only. A slot is never cleared while a core is loaded
+        std::atomic<retro_perf_counter *> lookupKeys[ LOOKUP_SIZE ] {};
+        std::atomic<Stats *> lookupValues[ LOOKUP_SIZE ] {};
+
+        std::unique_ptr<Stats> stats[ LIBRETROPERF_MAX_COUNTERS ];
+        std::atomic<int> count { 0 };
+        QMutex registerMutex;
+
+        // Calibration: ticks and monotonic time at beginSession()
+        retro_perf_tick_t sessionStartTicks { 0 };
+        retro_time_t sessionStartUsecs { 0 };
+};
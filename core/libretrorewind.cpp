@@ -0,0 +1,342 @@
+#include "libretrorewind.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define REWIND_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // The delta codec works in blocks of this many bytes, one SSE2 register's worth
+    const size_t blockSize = 16;
+
+    struct ChunkHeader {
+        uint32_t zeroRun;
+        uint32_t literalLength;
+    };
+
+    // True if the blockSize bytes at a and b are identical
+    inline bool blocksEqual( const uint8_t *a, const uint8_t *b ) {
+#if defined( REWIND_USE_SSE2 )
+        __m128i equal = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( a ) ),
+                                        _mm_loadu_si128( reinterpret_cast<const __m128i *>( b ) ) );
+        return _mm_movemask_epi8( equal ) == 0xFFFF;
+#else
+        uint64_t a0, a1, b0, b1;
+        memcpy( &a0, a, 8 );
+        memcpy( &a1, a + 8, 8 );
+        memcpy( &b0, b, 8 );
+        memcpy( &b1, b + 8, 8 );
+        return ( ( a0 ^ b0 ) | ( a1 ^ b1 ) ) == 0;
+#endif
+    }
+
+    // Write ( a XOR b ) to out, blockSize bytes. Returns true if a and b were identical
+    inline bool xorBlock( uint8_t *out, const uint8_t *a, const uint8_t *b ) {
+#if defined( REWIND_USE_SSE2 )
+        __m128i x = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i *>( a ) ),
+                                   _mm_loadu_si128( reinterpret_cast<const __m128i *>( b ) ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( out ), x );
+        return _mm_movemask_epi8( _mm_cmpeq_epi8( x, _mm_setzero_si128() ) ) == 0xFFFF;
+#else
+        uint64_t a0, a1, b0, b1;
+        memcpy( &a0, a, 8 );
+        memcpy( &a1, a + 8, 8 );
+        memcpy( &b0, b, 8 );
+        memcpy( &b1, b + 8, 8 );
+        a0 ^= b0;
+        a1 ^= b1;
+        memcpy( out, &a0, 8 );
+        memcpy( out + 8, &a1, 8 );
+        return ( a0 | a1 ) == 0;
+#endif
+    }
+
+    // state ^= in, length bytes
+    inline void xorInto( uint8_t *state, const uint8_t *in, size_t length ) {
+        size_t i = 0;
+
+        for( ; i + blockSize <= length; i += blockSize ) {
+            xorBlock( state + i, state + i, in + i );
+        }
+
+        for( ; i < length; i++ ) {
+            state[ i ] ^= in[ i ];
+        }
+    }
+
+    inline void writeHeader( uint8_t *out, size_t zeroRun, size_t literalLength ) {
+        ChunkHeader header;
+        header.zeroRun = static_cast<uint32_t>( zeroRun );
+        header.literalLength = static_cast<uint32_t>( literalLength );
+        memcpy( out, &header, sizeof( header ) );
+    }
+}
+
+LibretroRewind::~LibretroRewind() {
+    free();
+}
+
+void LibretroRewind::init( size_t stateSize, size_t memoryBudget, int maxSnapshots ) {
+    free();
+
+    if( stateSize == 0 || maxSnapshots <= 0 ) {
+        return;
+    }
+
+    size = stateSize;
+
+    // There must be room for at least one worst-case delta
+    budget = std::max( memoryBudget, maxEncodedSize() );
+    maxEntries = maxSnapshots;
+
+    clear();
+}
+
+void LibretroRewind::free() {
+    delete[] current;
+    delete[] next;
+    delete[] history;
+    current = nullptr;
+    next = nullptr;
+    history = nullptr;
+
+    size = 0;
+    historySize = 0;
+    budget = 0;
+    maxEntries = 0;
+    entries.clear();
+
+    clear();
+}
+
+void LibretroRewind::clear() {
+    hasBase = false;
+    writeOffset = 0;
+    used = 0;
+    entryHead = 0;
+    entryCount = 0;
+}
+
+bool LibretroRewind::isActive() const {
+    return size != 0;
+}
+
+void *LibretroRewind::scratch() {
+    if( !isActive() ) {
+        return nullptr;
+    }
+
+    if( !next ) {
+        current = new uint8_t[ size ]();
+        next = new uint8_t[ size ]();
+    }
+
+    return next;
+}
+
+void LibretroRewind::push() {
+    if( !isActive() || !next ) {
+        return;
+    }
+
+    // Nothing to diff against yet, this becomes the base state
+    if( !hasBase ) {
+        std::swap( current, next );
+        hasBase = true;
+        return;
+    }
+
+    if( entryCount == entries.size() ) {
+        growEntries();
+
+        if( entryCount == entries.size() ) {
+            dropOldest();
+        }
+    }
+
+    reserve( maxEncodedSize() );
+
+    size_t written = LibretroRewindEncode( history + writeOffset, next, current, size );
+
+    Entry &entry = entries[ ( entryHead + entryCount ) % entries.size() ];
+    entry.offset = writeOffset;
+    entry.size = written;
+    entryCount++;
+
+    writeOffset += written;
+    used += written;
+
+    std::swap( current, next );
+}
+
+const void *LibretroRewind::pop() {
+    if( !isActive() || !hasBase || entryCount == 0 ) {
+        return nullptr;
+    }
+
+    const Entry &entry = entries[ ( entryHead + entryCount - 1 ) % entries.size() ];
+    LibretroRewindDecode( current, history + entry.offset, entry.size );
+
+    // Reclaim the space used by the delta
+    writeOffset = entry.offset;
+    used -= entry.size;
+    entryCount--;
+
+    return current;
+}
+
+size_t LibretroRewind::stateSize() const {
+    return size;
+}
+
+size_t LibretroRewind::bytesUsed() const {
+    return used;
+}
+
+int LibretroRewind::count() const {
+    return entryCount;
+}
+
+size_t LibretroRewind::bytesAllocated() const {
+    return ( current ? size * 2 : 0 ) + historySize + static_cast<size_t>( entries.size() ) * sizeof( Entry );
+}
+
+// Private
+
+void LibretroRewind::reserve( size_t bytes ) {
+    // Grow until the budget is reached. History hasn't wrapped around yet, so it's all before writeOffset
+    if( writeOffset + bytes > historySize && historySize < budget ) {
+        size_t grownSize = std::min( budget, std::max( { historySize * 2, writeOffset + bytes,
+                                                         static_cast<size_t>( REWIND_INITIAL_HISTORY_SIZE ) } ) );
+        uint8_t *grown = new uint8_t[ grownSize ];
+
+        if( writeOffset ) {
+            memcpy( grown, history, writeOffset );
+        }
+
+        delete[] history;
+        history = grown;
+        historySize = grownSize;
+    }
+
+    // Not enough room before the end of the ring, drop whatever's left over from the previous lap and wrap around
+    if( writeOffset + bytes > historySize ) {
+        while( entryCount && entries[ entryHead ].offset >= writeOffset ) {
+            dropOldest();
+        }
+
+        writeOffset = 0;
+    }
+
+    // Drop entries from the previous lap that we're about to overwrite
+    while( entryCount && entries[ entryHead ].offset >= writeOffset && entries[ entryHead ].offset < writeOffset + bytes ) {
+        dropOldest();
+    }
+}
+
+void LibretroRewind::dropOldest() {
+    used -= entries[ entryHead ].size;
+    entryHead = ( entryHead + 1 ) % entries.size();
+    entryCount--;
+}
+
+void LibretroRewind::growEntries() {
+    if( entries.size() >= maxEntries ) {
+        return;
+    }
+
+    // Unroll the ring so the oldest entry is first again
+    QVector<Entry> grown( std::min( maxEntries, std::max( entries.size() * 2, REWIND_INITIAL_MAX_SNAPSHOTS ) ) );
+
+    for( int i = 0; i < entryCount; i++ ) {
+        grown[ i ] = entries[ ( entryHead + i ) % entries.size() ];
+    }
+
+    entries = grown;
+    entryHead = 0;
+}
+
+size_t LibretroRewind::maxEncodedSize() const {
+    return LibretroRewindMaxEncodedSize( size );
+}
+
+// Codec
+
+size_t LibretroRewindMaxEncodedSize( size_t size ) {
+    // Every chunk but the first is preceded by at least one unchanged block and holds at least one changed block, plus
+    // a chunk for the unaligned tail. The literal loop may also write one block past the end of its chunk
+    return size + sizeof( ChunkHeader ) * ( size / ( blockSize * 2 ) + 2 ) + blockSize;
+}
+
+size_t LibretroRewindEncode( uint8_t *out, const uint8_t *a, const uint8_t *b, size_t size ) {
+    uint8_t *outStart = out;
+
+    size_t alignedSize = size - ( size % blockSize );
+
+    // Offset into the state just past the last chunk written
+    size_t encodedPos = 0;
+
+    size_t i = 0;
+
+    while( i < alignedSize ) {
+        // Skip unchanged blocks
+        while( i < alignedSize && blocksEqual( a + i, b + i ) ) {
+            i += blockSize;
+        }
+
+        if( i == alignedSize ) {
+            break;
+        }
+
+        // Store changed blocks as literals
+        size_t literalStart = i;
+        uint8_t *header = out;
+        out += sizeof( ChunkHeader );
+
+        while( i < alignedSize ) {
+            // An unchanged block ends the chunk, the XOR written here gets overwritten by the next header
+            if( xorBlock( out, a + i, b + i ) ) {
+                break;
+            }
+
+            out += blockSize;
+            i += blockSize;
+        }
+
+        writeHeader( header, literalStart - encodedPos, i - literalStart );
+        encodedPos = i;
+    }
+
+    // Unaligned tail
+    if( alignedSize < size && memcmp( a + alignedSize, b + alignedSize, size - alignedSize ) != 0 ) {
+        writeHeader( out, alignedSize - encodedPos, size - alignedSize );
+        out += sizeof( ChunkHeader );
+
+        for( size_t j = alignedSize; j < size; j++ ) {
+            *out++ = a[ j ] ^ b[ j ];
+        }
+    }
+
+    return static_cast<size_t>( out - outStart );
+}
+
+void LibretroRewindDecode( uint8_t *state, const uint8_t *in, size_t inSize ) {
+    const uint8_t *end = in + inSize;
+    size_t pos = 0;
+
+    while( in < end ) {
+        ChunkHeader header;
+        memcpy( &header, in, sizeof( header ) );
+        in += sizeof( header );
+
+        pos += header.zeroRun;
+        xorInto( state + pos, in, header.literalLength );
+
+        pos += header.literalLength;
+        in += header.literalLength;
+    }
+}
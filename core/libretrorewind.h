@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QVector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64MB of history is usually good for ~30 minutes of 60fps play with most 8/16-bit cores
+#define REWIND_DEFAULT_BUDGET ( 64 * 1024 * 1024 )
+
+// History starts out this big and doubles as needed until it reaches the budget
+#define REWIND_INITIAL_HISTORY_SIZE ( 1024 * 1024 )
+#define REWIND_INITIAL_MAX_SNAPSHOTS 1024
+
+// 30 minutes' worth of snapshots at 60fps
+#define REWIND_DEFAULT_MAX_SNAPSHOTS ( 60 * 60 * 30 )
+
+/*
+ * LibretroRewind keeps a bounded history of serialized core states so emulation can be stepped backwards.
+ *
+ * Each snapshot is stored as the XOR of itself against the snapshot that came before it, run-length encoded so the
+ * (usually overwhelmingly) unchanged bytes cost next to nothing. History lives in a ring: once the memory budget is used
+ * up, the oldest deltas are dropped to make room for new ones. Stepping backwards XORs the newest delta into the current
+ * state, which yields the state that preceded it.
+ *
+ * Nothing is allocated until the first snapshot is taken, and the ring grows as history piles up instead of claiming the
+ * whole budget up front.
+ *
+ * Usage: serialize into scratch(), then call push(). Call pop() to step back one snapshot.
+ *
+ * Encoded delta format, repeated until the state is covered:
+ *     uint32_t zeroRun (bytes that did not change), uint32_t literalLength, uint8_t literal[ literalLength ]
+ *
+ * Not thread-safe, only touch this from the game thread.
+ */
+
+class LibretroRewind {
+    public:
+        LibretroRewind() = default;
+        ~LibretroRewind();
+
+        // Set up history for states of the given size, clearing any existing history. Memory is allocated as it's needed
+        void init( size_t stateSize, size_t memoryBudget = REWIND_DEFAULT_BUDGET,
+                   int maxSnapshots = REWIND_DEFAULT_MAX_SNAPSHOTS );
+
+        // Release all memory
+        void free();
+
+        // Forget all history, the next push() becomes the new base state
+        void clear();
+
+        bool isActive() const;
+
+        // Buffer to serialize the current state into before calling push(), nullptr if inactive
+        void *scratch();
+
+        // Store the state in scratch() as the newest snapshot
+        void push();
+
+        // Step back one snapshot. Returns a pointer to the restored state (valid until the next push()/pop()) or
+        // nullptr if there's no more history
+        const void *pop();
+
+        size_t stateSize() const;
+        size_t bytesUsed() const;
+        int count() const;
+
+        // Memory currently held for states and history
+        size_t bytesAllocated() const;
+
+    private:
+        struct Entry {
+            size_t offset;
+            size_t size;
+        };
+
+        // Make sure bytes are free at writeOffset, growing history or dropping the oldest entries as necessary
+        void reserve( size_t bytes );
+        void dropOldest();
+
+        // Make room for another entry descriptor if the ring is full but not yet at maxEntries
+        void growEntries();
+
+        // Largest possible encoded size of a delta
+        size_t maxEncodedSize() const;
+
+        size_t size { 0 };
+
+        // The newest state, deltas are applied to this when stepping backwards
+        uint8_t *current { nullptr };
+        uint8_t *next { nullptr };
+        bool hasBase { false };
+
+        // Ring of encoded deltas, grows until it's budget bytes. It only wraps around once it's stopped growing
+        uint8_t *history { nullptr };
+        size_t historySize { 0 };
+        size_t budget { 0 };
+        size_t writeOffset { 0 };
+        size_t used { 0 };
+
+        // Ring of entry descriptors, oldest at entryHead
+        QVector<Entry> entries;
+        int maxEntries { 0 };
+        int entryHead { 0 };
+        int entryCount { 0 };
+};
+
+// Delta codec, exposed for benchmarking
+// Encode ( a XOR b ) into out, which must hold at least LibretroRewindMaxEncodedSize( size ) bytes. Returns bytes written
+size_t LibretroRewindEncode( uint8_t *out, const uint8_t *a, const uint8_t *b, size_t size );
+
+// XOR an encoded delta into state
+void LibretroRewindDecode( uint8_t *state, const uint8_t *in, size_t inSize );
+
+size_t LibretroRewindMaxEncodedSize( size_t size );
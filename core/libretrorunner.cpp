@@ -2,6 +2,7 @@
 #include "mousestate.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
 #include <QString>
@@ -13,6 +14,44 @@
 #include "SDL_gamecontroller.h"
 #include "SDL_haptic.h"
 
+// Report rewind snapshot cost every this many snapshots
+#define REWIND_REPORT_INTERVAL 600
+
+// Report run-ahead cost every this many frames
+#define RUNAHEAD_REPORT_INTERVAL 600
+
+// Most frames fast-forward may emulate per heartbeat, keeps a slow core from falling further and further behind
+#define FAST_FORWARD_MAX_FRAMES 32
+
+// Report fast-forward throughput every this many heartbeats
+#define FAST_FORWARD_REPORT_INTERVAL 600
+
+// Check save data for changes (and write it out if it has) every this many ms
+#define SAVE_DATA_AUTOSAVE_INTERVAL 5000
+
+// Most memory search candidates sent out with the results
+#define MEMORY_SEARCH_MAX_MATCHES 100
+
+// Send out the core's performance counters every this many ms while playing
+#define PERF_COUNTERS_INTERVAL 1000
+
+LibretroRunner::LibretroRunner() {
+    saveWorker.moveToThread( &saveThread );
+    saveThread.setObjectName( "Save state thread" );
+    saveThread.start();
+
+    connect( &saveWorker, &LibretroSaveWorker::stateRead, this, &LibretroRunner::stateRead );
+    connect( &saveWorker, &LibretroSaveWorker::stateWritten, this, [ this ]( int buffer ) {
+        stateBufferBusy[ buffer ] = false;
+    } );
+}
+
+LibretroRunner::~LibretroRunner() {
+    // Let any pending writes finish
+    saveThread.quit();
+    saveThread.wait();
+}
+
 void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp ) {
     // Command is not relayed to children automatically
 
@@ -29,6 +68,26 @@ void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp
 
             qCDebug( phxCore ) << command;
             libretroCore.state = State::Playing;
+
+            if( !autosaveTimer.isValid() ) {
+                autosaveTimer.start();
+            }
+
+            if( memoryExportInterval && !libretroCore.memoryExport.isActive() ) {
+                startMemoryExport();
+            }
+
+            // Preallocate state buffers so saving never has to allocate
+            {
+                size_t stateSize = libretroCore.symbols.retro_serialize_size();
+
+                for( int i = 0; i < STATE_BUFFER_COUNT; i++ ) {
+                    if( stateSize && static_cast<size_t>( stateBuffers[ i ].size() ) != stateSize && !stateBufferBusy[ i ] ) {
+                        stateBuffers[ i ].resize( static_cast<int>( stateSize ) );
+                    }
+                }
+            }
+
             emit commandOut( Command::Play, QVariant(), nodeCurrentTime() );
             break;
         }
@@ -62,41 +121,96 @@ void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp
             // Write SRAM
 
             qCInfo( phxCore ) << "=======Saving game...=======";
-            LibretroCoreStoreSaveData();
+
+            // Wait for the write so the game's unloaded only once its save data is safely on disk
+            if( !storeSaveData( true ) ) {
+                qCInfo( phxCore ) << "Save data unchanged or handled by the core, nothing to write";
+            }
+
+            libretroCore.saveDataBuf = nullptr;
+            libretroCore.saveDataSize = 0;
+            autosaveTimer.invalidate();
+
             qCInfo( phxCore ) << "============================";
 
+            // Last look at the core's performance counters before the game goes
+            if( libretroCore.perf.counterCount() ) {
+                libretroCore.perf.log();
+                emit commandOut( Command::SetPerfCounters, libretroCore.perf.snapshot(), nodeCurrentTime() );
+            }
+
+            perfCountersTimer.invalidate();
+
             // Unload core
             {
                 // symbols.retro_api_version is reasonably expected to be defined if the core is loaded
-                if( libretroCore.symbols.retro_api_version ) {
-                    libretroCore.symbols.retro_unload_game();
-                    libretroCore.symbols.retro_deinit();
-                    libretroCore.symbols.clear();
-                    libretroCore.coreFile.unload();
-                    qCDebug( phxCore ) << "Unloaded core successfully";
+                if( libretroCore.symbols.retro_api_version && libretroCore.warmCorePath.isEmpty() ) {
+                    // Nothing to unload if the core rejected the game
+                    if( libretroCore.gameLoaded ) {
+                        libretroCore.symbols.retro_unload_game();
+                    }
+
+                    // Only the game goes, the next one on this core can skip straight to retro_load_game()
+                    if( libretroCore.keepCoreLoaded ) {
+                        libretroCore.warmCorePath = libretroCore.coreFileInfo.absoluteFilePath();
+                        qCDebug( phxCore ) << "Unloaded game, keeping core loaded";
+                    } else {
+                        LibretroCoreUnloadCore();
+                        qCDebug( phxCore ) << "Unloaded core successfully";
+                    }
                 } else {
                     qCCritical( phxCore ) << "stop() called on an unloaded core!";
                 }
             }
 
-            // Unload game (if we've read its contents into a buffer)
+            // Unload game (if we've mapped or read its contents into memory)
+            {
+                if( libretroCore.gameData ) {
+                    libretroCore.gameFile.unmap( libretroCore.gameData );
+                    libretroCore.gameData = nullptr;
+                }
+
+                libretroCore.gameFile.close();
+                libretroCore.gameDataCopy.clear();
+                libretroCore.gameLoaded = false;
+            }
+
+            // Free rewind history
             {
-                libretroCore.gameData.clear();
+                libretroCore.rewind.free();
+                libretroCore.rewindable = false;
+                rewindFrameCounter = 0;
+            }
+
+            // Quick states belong to the game that was just unloaded, so do states still being read from disk
+            for( QByteArray &quickState : quickStates ) {
+                quickState.clear();
             }
 
+            stateGeneration++;
+
+            runAheadState.clear();
+            resetRunAheadStats();
+
+            // Run-ahead only gave up on the game that's going away, the next one gets to try again
+            if( libretroCore.runAheadFrames != runAheadRequested ) {
+                libretroCore.runAheadFrames = runAheadRequested;
+                emit commandOut( Command::SetRunAhead, runAheadRequested, nodeCurrentTime() );
+            }
+
+            // Memory maps point into the core that was just unloaded
+            memorySearch.clear();
+            libretroCore.memoryDescriptors.clear();
+            stopMemoryExport();
+            libretroCore.frameCount = 0;
+
             // Disconnect LibretroCore from the rest of the pipeline
             disconnect( &libretroCore, &LibretroCore::dataOut, this, &LibretroRunner::dataOut );
             disconnect( &libretroCore, &LibretroCore::commandOut, this, &LibretroRunner::commandOut );
             connectedToCore = false;
 
-            // Delete the FBO
-            {
-                if( libretroCore.fbo ) {
-                    delete libretroCore.fbo;
-                }
-
-                libretroCore.fbo = nullptr;
-            }
+            // Give the FBOs back to the pool, the next game may use them
+            LibretroCoreFreeFramebuffers();
 
             // Reset video mode to 2D (will be set to 3D if the next core asks for it)
             libretroCore.videoFormat.videoMode = SOFTWARERENDER;
@@ -116,20 +230,31 @@ void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp
             emit commandOut( command, data, timeStamp );
 
             if( libretroCore.state == State::Playing ) {
-                // If in 3D mode, lock the mutex before emulating then activate our context and FBO
-                // This is because we're not sure exactly when the core will render to the texture. So, we'll just lock the
-                // mutex for the *entire* frame to be safe and not just from the start of the frame until the video callback
-                // In 2D mode it's simpler: We know that the data will come in a buffer which we can quickly copy within
-                // the video callback.
+                // If in 3D mode, activate our context and the FBO the core draws into next
+                // No lock: the render thread samples a different FBO, the video callback hands this one over with a fence
+                // once the core's done with it
                 if( libretroCore.videoFormat.videoMode == HARDWARERENDER ) {
-                    libretroCore.videoMutex.lock();
-                    //qDebug() << "LibretroRunner lock";
                     libretroCore.context->makeCurrent( libretroCore.surface );
-                    libretroCore.fbo->bind();
+                    LibretroCoreBindFramebuffer();
+                }
+
+                libretroCore.memoryExport.beginFrames();
+
+                // Invoke libretro core, stepping backwards instead if we're rewinding
+                if( libretroCore.playbackSpeed <= 0.0 && libretroCore.rewindable ) {
+                    rewindStep();
+                } else if( libretroCore.playbackSpeed > 1.0 ) {
+                    fastForwardStep();
+                } else if( libretroCore.runAheadFrames > 0 && libretroCore.rewindable ) {
+                    runAheadStep();
+                } else {
+                    libretroCore.symbols.retro_run();
+                    libretroCore.frameCount++;
+                    rewindCapture();
                 }
 
-                // Invoke libretro core
-                libretroCore.symbols.retro_run();
+                // Let external tools see the core's memory
+                libretroCore.memoryExport.endFrames( libretroCore.frameCount );
 
                 // Update rumble state
                 // TODO: Apply per-controller
@@ -162,16 +287,26 @@ void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp
                     }
                 }
 
+                // Let the frontend see where the core's time goes
+                if( !perfCountersTimer.isValid() ) {
+                    perfCountersTimer.start();
+                } else if( perfCountersTimer.hasExpired( PERF_COUNTERS_INTERVAL ) && libretroCore.perf.counterCount() ) {
+                    perfCountersTimer.restart();
+                    emit commandOut( Command::SetPerfCounters, libretroCore.perf.snapshot(), nodeCurrentTime() );
+                }
+
                 if( libretroCore.videoFormat.videoMode == HARDWARERENDER ) {
                     libretroCore.context->makeCurrent( libretroCore.surface );
                     libretroCore.context->functions()->glFlush();
                     libretroCore.context->doneCurrent();
-                    //qDebug() << "LibretroRunner unlock";
-                    libretroCore.videoMutex.unlock();
                 }
 
-                // Flush stderr, some cores may still write to it despite having RETRO_LOG
-                fflush( stderr );
+                // Write out save data every so often so a crash doesn't lose it all
+                // Only once the frame's been flushed, hashing save data shouldn't hold up the render thread
+                if( autosaveTimer.hasExpired( SAVE_DATA_AUTOSAVE_INTERVAL ) ) {
+                    autosaveTimer.restart();
+                    storeSaveData( false );
+                }
             }
 
             break;
@@ -190,9 +325,86 @@ void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp
             break;
         }
 
+        case Command::SetPlaybackSpeed: {
+            libretroCore.playbackSpeed = data.toReal();
+            qCDebug( phxCore ) << command << libretroCore.playbackSpeed;
+            fastForwardBudget = 0.0;
+            resetFastForwardStats();
+            emit commandOut( command, data, timeStamp );
+            break;
+        }
+
+        case Command::SetRunAhead: {
+            runAheadRequested = qMax( 0, data.toInt() );
+            libretroCore.runAheadFrames = runAheadRequested;
+            qCDebug( phxCore ) << command << libretroCore.runAheadFrames;
+            resetRunAheadStats();
+            emit commandOut( command, data, timeStamp );
+            break;
+        }
+
+        case Command::SaveState: {
+            emit commandOut( command, data, timeStamp );
+            saveState( data.toInt() );
+            break;
+        }
+
+        case Command::SetMemoryExport: {
+            memoryExportInterval = data.toInt();
+            qCDebug( phxCore ) << command << memoryExportInterval;
+
+            // Starting again switches modes if need be
+            if( !memoryExportInterval ) {
+                stopMemoryExport();
+            } else if( libretroCore.state == State::Playing || libretroCore.state == State::Paused ) {
+                startMemoryExport();
+            }
+
+            emit commandOut( command, data, timeStamp );
+            break;
+        }
+
+        case Command::SetKeepCoreLoaded: {
+            libretroCore.keepCoreLoaded = data.toBool();
+            qCDebug( phxCore ) << command << libretroCore.keepCoreLoaded;
+
+            // Nothing is using the core kept loaded from the last game, let it go right away
+            if( !libretroCore.keepCoreLoaded && libretroCore.state == State::Stopped ) {
+                LibretroCoreUnloadWarmCore();
+            }
+
+            emit commandOut( command, data, timeStamp );
+            break;
+        }
+
+        case Command::SearchMemory: {
+            emit commandOut( command, data, timeStamp );
+            searchMemory( data.toMap() );
+            break;
+        }
+
+        case Command::LoadState: {
+            emit commandOut( command, data, timeStamp );
+            loadState( data.toInt() );
+            break;
+        }
+
+        case Command::SaveQuickState: {
+            emit commandOut( command, data, timeStamp );
+            saveQuickState( data.toInt() );
+            break;
+        }
+
+        case Command::LoadQuickState: {
+            emit commandOut( command, data, timeStamp );
+            loadQuickState( data.toInt() );
+            break;
+        }
+
         case Command::SetLibretroVariable: {
             LibretroVariable var = data.value<LibretroVariable>();
             libretroCore.variables.insert( var.key(), var );
+            LibretroCorePublishVariables();
             libretroCore.variablesAreDirty = true;
             emit commandOut( command, data, timeStamp );
             break;
@@ -224,6 +436,7 @@ void LibretroRunner::commandIn( Command command, QVariant data, qint64 timeStamp
             GamepadState gamepad = data.value<GamepadState>();
             int instanceID = gamepad.instanceID;
             libretroCore.gamepads.remove( instanceID );
+            LibretroCoreReleasePort( instanceID );
             emit commandOut( command, data, timeStamp );
             break;
         }
@@ -239,13 +452,14 @@ void LibretroRunner::dataIn( DataType type, QMutex *mutex, void *data, size_t by
     emit dataOut( type, mutex, data, bytes, timeStamp );
 
     switch( type ) {
-        // Make a copy of the data into our own gamepad list
+        // Make a copy of the data into our own gamepad list and reduce it to what the input state callback needs
         case DataType::Input: {
             mutex->lock();
-            GamepadState gamepad = *static_cast<GamepadState *>( data );
+            const GamepadState *incoming = static_cast<GamepadState *>( data );
+            GamepadState &gamepad = libretroCore.gamepads[ incoming->instanceID ];
+            gamepad = *incoming;
             mutex->unlock();
-            int instanceID = gamepad.instanceID;
-            libretroCore.gamepads[ instanceID ] = gamepad;
+            LibretroCoreUpdatePortState( gamepad );
             break;
         }
 
@@ -261,3 +475,443 @@ void LibretroRunner::dataIn( DataType type, QMutex *mutex, void *data, size_t by
             break;
     }
 }
+
+// Private
+
+void LibretroRunner::rewindStep() {
+    // Playback speeds of 0 and -1 both step back one snapshot per heartbeat, -2 steps back two, etc.
+    int steps = qMax( 1, qRound( -libretroCore.playbackSpeed ) );
+    const void *state = nullptr;
+
+    for( int i = 0; i < steps; i++ ) {
+        const void *previousState = libretroCore.rewind.pop();
+
+        if( !previousState ) {
+            break;
+        }
+
+        state = previousState;
+    }
+
+    // Out of history, hold on the oldest frame we have
+    if( !state ) {
+        return;
+    }
+
+    LibretroCoreUnserialize( state, libretroCore.rewind.stateSize() );
+    libretroCore.frameUncounted = true;
+    libretroCore.symbols.retro_run();
+    libretroCore.frameUncounted = false;
+}
+
+void LibretroRunner::rewindCapture() {
+    if( !libretroCore.rewind.isActive() ) {
+        return;
+    }
+
+    rewindFrameCounter++;
+
+    if( rewindFrameCounter < libretroCore.rewindInterval ) {
+        return;
+    }
+
+    rewindFrameCounter = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Some cores' states grow past the size they reported at load time, skip the snapshot if that happens
+    if( !libretroCore.symbols.retro_serialize( libretroCore.rewind.scratch(), libretroCore.rewind.stateSize() ) ) {
+        return;
+    }
+
+    libretroCore.rewind.push();
+
+    qint64 elapsed = timer.nsecsElapsed();
+    rewindSnapshotCount++;
+    rewindSnapshotTotalNsecs += elapsed;
+    rewindSnapshotMaxNsecs = qMax( rewindSnapshotMaxNsecs, elapsed );
+
+    if( rewindSnapshotCount == REWIND_REPORT_INTERVAL ) {
+        qreal seconds = libretroCore.rewind.count() * libretroCore.rewindInterval / libretroCore.videoFormat.videoFramerate;
+
+        qCDebug( phxCore ).nospace() << "Rewind snapshot cost: "
+                                     << rewindSnapshotTotalNsecs / rewindSnapshotCount / 1000.0 << "us avg, "
+                                     << rewindSnapshotMaxNsecs / 1000.0 << "us max (state size = "
+                                     << libretroCore.rewind.stateSize() / 1024.0 << " KB), history: "
+                                     << libretroCore.rewind.count() << " snapshots (" << seconds << "s) in "
+                                     << libretroCore.rewind.bytesUsed() / ( 1024.0 * 1024.0 ) << " MB";
+
+        rewindSnapshotCount = 0;
+        rewindSnapshotTotalNsecs = 0;
+        rewindSnapshotMaxNsecs = 0;
+    }
+}
+
+void LibretroRunner::runAheadStep() {
+    // Find out whether there's a state to go back to before the real frame's video is thrown away
+    if( !libretroCore.symbols.retro_serialize_size() ) {
+        qCWarning( phxCore ) << "Core does not support save states, disabling run-ahead";
+        disableRunAhead();
+
+        libretroCore.symbols.retro_run();
+        libretroCore.frameCount++;
+        rewindCapture();
+        return;
+    }
+
+    // Emulate the real frame. Its audio is played as usual, but its video is out of date by the time it would be shown
+    libretroCore.videoSuppressed = true;
+    libretroCore.symbols.retro_run();
+    libretroCore.videoSuppressed = false;
+    libretroCore.frameCount++;
+
+    rewindCapture();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if( !serializeInto( runAheadState ) ) {
+        qCWarning( phxCore ) << "Disabling run-ahead";
+        disableRunAhead();
+
+        // The real frame's video is gone, show the last one again rather than nothing
+        LibretroCoreVideoRefreshCallback( nullptr, static_cast<unsigned>( libretroCore.videoFormat.videoSize.width() ),
+                                          static_cast<unsigned>( libretroCore.videoFormat.videoSize.height() ),
+                                          libretroCore.videoFormat.videoBytesPerLine );
+        return;
+    }
+
+    // Emulate the hidden frames with the same input, only the last one gets presented
+    libretroCore.audioSuppressed = true;
+    libretroCore.frameUncounted = true;
+
+    for( int i = 1; i <= libretroCore.runAheadFrames; i++ ) {
+        libretroCore.videoSuppressed = i < libretroCore.runAheadFrames;
+        libretroCore.symbols.retro_run();
+    }
+
+    libretroCore.audioSuppressed = false;
+    libretroCore.videoSuppressed = false;
+    libretroCore.frameUncounted = false;
+
+    // Go back to the real frame. If the core can't, the game is now runAheadFrames ahead for good, stop making it worse
+    if( !LibretroCoreUnserialize( runAheadState.constData(), static_cast<size_t>( runAheadState.size() ) ) ) {
+        qCWarning( phxCore ) << "Core could not restore the run-ahead state, disabling run-ahead";
+        disableRunAhead();
+        return;
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    runAheadFrameCount++;
+    runAheadTotalNsecs += elapsed;
+    runAheadMaxNsecs = qMax( runAheadMaxNsecs, elapsed );
+
+    if( runAheadFrameCount == RUNAHEAD_REPORT_INTERVAL ) {
+        qreal averageMsecs = runAheadTotalNsecs / runAheadFrameCount / 1000000.0;
+        qreal frameBudgetMsecs = 1000.0 / libretroCore.videoFormat.videoFramerate;
+
+        qCDebug( phxCore ).nospace() << "Run-ahead (" << libretroCore.runAheadFrames << " frames) extra cost per frame: "
+                                     << averageMsecs << "ms avg, " << runAheadMaxNsecs / 1000000.0 << "ms max ("
+                                     << averageMsecs / frameBudgetMsecs * 100.0 << "% of the "
+                                     << frameBudgetMsecs << "ms frame budget)";
+
+        resetRunAheadStats();
+    }
+}
+
+void LibretroRunner::disableRunAhead() {
+    libretroCore.runAheadFrames = 0;
+    resetRunAheadStats();
+    emit commandOut( Command::SetRunAhead, 0, nodeCurrentTime() );
+}
+
+void LibretroRunner::resetRunAheadStats() {
+    runAheadFrameCount = 0;
+    runAheadTotalNsecs = 0;
+    runAheadMaxNsecs = 0;
+}
+
+void LibretroRunner::fastForwardStep() {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Carry the fractional part over so speeds like 1.5x average out correctly
+    fastForwardBudget += libretroCore.playbackSpeed;
+    int frames = static_cast<int>( fastForwardBudget );
+    fastForwardBudget -= frames;
+    frames = qMin( frames, FAST_FORWARD_MAX_FRAMES );
+
+    // Only the last frame is shown and heard. Skipping the others' video copies and audio keeps consumers (especially
+    // AudioOutput's resampler) running at their usual 1x rate, which amounts to dropping all but one frame's worth of audio
+    libretroCore.videoSuppressed = true;
+    libretroCore.audioSuppressed = true;
+
+    for( int i = 1; i <= frames; i++ ) {
+        if( i == frames ) {
+            libretroCore.videoSuppressed = false;
+            libretroCore.audioSuppressed = false;
+        }
+
+        libretroCore.symbols.retro_run();
+        libretroCore.frameCount++;
+    }
+
+    // Snapshotting every emulated frame would cost as much as the frames themselves, once per heartbeat is plenty
+    rewindCapture();
+
+    fastForwardHeartbeatCount++;
+    fastForwardFrameCount += frames;
+    fastForwardTotalNsecs += timer.nsecsElapsed();
+
+    if( fastForwardHeartbeatCount == FAST_FORWARD_REPORT_INTERVAL ) {
+        qreal framesPerSecond = fastForwardFrameCount / ( fastForwardTotalNsecs / 1000000000.0 );
+
+        qCDebug( phxCore ).nospace() << "Fast-forward at " << libretroCore.playbackSpeed << "x: "
+                                     << static_cast<qreal>( fastForwardFrameCount ) / fastForwardHeartbeatCount
+                                     << " frames per heartbeat, "
+                                     << fastForwardTotalNsecs / fastForwardHeartbeatCount / 1000000.0
+                                     << "ms per heartbeat, core could sustain "
+                                     << framesPerSecond / libretroCore.videoFormat.videoFramerate << "x";
+
+        resetFastForwardStats();
+    }
+}
+
+void LibretroRunner::resetFastForwardStats() {
+    fastForwardHeartbeatCount = 0;
+    fastForwardFrameCount = 0;
+    fastForwardTotalNsecs = 0;
+}
+
+void LibretroRunner::saveState( int slot ) {
+    if( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) {
+        qCWarning( phxCore ) << "Cannot save state, no game is running";
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int buffer = freeStateBuffer();
+
+    if( buffer < 0 ) {
+        qCWarning( phxCore ) << "Cannot save state, earlier states are still being written";
+        return;
+    }
+
+    if( !serializeInto( stateBuffers[ buffer ] ) ) {
+        return;
+    }
+
+    // Compression and disk I/O happen on the worker's thread. The buffer is shared with it until it says it's done
+    stateBufferBusy[ buffer ] = true;
+    QMetaObject::invokeMethod( &saveWorker, "writeState", Qt::QueuedConnection, Q_ARG( int, buffer ),
+                               Q_ARG( QString, LibretroCoreStatePath( slot ) ), Q_ARG( QByteArray, stateBuffers[ buffer ] ) );
+
+    qCDebug( phxCore ).nospace() << "Saved state to slot " << slot << " in " << timer.nsecsElapsed() / 1000000.0 << "ms";
+}
+
+void LibretroRunner::loadState( int slot ) {
+    if( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) {
+        qCWarning( phxCore ) << "Cannot load state, no game is running";
+        return;
+    }
+
+    // Reading and decompression happen on the worker's thread, stateRead() gets called once it's done
+    QMetaObject::invokeMethod( &saveWorker, "readState", Qt::QueuedConnection, Q_ARG( int, slot ),
+                               Q_ARG( QString, LibretroCoreStatePath( slot ) ), Q_ARG( quint64, stateGeneration ) );
+}
+
+void LibretroRunner::saveQuickState( int slot ) {
+    if( slot < 0 || slot >= QUICK_STATE_COUNT ) {
+        qCWarning( phxCore ) << "Invalid quick state slot" << slot;
+        return;
+    }
+
+    if( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) {
+        qCWarning( phxCore ) << "Cannot save state, no game is running";
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if( !serializeInto( quickStates[ slot ] ) ) {
+        quickStates[ slot ].clear();
+        return;
+    }
+
+    qCDebug( phxCore ).nospace() << "Saved quick state to slot " << slot << " in " << timer.nsecsElapsed() / 1000000.0 << "ms";
+}
+
+void LibretroRunner::loadQuickState( int slot ) {
+    if( slot < 0 || slot >= QUICK_STATE_COUNT ) {
+        qCWarning( phxCore ) << "Invalid quick state slot" << slot;
+        return;
+    }
+
+    if( quickStates[ slot ].isEmpty() ) {
+        qCWarning( phxCore ) << "Quick state slot" << slot << "is empty";
+        return;
+    }
+
+    stateRead( slot, quickStates[ slot ], stateGeneration );
+}
+
+void LibretroRunner::stateRead( int slot, QByteArray state, quint64 generation ) {
+    // The game may have been stopped (and another one loaded) while the state was being read
+    if( state.isEmpty() || generation != stateGeneration ||
+        ( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) ) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if( !LibretroCoreUnserialize( state.constData(), static_cast<size_t>( state.size() ) ) ) {
+        qCWarning( phxCore ) << "Core rejected state from slot" << slot;
+        return;
+    }
+
+    qCDebug( phxCore ).nospace() << "Loaded state from slot " << slot << " in " << timer.nsecsElapsed() / 1000000.0 << "ms";
+}
+
+bool LibretroRunner::serializeInto( QByteArray &buffer ) {
+    size_t stateSize = libretroCore.symbols.retro_serialize_size();
+
+    if( !stateSize ) {
+        qCWarning( phxCore ) << "Core does not support save states";
+        return false;
+    }
+
+    if( static_cast<size_t>( buffer.size() ) != stateSize ) {
+        buffer.resize( static_cast<int>( stateSize ) );
+    }
+
+    if( !libretroCore.symbols.retro_serialize( buffer.data(), stateSize ) ) {
+        qCWarning( phxCore ) << "Core failed to serialize its state";
+        return false;
+    }
+
+    return true;
+}
+
+int LibretroRunner::freeStateBuffer() {
+    for( int i = 0; i < STATE_BUFFER_COUNT; i++ ) {
+        if( !stateBufferBusy[ i ] ) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool LibretroRunner::storeSaveData( bool wait ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray saveData;
+
+    if( !LibretroCoreSnapshotSaveData( saveData ) ) {
+        return false;
+    }
+
+    // The write happens on the worker's thread, it gets its own copy of the save data so the core can keep going
+    QMetaObject::invokeMethod( &saveWorker, "writeSaveData", wait ? Qt::BlockingQueuedConnection : Qt::QueuedConnection,
+                               Q_ARG( QString, LibretroCoreSaveDataPath() ), Q_ARG( QByteArray, saveData ) );
+
+    qCDebug( phxCore ).nospace() << "Save data changed, snapshotted " << saveData.size() / 1024.0 << " KB in "
+                                 << timer.nsecsElapsed() / 1000000.0 << "ms";
+
+    return true;
+}
+
+void LibretroRunner::searchMemory( QVariantMap request ) {
+    static const QHash<QString, LibretroMemorySearch::Comparison> comparisons {
+        { QStringLiteral( "changed" ), LibretroMemorySearch::Comparison::Changed },
+        { QStringLiteral( "unchanged" ), LibretroMemorySearch::Comparison::Unchanged },
+        { QStringLiteral( "increased" ), LibretroMemorySearch::Comparison::Increased },
+        { QStringLiteral( "decreased" ), LibretroMemorySearch::Comparison::Decreased },
+        { QStringLiteral( "equal" ), LibretroMemorySearch::Comparison::Equal },
+        { QStringLiteral( "notequal" ), LibretroMemorySearch::Comparison::NotEqual },
+        { QStringLiteral( "greater" ), LibretroMemorySearch::Comparison::Greater },
+        { QStringLiteral( "less" ), LibretroMemorySearch::Comparison::Less },
+    };
+
+    if( libretroCore.state != State::Playing && libretroCore.state != State::Paused ) {
+        qCWarning( phxCore ) << "Cannot search memory, no game is running";
+        return;
+    }
+
+    QString comparison = request[ QStringLiteral( "comparison" ) ].toString();
+
+    if( comparison != QStringLiteral( "reset" ) && !comparisons.contains( comparison ) ) {
+        qCWarning( phxCore ) << "Unknown memory search comparison" << comparison;
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Start over if asked to or if there's no search in progress
+    if( comparison == QStringLiteral( "reset" ) || !memorySearch.isActive() ) {
+        QVector<LibretroMemoryRegion> regions = LibretroMemorySearch::regionsFromDescriptors( libretroCore.memoryDescriptors );
+
+        // No memory maps, fall back to the core's system RAM
+        if( regions.isEmpty() ) {
+            void *data = libretroCore.symbols.retro_get_memory_data( RETRO_MEMORY_SYSTEM_RAM );
+            size_t size = libretroCore.symbols.retro_get_memory_size( RETRO_MEMORY_SYSTEM_RAM );
+
+            if( data && size ) {
+                regions.append( LibretroMemoryRegion { static_cast<uint8_t *>( data ), size, 0 } );
+            }
+        }
+
+        if( regions.isEmpty() ) {
+            qCWarning( phxCore ) << "Cannot search memory, the core does not expose any";
+            return;
+        }
+
+        memorySearch.reset( regions );
+    }
+
+    if( comparison != QStringLiteral( "reset" ) ) {
+        memorySearch.search( comparisons[ comparison ], static_cast<quint8>( request[ QStringLiteral( "value" ) ].toInt() ) );
+    }
+
+    qreal msecs = timer.nsecsElapsed() / 1000000.0;
+
+    QVariantList matches;
+
+    for( const LibretroMemoryMatch &match : memorySearch.matches( MEMORY_SEARCH_MAX_MATCHES ) ) {
+        QVariantMap entry;
+        entry[ QStringLiteral( "address" ) ] = static_cast<qulonglong>( match.address );
+        entry[ QStringLiteral( "value" ) ] = match.value;
+        matches.append( entry );
+    }
+
+    QVariantMap results;
+    results[ QStringLiteral( "count" ) ] = memorySearch.count();
+    results[ QStringLiteral( "size" ) ] = static_cast<qint64>( memorySearch.size() );
+    results[ QStringLiteral( "msecs" ) ] = msecs;
+    results[ QStringLiteral( "matches" ) ] = matches;
+
+    qCDebug( phxCore ).nospace() << "Memory search (" << comparison << "): " << memorySearch.count() << " of "
+                                 << memorySearch.size() << " bytes left in " << msecs << "ms";
+
+    emit commandOut( Command::SetMemorySearchResults, results, nodeCurrentTime() );
+}
+
+void LibretroRunner::startMemoryExport() {
+    // Empty if it failed to start
+    libretroCore.memoryExport.start( qMax( 0, memoryExportInterval ) );
+    emit commandOut( Command::SetMemoryExportName, libretroCore.memoryExport.name(), nodeCurrentTime() );
+}
+
+void LibretroRunner::stopMemoryExport() {
+    if( libretroCore.memoryExport.isActive() ) {
+        libretroCore.memoryExport.stop();
+        emit commandOut( Command::SetMemoryExportName, QString(), nodeCurrentTime() );
+    }
+}
@@ -1,15 +1,27 @@
 #pragma once
 
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QThread>
 
 #include "libretrocore.h"
+#include "libretromemorysearch.h"
+#include "libretrosaveworker.h"
 #include "node.h"
 
+// Number of buffers states can be serialized into while earlier ones are still being compressed/written to disk
+#define STATE_BUFFER_COUNT 3
+
+// Number of in-memory save state slots
+#define QUICK_STATE_COUNT 10
+
 class LibretroRunner : public Node {
         Q_OBJECT
 
     public:
-        LibretroRunner() = default;
+        LibretroRunner();
+        ~LibretroRunner();
 
     public slots:
         void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
@@ -17,4 +29,118 @@ class LibretroRunner : public Node {
 
     private:
         bool connectedToCore { false };
+
+        // Rewind
+
+        // Step backwards through the rewind history according to the playback speed, then emulate a frame to show it
+        void rewindStep();
+
+        // Snapshot the core's state into the rewind history if it's time to
+        void rewindCapture();
+
+        int rewindFrameCounter { 0 };
+
+        // Snapshot cost telemetry, reported every REWIND_REPORT_INTERVAL snapshots
+        int rewindSnapshotCount { 0 };
+        qint64 rewindSnapshotTotalNsecs { 0 };
+        qint64 rewindSnapshotMaxNsecs { 0 };
+
+        // Fast-forward
+
+        // Emulate playbackSpeed frames (on average), only presenting the last one
+        void fastForwardStep();
+
+        void resetFastForwardStats();
+
+        // Frames owed to fast-forward, the fractional part carries over to the next heartbeat
+        qreal fastForwardBudget { 0.0 };
+
+        // Throughput telemetry, reported every FAST_FORWARD_REPORT_INTERVAL heartbeats
+        int fastForwardHeartbeatCount { 0 };
+        qint64 fastForwardFrameCount { 0 };
+        qint64 fastForwardTotalNsecs { 0 };
+
+        // Run-ahead
+
+        // Emulate the real frame without showing it, then emulate libretroCore.runAheadFrames more with audio muted,
+        // show the last one and restore the real frame's state
+        void runAheadStep();
+
+        // Turn run-ahead off for the rest of this game and let everyone know (Command::SetRunAhead)
+        void disableRunAhead();
+
+        void resetRunAheadStats();
+
+        // Run-ahead asked for with Command::SetRunAhead, restored on Stop if the game had to turn it off
+        int runAheadRequested { 0 };
+
+        // State of the real frame, restored after the hidden frames have been emulated
+        QByteArray runAheadState;
+
+        // Extra cost per frame (serialize + hidden frames + unserialize), reported every RUNAHEAD_REPORT_INTERVAL frames
+        int runAheadFrameCount { 0 };
+        qint64 runAheadTotalNsecs { 0 };
+        qint64 runAheadMaxNsecs { 0 };
+
+        // Save states
+
+        void saveState( int slot );
+        void loadState( int slot );
+        void saveQuickState( int slot );
+        void loadQuickState( int slot );
+
+        // Called once saveWorker has read a state from disk, dropped unless generation is still stateGeneration
+        void stateRead( int slot, QByteArray state, quint64 generation );
+
+        // Serialize the core's state into buffer, resizing it if the core's state size changed
+        bool serializeInto( QByteArray &buffer );
+
+        // Returns the index of a buffer saveWorker is not using, -1 if they're all busy
+        int freeStateBuffer();
+
+        // Does compression and disk I/O for save states on its own thread
+        QThread saveThread;
+        LibretroSaveWorker saveWorker;
+
+        // Preallocated buffers for states on their way to disk
+        QByteArray stateBuffers[ STATE_BUFFER_COUNT ];
+
+        // Set while saveWorker has the buffer, until it sends stateWritten()
+        bool stateBufferBusy[ STATE_BUFFER_COUNT ] { false };
+
+        // Bumped on every Stop, reads of states requested before then are dropped
+        quint64 stateGeneration { 0 };
+
+        // States kept in memory for instant loading
+        QByteArray quickStates[ QUICK_STATE_COUNT ];
+
+        // Memory search
+
+        // Run the search described by request (see Command::SearchMemory) and send out the results
+        void searchMemory( QVariantMap request );
+
+        LibretroMemorySearch memorySearch;
+
+        // Memory export (libretroCore.memoryExport)
+
+        // Copy the core's memory out every this many frames, export it in place if negative, 0 if disabled
+        int memoryExportInterval { 0 };
+
+        // (Re)start or stop the export and send out its segment's name (Command::SetMemoryExportName)
+        void startMemoryExport();
+        void stopMemoryExport();
+
+        // Save data (SRAM)
+
+        // Hand the save data to saveWorker if it's changed since it was last loaded or written, optionally waiting for
+        // the write to finish. Returns false if there was nothing to write
+        bool storeSaveData( bool wait );
+
+        // Times the periodic save data check, runs while a game is loaded
+        QElapsedTimer autosaveTimer;
+
+        // Performance counters
+
+        // Times sending out the core's performance counters, runs while playing
+        QElapsedTimer perfCountersTimer;
 };
@@ -0,0 +1,82 @@
+#include "libretrosaveworker.h"
+#include "logging.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+
+// Fastest zlib level, states are mostly redundant so this already gets most of the gains
+#define STATE_COMPRESSION_LEVEL 1
+
+LibretroSaveWorker::LibretroSaveWorker( QObject *parent ) : QObject( parent ) {
+}
+
+void LibretroSaveWorker::writeState( int buffer, QString path, QByteArray state ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    int stateSize = state.size();
+    QByteArray compressed = qCompress( state, STATE_COMPRESSION_LEVEL );
+
+    // The caller can have its buffer back
+    state.clear();
+    emit stateWritten( buffer );
+
+    // QSaveFile writes to a temporary file then renames it over the old one so a crash never leaves a half-written state
+    QSaveFile file( path );
+
+    if( !file.open( QIODevice::WriteOnly ) ) {
+        qCWarning( phxCore ).nospace() << "Could not open " << path << " for writing: " << file.errorString();
+        return;
+    }
+
+    file.write( compressed );
+
+    if( !file.commit() ) {
+        qCWarning( phxCore ).nospace() << "Could not write " << path << ": " << file.errorString();
+        return;
+    }
+
+    qCDebug( phxCore ).nospace() << "Wrote state " << path << " (" << stateSize / 1024.0 << " KB -> "
+                                 << compressed.size() / 1024.0 << " KB) in " << timer.nsecsElapsed() / 1000000.0 << "ms";
+}
+
+void LibretroSaveWorker::readState( int slot, QString path, quint64 generation ) {
+    QFile file( path );
+
+    if( !file.open( QIODevice::ReadOnly ) ) {
+        qCWarning( phxCore ).nospace() << "Could not open " << path << " for reading: " << file.errorString();
+        emit stateRead( slot, QByteArray(), generation );
+        return;
+    }
+
+    QByteArray state = qUncompress( file.readAll() );
+
+    if( state.isEmpty() ) {
+        qCWarning( phxCore ).nospace() << "State " << path << " is corrupt";
+    }
+
+    emit stateRead( slot, state, generation );
+}
+
+void LibretroSaveWorker::writeSaveData( QString path, QByteArray saveData ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile file( path );
+
+    if( !file.open( QIODevice::WriteOnly ) ) {
+        qCWarning( phxCore ).nospace() << "Could not open " << path << " for writing: " << file.errorString();
+        return;
+    }
+
+    file.write( saveData );
+
+    if( !file.commit() ) {
+        qCWarning( phxCore ).nospace() << "Could not write " << path << ": " << file.errorString();
+        return;
+    }
+
+    qCDebug( phxCore ).nospace() << "Wrote save data " << path << " (" << saveData.size() / 1024.0 << " KB) in "
+                                 << timer.nsecsElapsed() / 1000000.0 << "ms";
+}
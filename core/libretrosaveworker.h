@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+/*
+ * LibretroSaveWorker does the slow parts of saving and loading (compression, decompression and disk I/O) of save
+ * states and save data so the game thread never blocks on them. It's meant to live in its own thread, invoke its
+ * slots via queued connections.
+ *
+ * Buffers given to the worker are implicitly shared. writeState() takes the caller's index for the buffer and hands it
+ * back through stateWritten() once the worker is done with it. Reads are tagged with the caller's generation, handed
+ * back through stateRead() so a result that arrives after the game changed can be told apart.
+ */
+
+class LibretroSaveWorker : public QObject {
+        Q_OBJECT
+
+    public:
+        explicit LibretroSaveWorker( QObject *parent = nullptr );
+
+    signals:
+        // A state has been read from disk and decompressed, empty if it could not be read
+        void stateRead( int slot, QByteArray state, quint64 generation );
+
+        // writeState() is done with buffer (it's been compressed), whether the write succeeds or not
+        void stateWritten( int buffer );
+
+    public slots:
+        // Compress then atomically write a serialized state to disk, emits stateWritten() once done
+        void writeState( int buffer, QString path, QByteArray state );
+
+        // Read then decompress a serialized state from disk, emits stateRead() once done
+        void readState( int slot, QString path, quint64 generation );
+
+        // Atomically write save data (SRAM) to disk as-is
+        void writeSaveData( QString path, QByteArray saveData );
+};
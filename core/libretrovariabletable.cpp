@@ -0,0 +1,77 @@
+#include "libretrovariabletable.h"
+
+#include <string.h>
+
+LibretroVariableTable::LibretroVariableTable( const QMap<QByteArray, LibretroVariable> &variables ) {
+    QVector<const LibretroVariable *> included;
+
+    for( const LibretroVariable &variable : variables ) {
+        if( variable.isValid() && !variable.value().isEmpty() ) {
+            included.append( &variable );
+        }
+    }
+
+    count = included.size();
+
+    // Keep the table at most half full so probe sequences stay short
+    int capacity = 8;
+
+    while( capacity < count * 2 ) {
+        capacity <<= 1;
+    }
+
+    mask = static_cast<quint64>( capacity - 1 );
+    entries.fill( Entry { 0, -1, -1 }, capacity );
+
+    for( const LibretroVariable *variable : included ) {
+        Entry entry;
+        entry.hash = hashKey( variable->key().constData() );
+        entry.keyOffset = strings.size();
+        strings.append( variable->key() ).append( '\0' );
+        entry.valueOffset = strings.size();
+        strings.append( variable->value() ).append( '\0' );
+
+        quint64 index = entry.hash & mask;
+
+        while( entries[ index ].keyOffset != -1 ) {
+            index = ( index + 1 ) & mask;
+        }
+
+        entries[ index ] = entry;
+    }
+}
+
+const char *LibretroVariableTable::value( const char *key ) const {
+    if( !key ) {
+        return nullptr;
+    }
+
+    quint64 hash = hashKey( key );
+    const char *data = strings.constData();
+
+    for( quint64 index = hash & mask; entries[ index ].keyOffset != -1; index = ( index + 1 ) & mask ) {
+        const Entry &entry = entries[ index ];
+
+        if( entry.hash == hash && strcmp( data + entry.keyOffset, key ) == 0 ) {
+            return data + entry.valueOffset;
+        }
+    }
+
+    return nullptr;
+}
+
+int LibretroVariableTable::size() const {
+    return count;
+}
+
+// FNV-1a
+quint64 LibretroVariableTable::hashKey( const char *key ) {
+    quint64 hash = 14695981039346656037ULL;
+
+    for( const unsigned char *c = reinterpret_cast<const unsigned char *>( key ); *c; c++ ) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMap>
+#include <QVector>
+
+#include "libretrovariable.h"
+
+/*
+ * LibretroVariableTable is an immutable snapshot of the core's variables (key -> current value), made for answering
+ * RETRO_ENVIRONMENT_GET_VARIABLE. Some cores ask for their variables every frame, so a lookup hashes the key in place and
+ * probes an open-addressed table without allocating anything.
+ *
+ * Every key and value is stored in one block of memory owned by the table, so the pointers value() returns stay valid
+ * for as long as the table exists. Variables are never changed in place: build a new table and swap it in instead.
+ */
+
+class LibretroVariableTable {
+    public:
+        // Only variables that are valid and have a value are included
+        explicit LibretroVariableTable( const QMap<QByteArray, LibretroVariable> &variables );
+
+        // The current value of the given variable as a null-terminated string, nullptr if there's no such variable
+        const char *value( const char *key ) const;
+
+        int size() const;
+
+    private:
+        struct Entry {
+            quint64 hash;
+
+            // Offsets of the key and value in strings, keyOffset is -1 if this entry is empty
+            int keyOffset;
+            int valueOffset;
+        };
+
+        static quint64 hashKey( const char *key );
+
+        QVector<Entry> entries;
+        quint64 mask { 0 };
+        int count { 0 };
+
+        // All keys and values back to back, each null-terminated
+        QByteArray strings;
+};
@@ -0,0 +1,119 @@
+##
+## phoenix-corehost: Runs a Libretro core for the backend in a separate process (see main.cpp)
+##
+
+##
+## Qt settings
+##
+
+    # Undefine this for gcc (MINGW), it's not necessary
+    gcc: CONFIG -= debug_and_release debug_and_release_target
+
+    CONFIG += console qt
+    CONFIG -= app_bundle
+
+    TEMPLATE = app
+
+    # No QML or window, multimedia is only needed for QAudioFormat in the shared pipeline headers
+    # Network is for QLocalSocket, the control channel to the backend
+    QT += gui multimedia network
+
+    TARGET = phoenix-corehost
+
+##
+## Compiler settings
+##
+
+    CONFIG += c++11
+
+    OBJECTS_DIR = obj
+    MOC_DIR     = moc
+    RCC_DIR     = rcc
+    UI_DIR      = gui
+
+    # Include libraries
+    win32: gcc:  INCLUDEPATH += C:/msys64/mingw64/include C:/msys64/mingw64/include/SDL2 # MSYS2
+    win32: gcc:  INCLUDEPATH += /usr/lib/mxe/usr/x86_64-w64-mingw32.static/include/SDL2  # MXE (MinGW)
+    macx:        INCLUDEPATH += /usr/local/include /usr/local/include/SDL2               # Homebrew
+    macx:        INCLUDEPATH += /usr/local/include /opt/local/include/SDL2               # MacPorts
+    unix:        INCLUDEPATH += /usr/include/SDL2                                        # Linux
+
+    # Include our stuff
+    INCLUDEPATH += . ../core ../input ../pipeline ../util
+
+    # Build with debugging info
+    DEFINES += QT_MESSAGELOGCONTEXT
+
+    HEADERS += \
+    corehostbridge.h \
+    ../core/core.h \
+    ../core/libretro.h \
+    ../core/libretrocore.h \
+    ../core/libretrocorehost.h \
+    ../core/libretroloader.h \
+    ../core/libretromemoryexport.h \
+    ../core/libretromemorysearch.h \
+    ../core/libretromovie.h \
+    ../core/libretromovieplayer.h \
+    ../core/libretromovierecorder.h \
+    ../core/libretroperf.h \
+    ../core/libretrorewind.h \
+    ../core/libretrorunner.h \
+    ../core/libretrosaveworker.h \
+    ../core/libretrosymbols.h \
+    ../core/libretrovariable.h \
+    ../core/libretrovariabletable.h \
+    ../input/gamepadstate.h \
+    ../input/mousestate.h \
+    ../pipeline/audioring.h \
+    ../pipeline/node.h \
+    ../pipeline/pipelinecommon.h \
+    ../util/glfences.h \
+    ../util/hash64.h \
+    ../util/logging.h \
+    ../util/logring.h \
+    ../util/memoryusage.h \
+    ../util/triplebuffer.h \
+
+    SOURCES += \
+    corehostbridge.cpp \
+    main.cpp \
+    ../core/core.cpp \
+    ../core/libretrocore.cpp \
+    ../core/libretrocorehost.cpp \
+    ../core/libretroloader.cpp \
+    ../core/libretromemoryexport.cpp \
+    ../core/libretromemorysearch.cpp \
+    ../core/libretromovie.cpp \
+    ../core/libretromovieplayer.cpp \
+    ../core/libretromovierecorder.cpp \
+    ../core/libretroperf.cpp \
+    ../core/libretrorewind.cpp \
+    ../core/libretrorunner.cpp \
+    ../core/libretrosaveworker.cpp \
+    ../core/libretrosymbols.cpp \
+    ../core/libretrovariable.cpp \
+    ../core/libretrovariabletable.cpp \
+    ../input/gamepadstate.cpp \
+    ../input/mousestate.cpp \
+    ../pipeline/audioring.cpp \
+    ../pipeline/node.cpp \
+    ../util/glfences.cpp \
+    ../util/hash64.cpp \
+    ../util/logging.cpp \
+    ../util/logring.cpp \
+    ../util/memoryusage.cpp \
+
+##
+## Linker settings
+##
+
+    # SDL2
+    macx: LIBS += -L/usr/local/lib -L/opt/local/lib # Homebrew, MacPorts
+
+    !msvc {
+        win32: LIBS += -lSDL2main
+        LIBS += -lSDL2
+        win32: LIBS += -lpsapi
+        unix:!macx: LIBS += -lrt
+    }
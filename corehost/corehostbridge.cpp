@@ -0,0 +1,239 @@
+#include "corehostbridge.h"
+#include "libretrocore.h"
+#include "logging.h"
+
+#include <QCoreApplication>
+
+#include <new>
+#include <string.h>
+
+// Give up waiting for the backend to finish writing input after this many tries and keep the previous input
+#define INPUT_READ_ATTEMPTS 1000
+
+CoreHostBridge::CoreHostBridge( Node *parent ) : Node( parent ) {
+    connect( &socket, &QLocalSocket::readyRead, this, &CoreHostBridge::readMessages );
+    connect( &socket, &QLocalSocket::disconnected, this, &CoreHostBridge::backendDisconnected );
+}
+
+bool CoreHostBridge::start( const QString &key ) {
+    this->key = key;
+
+    socket.connectToServer( key );
+
+    if( !socket.waitForConnected( COREHOST_CONNECT_TIMEOUT ) ) {
+        qCCritical( phxCore ).nospace() << "Could not connect to the backend at " << key << ": " << socket.errorString();
+        return false;
+    }
+
+    channel.setSocket( &socket );
+
+    ioSegment.setKey( key + QStringLiteral( "-io" ) );
+
+    if( !ioSegment.attach() ) {
+        qCCritical( phxCore ).nospace() << "Could not attach to shared memory segment " << ioSegment.key() << ": "
+                                        << ioSegment.errorString();
+        return false;
+    }
+
+    uint8_t *base = static_cast<uint8_t *>( ioSegment.data() );
+    segment = reinterpret_cast<CoreHostSegment *>( base );
+
+    if( static_cast<size_t>( ioSegment.size() ) < CoreHostSegmentSize() || segment->magic != COREHOST_MAGIC ||
+        segment->version != COREHOST_VERSION ) {
+        qCCritical( phxCore ) << "Shared memory segment" << ioSegment.key() << "is not from a matching backend";
+        return false;
+    }
+
+    if( !libretroCore.audioRing.attach( base + CoreHostAudioRingOffset(), COREHOST_AUDIO_FRAMES ) ) {
+        qCCritical( phxCore ) << "Could not attach to the backend's audio ring";
+        return false;
+    }
+
+    libretroCore.videoPoolAllocator = [ this ]( size_t bytes ) {
+        return allocateVideoPool( bytes );
+    };
+
+    qCDebug( phxCore ) << "Connected to the backend at" << key;
+
+    return true;
+}
+
+void CoreHostBridge::commandIn( Command command, QVariant data, qint64 timeStamp ) {
+    switch( command ) {
+        // The backend sent it down its own pipeline already
+        case Command::Heartbeat: {
+            break;
+        }
+
+        case Command::Stop: {
+            CoreHostMessage message;
+            message.command = command;
+            message.data = data;
+            message.timeStamp = timeStamp;
+            channel.send( message );
+
+            stopped = true;
+            QCoreApplication::quit();
+            break;
+        }
+
+        default: {
+            if( !CoreHostChannel::canSend( data ) ) {
+                break;
+            }
+
+            CoreHostMessage message;
+            message.command = command;
+            message.data = data;
+            message.timeStamp = timeStamp;
+            channel.send( message );
+            break;
+        }
+    }
+}
+
+void CoreHostBridge::dataIn( DataType type, QMutex *, void *data, size_t bytes, qint64 timeStamp ) {
+    switch( type ) {
+        case DataType::Video: {
+            // data points into videoBufferPool, which lives in shared memory if allocateVideoPool() succeeded
+            ptrdiff_t index = static_cast<uint8_t **>( data ) - libretroCore.videoBufferPool;
+
+            if( !libretroCore.videoPoolExternal || index < 0 || index >= POOL_SIZE ) {
+                break;
+            }
+
+            CoreHostMessage message;
+            message.type = CoreHostMessage::Type::VideoFrame;
+            message.data = static_cast<int>( index );
+            message.bytes = bytes;
+            message.timeStamp = timeStamp;
+            channel.send( message );
+            break;
+        }
+
+        case DataType::Audio: {
+            CoreHostMessage message;
+            message.type = CoreHostMessage::Type::AudioChunk;
+            message.bytes = bytes;
+            message.timeStamp = timeStamp;
+            channel.send( message );
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// Private
+
+void CoreHostBridge::readMessages() {
+    CoreHostMessage message;
+
+    while( channel.receive( message ) ) {
+        if( message.type != CoreHostMessage::Type::Command ) {
+            continue;
+        }
+
+        if( message.command == Command::Heartbeat ) {
+            applyInput();
+        }
+
+        emit commandOut( message.command, message.data, message.timeStamp );
+    }
+}
+
+void CoreHostBridge::applyInput() {
+    CoreHostInput &input = segment->input;
+    quint32 generation = input.generation.load( std::memory_order_acquire );
+
+    if( generation == inputGeneration ) {
+        return;
+    }
+
+    CoreHostController controllers[ COREHOST_MAX_CONTROLLERS ];
+    int count = 0;
+    double mouseX = 0.0;
+    double mouseY = 0.0;
+    quint32 mouseButtons = 0;
+    bool consistent = false;
+
+    for( int attempt = 0; attempt < INPUT_READ_ATTEMPTS && !consistent; attempt++ ) {
+        generation = input.generation.load( std::memory_order_acquire );
+
+        // Being written
+        if( generation & 1 ) {
+            continue;
+        }
+
+        count = qBound( 0, static_cast<int>( input.controllerCount ), COREHOST_MAX_CONTROLLERS );
+        memcpy( controllers, input.controllers, sizeof( CoreHostController ) * static_cast<size_t>( count ) );
+        mouseX = input.mouseX;
+        mouseY = input.mouseY;
+        mouseButtons = input.mouseButtons;
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        consistent = input.generation.load( std::memory_order_relaxed ) == generation;
+    }
+
+    if( !consistent ) {
+        return;
+    }
+
+    inputGeneration = generation;
+
+    QSet<int> present;
+
+    for( int i = 0; i < count; i++ ) {
+        LibretroCoreSetPortState( controllers[ i ].instanceID, controllers[ i ].state );
+        present.insert( controllers[ i ].instanceID );
+    }
+
+    for( int instanceID : instanceIDs ) {
+        if( !present.contains( instanceID ) ) {
+            LibretroCoreReleasePort( instanceID );
+        }
+    }
+
+    instanceIDs = present;
+
+    libretroCore.mouse.position = QPointF( mouseX, mouseY );
+    libretroCore.mouse.buttons = Qt::MouseButtons( static_cast<int>( mouseButtons ) );
+}
+
+uint8_t *CoreHostBridge::allocateVideoPool( size_t bytes ) {
+    QSharedMemory *newSegment = new QSharedMemory( key + QStringLiteral( "-video-%1" ).arg( videoSegmentCount++ ), this );
+
+    if( !newSegment->create( static_cast<int>( sizeof( CoreHostVideoHeader ) + bytes ) ) ) {
+        qCWarning( phxCore ).nospace() << "Could not create shared memory segment " << newSegment->key() << ": "
+                                       << newSegment->errorString() << ", video will not reach the backend";
+        delete newSegment;
+        return nullptr;
+    }
+
+    // Nothing points into the old pool anymore (LibretroCore swaps it under videoMutexes), the segment itself goes away
+    // once the backend has moved to the new one too
+    delete videoSegment;
+    videoSegment = newSegment;
+
+    CoreHostVideoHeader *header = new( videoSegment->data() ) CoreHostVideoHeader();
+    libretroCore.videoPoolSequences = header->sequences;
+
+    CoreHostMessage message;
+    message.type = CoreHostMessage::Type::VideoPool;
+    message.data = videoSegment->key();
+    message.bytes = libretroCore.videoPoolIndividualBufferSize;
+    channel.send( message );
+
+    return static_cast<uint8_t *>( videoSegment->data() ) + sizeof( CoreHostVideoHeader );
+}
+
+void CoreHostBridge::backendDisconnected() {
+    if( stopped ) {
+        return;
+    }
+
+    // Stop the core properly so its save data is written, then quit
+    qCWarning( phxCore ) << "Lost the connection to the backend, stopping";
+    emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QLocalSocket>
+#include <QObject>
+#include <QSet>
+#include <QSharedMemory>
+#include <QString>
+
+#include "libretrocorehost.h"
+#include "node.h"
+
+/*
+ * CoreHostBridge is the host side of LibretroCoreProxy: it connects to the backend, then acts as the parent of
+ * LibretroLoader and the child of LibretroRunner.
+ *
+ * Commands from the backend go down to the loader, with the latest input applied to LibretroCore just before each
+ * heartbeat. Whatever the runner sends out goes back to the backend: commands as they are, video frames and audio
+ * chunks as notifications (the data itself is already in shared memory, see libretrocorehost.h).
+ *
+ * The host quits once the core has stopped. If the backend goes away first, the core is stopped so its save data still
+ * gets written.
+ */
+
+class CoreHostBridge : public Node {
+        Q_OBJECT
+
+    public:
+        explicit CoreHostBridge( Node *parent = nullptr );
+
+        // Connect to the backend and attach to its shared memory. Returns false if any of that failed
+        bool start( const QString &key );
+
+    public slots:
+        // Sink for LibretroRunner, everything goes to the backend
+        void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
+        void dataIn( DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp ) override;
+
+    private:
+        // Handle every complete message the backend has sent so far
+        void readMessages();
+
+        // Plug in, update and unplug controllers to match what the backend last published
+        void applyInput();
+
+        // LibretroCore::videoPoolAllocator, creates "<key>-video-<n>" (sequence words, then the pool) and tells the
+        // backend about it
+        uint8_t *allocateVideoPool( size_t bytes );
+
+        void backendDisconnected();
+
+        QString key;
+        QLocalSocket socket;
+        CoreHostChannel channel;
+
+        QSharedMemory ioSegment;
+        CoreHostSegment *segment { nullptr };
+
+        // The current video pool, a new segment with the next n each time the pool grows: the backend is still
+        // attached to the old one until it gets the new one's key, so the old key can't be reused
+        QSharedMemory *videoSegment { nullptr };
+        int videoSegmentCount { 0 };
+
+        // Input generation last applied and the controllers it had
+        quint32 inputGeneration { 0 };
+        QSet<int> instanceIDs;
+
+        bool stopped { false };
+};
@@ -0,0 +1,75 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <stdio.h>
+
+#include "corehostbridge.h"
+#include "libretrocorehost.h"
+#include "libretroloader.h"
+#include "libretromovieplayer.h"
+#include "libretromovierecorder.h"
+#include "libretrorunner.h"
+#include "logging.h"
+
+/*
+ * phoenix-corehost: Runs a Libretro core on behalf of LibretroCoreProxy in another process (see libretrocoreproxy.h)
+ *
+ * Usage: phoenix-corehost --key <key>
+ *
+ * Started by the backend, not meant to be run by hand.
+ */
+
+int main( int argc, char *argv[] ) {
+    QCoreApplication app( argc, argv );
+    QCoreApplication::setApplicationName( "phoenix-corehost" );
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription( "Runs a Libretro core for the Phoenix backend in a process of its own." );
+    parser.addHelpOption();
+
+    QCommandLineOption keyOption( "key", "Name of the backend's socket and prefix of its shared memory segments.", "key" );
+    parser.addOption( keyOption );
+
+    parser.process( app );
+
+    if( !parser.isSet( keyOption ) ) {
+        QTextStream( stderr ) << "phoenix-corehost is started by the Phoenix backend, it can't be run on its own" << endl;
+        return 1;
+    }
+
+    // Our log ends up in the backend's: written from a thread of its own like the backend does, as records the backend
+    // can log again with their type and category intact
+    startAsyncLogging();
+    setLogRecordOutput( true );
+
+    // Our stdout is a pipe to the backend: keep the core's output from sitting in a full buffer
+    setvbuf( stdout, nullptr, _IOLBF, 0 );
+
+    CoreHostRegisterTypes();
+
+    // Pipeline: CoreHostBridge -> LibretroLoader -> LibretroRunner -> CoreHostBridge, LibretroMoviePlayer,
+    // LibretroMovieRecorder
+    CoreHostBridge bridge;
+    LibretroLoader libretroLoader;
+    LibretroRunner libretroRunner;
+    LibretroMoviePlayer moviePlayer;
+    LibretroMovieRecorder movieRecorder;
+
+    connectNodes( &bridge, &libretroLoader );
+    connectNodes( &libretroLoader, &libretroRunner );
+    connectNodes( &libretroRunner, &bridge );
+    connectNodes( &libretroRunner, &moviePlayer );
+    connectNodes( &libretroRunner, &movieRecorder );
+
+    if( !bridge.start( parser.value( keyOption ) ) ) {
+        return 1;
+    }
+
+    int result = app.exec();
+
+    // The host exits along with its game, so there's nothing to keep a core loaded (see keepCoreLoaded) for
+    LibretroCoreUnloadWarmCore();
+
+    return result;
+}
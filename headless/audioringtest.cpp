@@ -0,0 +1,212 @@
+#include "audioringtest.h"
+#include "audioring.h"
+#include "libretrocore.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Sequence numbers are split across both channels, a torn frame decodes to the wrong number
+    inline void encodeFrame( quint32 sequence, int16_t *frame ) {
+        frame[ 0 ] = static_cast<int16_t>( sequence & 0xFFFF );
+        frame[ 1 ] = static_cast<int16_t>( sequence >> 16 );
+    }
+
+    inline quint32 decodeFrame( const int16_t *frame ) {
+        return static_cast<quint32>( static_cast<uint16_t>( frame[ 0 ] ) ) |
+               ( static_cast<quint32>( static_cast<uint16_t>( frame[ 1 ] ) ) << 16 );
+    }
+
+    inline quint32 xorshift( quint32 &state ) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
+
+bool audioRingStressTest( int seconds, QTextStream &out ) {
+    // Small enough that it wraps and fills up constantly
+    AudioRing ring;
+    ring.init( 4096, 64 );
+
+    std::atomic<bool> stop { false };
+    std::atomic<bool> producerDone { false };
+    quint32 produced = 0;
+
+    std::thread producer( [ & ]() {
+        quint32 sequence = 0;
+        qint64 chunkIndex = 0;
+        quint32 random = 0x12345678;
+        int16_t batch[ 512 * 2 ];
+
+        // Stop well before the sequence numbers wrap around
+        while( !stop.load( std::memory_order_relaxed ) && sequence < 0x7FFFFFFF ) {
+            size_t frames = 1 + xorshift( random ) % 512;
+
+            // Alternate between the per-frame and batch paths
+            if( random & 0x100 ) {
+                for( size_t i = 0; i < frames; i++ ) {
+                    int16_t frame[ 2 ];
+                    encodeFrame( sequence++, frame );
+                    ring.writeFrame( frame[ 0 ], frame[ 1 ] );
+                }
+            } else {
+                for( size_t i = 0; i < frames; i++ ) {
+                    encodeFrame( sequence++, batch + i * 2 );
+                }
+
+                ring.write( batch, frames );
+            }
+
+            // Timestamps double as chunk indices, the consumer checks they arrive in order
+            if( ring.commit( chunkIndex ) ) {
+                chunkIndex++;
+            }
+        }
+
+        // Flush whatever is still pending
+        while( ring.pendingFrames() && !ring.commit( chunkIndex ) ) {
+            std::this_thread::yield();
+        }
+
+        produced = sequence;
+        producerDone.store( true, std::memory_order_release );
+    } );
+
+    quint64 received = 0;
+    quint64 skipped = 0;
+    quint64 chunks = 0;
+    quint64 errors = 0;
+    quint32 expected = 0;
+
+    std::thread consumer( [ & ]() {
+        std::vector<int16_t> buffer( ring.capacity() * 2 );
+        qint64 lastTimeStamp = -1;
+        quint32 random = 0x87654321;
+        AudioRingChunk chunk;
+
+        while( true ) {
+            if( !ring.read( buffer.data(), ring.capacity(), chunk ) ) {
+                if( producerDone.load( std::memory_order_acquire ) && ring.chunksAvailable() == 0 ) {
+                    break;
+                }
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            chunks++;
+
+            if( chunk.timeStamp <= lastTimeStamp ) {
+                errors++;
+            }
+
+            lastTimeStamp = chunk.timeStamp;
+
+            for( size_t i = 0; i < chunk.frames; i++ ) {
+                quint32 sequence = decodeFrame( buffer.data() + i * 2 );
+
+                // Anything behind what we expect is a duplicate, a reordering or a torn frame
+                if( sequence < expected ) {
+                    errors++;
+                    continue;
+                }
+
+                // Anything ahead means frames were dropped, must match the producer's count at the end
+                skipped += sequence - expected;
+                expected = sequence + 1;
+                received++;
+            }
+
+            // Stall now and then so the producer has to deal with a full ring
+            if( ( xorshift( random ) & 0x3FF ) == 0 ) {
+                std::this_thread::sleep_for( std::chrono::microseconds( 500 ) );
+            }
+        }
+    } );
+
+    std::this_thread::sleep_for( std::chrono::seconds( seconds ) );
+    stop.store( true, std::memory_order_relaxed );
+    producer.join();
+    consumer.join();
+
+    // Frames dropped after the last one received
+    skipped += produced - expected;
+
+    quint64 dropped = ring.framesDropped();
+    bool passed = errors == 0 && received + dropped == produced && skipped == dropped;
+
+    out << "AudioRing stress test (" << seconds << "s): " << ( passed ? "PASSED" : "FAILED" ) << endl;
+    out << "  Produced: " << produced << " frames (" << produced / static_cast<qreal>( seconds ) / 1000000.0
+        << "M frames/sec)" << endl;
+    out << "  Received: " << received << " frames in " << chunks << " chunks" << endl;
+    out << "  Dropped: " << dropped << " frames (consumer saw " << skipped << " missing)" << endl;
+    out << "  Out of order, duplicated or torn: " << errors << endl;
+
+    return passed;
+}
+
+void audioCallbackBenchmark( int frames, QTextStream &out ) {
+    // A typical setup: 48kHz at 60fps, flushed every half frame
+    libretroCore.audioSampleRate = 48000;
+    libretroCore.videoFormat.videoFramerate = 60.0;
+    libretroCore.audioFlushFrames = 400;
+    libretroCore.audioRing.init( 24000 );
+    libretroCore.audioSuppressed = false;
+
+    // Drain the ring every flush, like AudioOutput would
+    QVector<int16_t> scratch( static_cast<int>( libretroCore.audioRing.capacity() * 2 ) );
+    QMetaObject::Connection connection = QObject::connect( &libretroCore, &LibretroCore::dataOut,
+    [ & ]( Node::DataType type, QMutex *, void *data, size_t, qint64 ) {
+        if( type != Node::DataType::Audio ) {
+            return;
+        }
+
+        AudioRing *audioRing = static_cast<AudioRing *>( data );
+        AudioRingChunk chunk;
+
+        while( audioRing->read( scratch.data(), audioRing->capacity(), chunk ) ) {
+        }
+    } );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for( int i = 0; i < frames; i++ ) {
+        LibretroCoreAudioSampleCallback( static_cast<int16_t>( i ), static_cast<int16_t>( ~i ) );
+    }
+
+    qint64 sampleNsecs = timer.nsecsElapsed();
+
+    // Same amount of audio through the batch callback, one video frame's worth at a time
+    const int batchFrames = 800;
+    QVector<int16_t> batch( batchFrames * 2 );
+
+    for( int i = 0; i < batch.size(); i++ ) {
+        batch[ i ] = static_cast<int16_t>( i );
+    }
+
+    timer.restart();
+
+    for( int i = 0; i < frames; i += batchFrames ) {
+        LibretroCoreAudioSampleBatchCallback( batch.constData(), static_cast<size_t>( qMin( batchFrames, frames - i ) ) );
+    }
+
+    qint64 batchNsecs = timer.nsecsElapsed();
+
+    QObject::disconnect( connection );
+
+    out << "Audio callback benchmark (" << frames << " frames, including flushes and draining):" << endl;
+    out << "  Per-sample callback: " << static_cast<qreal>( sampleNsecs ) / frames << "ns/frame" << endl;
+    out << "  Batch callback: " << static_cast<qreal>( batchNsecs ) / frames << "ns/frame" << endl;
+    out << "  Dropped: " << libretroCore.audioRing.framesDropped() << " frames" << endl;
+
+    libretroCore.audioRing.free();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+class QTextStream;
+
+/*
+ * Checks and measurements for AudioRing and the audio callbacks built on it, run by phoenix-headless.
+ */
+
+// Hammer an AudioRing from a producer and a consumer thread for the given number of seconds. Every frame carries a
+// sequence number, the consumer verifies that each one arrives exactly once, intact and in order, and that nothing is
+// lost without being counted as dropped. Returns false on failure
+bool audioRingStressTest( int seconds, QTextStream &out );
+
+// Time LibretroCore's per-sample and batch audio callbacks (with a consumer draining the ring as AudioOutput would)
+void audioCallbackBenchmark( int frames, QTextStream &out );
@@ -0,0 +1,80 @@
+#include "framehashes.h"
+#include "hash64.h"
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+quint64 hashVideoFrame( const uchar *data, size_t bytes, const LibretroVideoFormat &format ) {
+    size_t width = static_cast<size_t>( qMax( 0, format.videoSize.width() ) );
+    size_t height = static_cast<size_t>( qMax( 0, format.videoSize.height() ) );
+    size_t lineBytes = width * format.videoBytesPerPixel;
+    size_t pitch = format.videoBytesPerLine;
+    quint64 seed = ( static_cast<quint64>( width ) << 32 ) | height;
+
+    // Never read past what was sent, whatever the format says
+    if( pitch < lineBytes || pitch * height > bytes ) {
+        return hash64( data, bytes, seed );
+    }
+
+    // Line by line even when there's no padding, so the hash doesn't depend on the pitch
+    quint64 hash = seed;
+
+    for( size_t y = 0; y < height; y++ ) {
+        hash = hash64( data + y * pitch, lineBytes, hash );
+    }
+
+    return hash;
+}
+
+bool readFrameHashes( const QString &path, QVector<quint64> &hashes ) {
+    QFile file( path );
+
+    if( !file.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+        return false;
+    }
+
+    hashes.clear();
+    QTextStream in( &file );
+
+    while( !in.atEnd() ) {
+        QString line = in.readLine().trimmed();
+
+        if( line.isEmpty() || line.startsWith( '#' ) ) {
+            continue;
+        }
+
+        bool ok = false;
+        quint64 hash = line.toULongLong( &ok, 16 );
+
+        if( !ok ) {
+            return false;
+        }
+
+        hashes.append( hash );
+    }
+
+    return true;
+}
+
+bool writeFrameHashes( const QString &path, const QVector<quint64> &hashes, const QString &comment ) {
+    QFile file( path );
+
+    if( !file.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) ) {
+        return false;
+    }
+
+    QTextStream out( &file );
+
+    for( const QString &line : comment.split( '\n' ) ) {
+        out << "# " << line << '\n';
+    }
+
+    for( quint64 hash : hashes ) {
+        out << QString::number( hash, 16 ).rightJustified( 16, '0' ) << '\n';
+    }
+
+    out.flush();
+
+    return file.error() == QFile::NoError;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include "pipelinecommon.h"
+
+/*
+ * Frame hashes for phoenix-headless's regression check: a run's video frames are hashed as they arrive and compared
+ * against a golden list from an earlier run (usually with the same input movie) to catch any change in what the core's
+ * output looks like by the time it leaves the pipeline.
+ *
+ * Hash lists are text files with one frame per line, its hash as 16 hex digits. Lines starting with # are comments.
+ */
+
+// Hash of a frame's visible pixels: the width * bytes per pixel at the start of each line, whatever the pitch pads
+// lines out with isn't part of the picture and the same picture hashes the same at any pitch. The frame's size is
+// hashed in too
+quint64 hashVideoFrame( const uchar *data, size_t bytes, const LibretroVideoFormat &format );
+
+// Returns false if the file could not be read or has a line that isn't a hash
+bool readFrameHashes( const QString &path, QVector<quint64> &hashes );
+
+// comment goes at the top, one # line per line of it
+bool writeFrameHashes( const QString &path, const QVector<quint64> &hashes, const QString &comment );
@@ -0,0 +1,370 @@
+#include "headlessbenchmark.h"
+#include "framehashes.h"
+#include "libretrocore.h"
+#include "memoryusage.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <algorithm>
+
+namespace {
+    // Time spent inside LibretroCore's video/audio callbacks, measured by wrapping them
+    QElapsedTimer callbackTimer;
+    qint64 videoCallbackNsecs { 0 };
+    qint64 audioCallbackNsecs { 0 };
+    qint64 videoCallbackCount { 0 };
+    qint64 audioCallbackCount { 0 };
+
+    void timedVideoRefreshCallback( const void *data, unsigned width, unsigned height, size_t pitch ) {
+        qint64 start = callbackTimer.nsecsElapsed();
+        LibretroCoreVideoRefreshCallback( data, width, height, pitch );
+        videoCallbackNsecs += callbackTimer.nsecsElapsed() - start;
+        videoCallbackCount++;
+    }
+
+    void timedAudioSampleCallback( int16_t left, int16_t right ) {
+        qint64 start = callbackTimer.nsecsElapsed();
+        LibretroCoreAudioSampleCallback( left, right );
+        audioCallbackNsecs += callbackTimer.nsecsElapsed() - start;
+        audioCallbackCount++;
+    }
+
+    size_t timedAudioSampleBatchCallback( const int16_t *data, size_t frames ) {
+        qint64 start = callbackTimer.nsecsElapsed();
+        size_t ret = LibretroCoreAudioSampleBatchCallback( data, frames );
+        audioCallbackNsecs += callbackTimer.nsecsElapsed() - start;
+        audioCallbackCount++;
+        return ret;
+    }
+
+    // Value at the given percentile of a sorted list, in milliseconds
+    qreal percentileMsecs( const QVector<qint64> &sorted, qreal percentile ) {
+        if( sorted.isEmpty() ) {
+            return 0.0;
+        }
+
+        int index = qBound( 0, static_cast<int>( percentile / 100.0 * sorted.size() ), sorted.size() - 1 );
+        return sorted[ index ] / 1000000.0;
+    }
+}
+
+HeadlessBenchmark::HeadlessBenchmark( Node *parent ) : Node( parent ) {
+}
+
+bool HeadlessBenchmark::run( QVariantMap source, int frames ) {
+    this->source = source;
+
+    frameNsecs.clear();
+    frameNsecs.reserve( frames );
+    totalNsecs = 0;
+    videoFramesReceived = 0;
+    audioBytesReceived = 0;
+    perfCounters.clear();
+    videoCallbackNsecs = 0;
+    audioCallbackNsecs = 0;
+    videoCallbackCount = 0;
+    audioCallbackCount = 0;
+    libretroCore.videoFramesZeroCopy = 0;
+    libretroCore.videoFramesCopied = 0;
+    hashes.clear();
+    hashes.reserve( frames );
+    divergingFrame = -1;
+    hashNsecs = 0;
+
+    // All connections are direct so each of these returns once the whole pipeline has handled the command
+    emit commandOut( Command::SetSource, source, nodeCurrentTime() );
+    emit commandOut( Command::Load, QVariant(), nodeCurrentTime() );
+
+    if( !libretroCore.coreFile.isLoaded() ) {
+        QTextStream( stderr ) << "Could not load core " << source[ "core" ].toString() << ": "
+                              << libretroCore.coreFile.errorString() << endl;
+        return false;
+    }
+
+    if( !libretroCore.gameLoaded ) {
+        QTextStream( stderr ) << "Could not load game " << source[ "game" ].toString() << endl;
+        emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+        return false;
+    }
+
+    coreFPS = libretroCore.videoFormat.videoFramerate;
+
+    // Swap in timed wrappers around LibretroCore's callbacks
+    libretroCore.symbols.retro_set_video_refresh( timedVideoRefreshCallback );
+    libretroCore.symbols.retro_set_audio_sample( timedAudioSampleCallback );
+    libretroCore.symbols.retro_set_audio_sample_batch( timedAudioSampleBatchCallback );
+
+    // Replay first so that re-recording a movie starts from the state it starts from
+    if( !moviePlayPath.isEmpty() ) {
+        emit commandOut( Command::PlayMovie, moviePlayPath, nodeCurrentTime() );
+    }
+
+    if( !movieRecordPath.isEmpty() ) {
+        emit commandOut( Command::RecordMovie, movieRecordPath, nodeCurrentTime() );
+    }
+
+    emit commandOut( Command::Play, QVariant(), nodeCurrentTime() );
+
+    callbackTimer.start();
+    QElapsedTimer frameTimer;
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+
+    // No point going on once the output has diverged
+    for( int i = 0; i < frames && divergingFrame < 0; i++ ) {
+        frameTimer.start();
+        emit commandOut( Command::Heartbeat, QVariant(), nodeCurrentTime() );
+        frameNsecs.append( frameTimer.nsecsElapsed() );
+    }
+
+    totalNsecs = totalTimer.nsecsElapsed();
+
+    // Fewer or more frames than the golden list has is a divergence too
+    if( hashingFrames && !goldenHashes.isEmpty() && divergingFrame < 0 && hashes.size() != goldenHashes.size() ) {
+        divergingFrame = qMin( hashes.size(), goldenHashes.size() );
+    }
+
+    emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+
+    return true;
+}
+
+void HeadlessBenchmark::report() {
+    QTextStream out( stdout );
+
+    QVector<qint64> sorted = frameNsecs;
+    std::sort( sorted.begin(), sorted.end() );
+
+    qreal seconds = totalNsecs / 1000000000.0;
+    qreal framesPerSecond = seconds > 0.0 ? frameNsecs.size() / seconds : 0.0;
+
+    out << "Core: " << source[ "core" ].toString() << endl;
+    out << "Game: " << source[ "game" ].toString() << endl;
+    out << endl;
+
+    out << "Frames: " << frameNsecs.size() << " in " << seconds << "s" << endl;
+    out << "Frames/sec: " << framesPerSecond;
+
+    if( coreFPS > 0.0 ) {
+        out << " (" << framesPerSecond / coreFPS << "x the core's native " << coreFPS << " fps)";
+    }
+
+    out << endl << endl;
+
+    out << "Frame time (ms):" << endl;
+    out << "  min: " << percentileMsecs( sorted, 0.0 ) << endl;
+    out << "  p50: " << percentileMsecs( sorted, 50.0 ) << endl;
+    out << "  p90: " << percentileMsecs( sorted, 90.0 ) << endl;
+    out << "  p99: " << percentileMsecs( sorted, 99.0 ) << endl;
+    out << "  max: " << percentileMsecs( sorted, 100.0 ) << endl;
+    out << endl;
+
+    qreal totalMsecs = totalNsecs / 1000000.0;
+    qreal videoMsecs = videoCallbackNsecs / 1000000.0;
+    qreal audioMsecs = audioCallbackNsecs / 1000000.0;
+
+    out << "Video callback: " << videoCallbackCount << " calls, " << videoMsecs << "ms total ("
+        << ( totalMsecs > 0.0 ? videoMsecs / totalMsecs * 100.0 : 0.0 ) << "% of run time)" << endl;
+    out << "Audio callbacks: " << audioCallbackCount << " calls, " << audioMsecs << "ms total ("
+        << ( totalMsecs > 0.0 ? audioMsecs / totalMsecs * 100.0 : 0.0 ) << "% of run time)" << endl;
+    out << "Software video frames: " << libretroCore.videoFramesZeroCopy << " rendered in place, "
+        << libretroCore.videoFramesCopied << " copied" << endl;
+    out << "Sink received: " << videoFramesReceived << " video frames, " << audioBytesReceived / 1024.0
+        << " KB of audio (" << libretroCore.audioRing.framesDropped() << " audio frames dropped)" << endl;
+
+    if( hashingFrames ) {
+        qreal hashMsecs = hashNsecs / 1000000.0;
+        out << "Frame hashing: " << hashes.size() << " frames, " << hashMsecs << "ms total ("
+            << ( totalMsecs > 0.0 ? hashMsecs / totalMsecs * 100.0 : 0.0 ) << "% of run time)" << endl;
+    }
+
+    out << endl;
+
+    out << "Peak RSS: " << peakResidentSetSize() / ( 1024.0 * 1024.0 ) << " MB" << endl;
+
+    if( !perfCounters.isEmpty() ) {
+        out << endl << "Core performance counters (count, total ms, p50 us, p99 us):" << endl;
+
+        for( const QVariant &variant : perfCounters ) {
+            QVariantMap counter = variant.toMap();
+            out << "  " << counter[ "name" ].toString() << ": " << counter[ "count" ].toLongLong() << ", "
+                << counter[ "totalMsecs" ].toReal() << ", " << counter[ "p50Usecs" ].toReal() << ", "
+                << counter[ "p99Usecs" ].toReal() << endl;
+        }
+    }
+}
+
+void HeadlessBenchmark::setMovies( QString playPath, QString recordPath ) {
+    moviePlayPath = playPath;
+    movieRecordPath = recordPath;
+}
+
+void HeadlessBenchmark::setFrameHashing( bool enabled, QVector<quint64> golden ) {
+    hashingFrames = enabled;
+    goldenHashes = golden;
+}
+
+QVector<quint64> HeadlessBenchmark::frameHashes() const {
+    return hashes;
+}
+
+int HeadlessBenchmark::firstDivergingFrame() const {
+    return divergingFrame;
+}
+
+bool HeadlessBenchmark::runLoadCycles( QVariantMap source, int cycles ) {
+    this->source = source;
+
+    coldLoadNsecs.clear();
+    warmLoadNsecs.clear();
+    coldStopNsecs.clear();
+    warmStopNsecs.clear();
+
+    emit commandOut( Command::SetSource, source, nodeCurrentTime() );
+
+    // Cold: the library is loaded and retro_init() called every time
+    emit commandOut( Command::SetKeepCoreLoaded, false, nodeCurrentTime() );
+
+    for( int i = 0; i < cycles; i++ ) {
+        if( !loadCycle( coldLoadNsecs, coldStopNsecs ) ) {
+            return false;
+        }
+    }
+
+    // Warm: one cold load to get the core loaded in the first place, not counted
+    emit commandOut( Command::SetKeepCoreLoaded, true, nodeCurrentTime() );
+    QVector<qint64> primingNsecs;
+
+    if( !loadCycle( primingNsecs, primingNsecs ) ) {
+        return false;
+    }
+
+    for( int i = 0; i < cycles; i++ ) {
+        if( !loadCycle( warmLoadNsecs, warmStopNsecs ) ) {
+            return false;
+        }
+    }
+
+    // Unloads the core that was kept loaded
+    emit commandOut( Command::SetKeepCoreLoaded, false, nodeCurrentTime() );
+
+    return true;
+}
+
+void HeadlessBenchmark::reportLoadCycles() {
+    QTextStream out( stdout );
+
+    out << "Core: " << source[ "core" ].toString() << endl;
+    out << "Game: " << source[ "game" ].toString() << endl;
+    out << endl;
+
+    // Prints min/p50/max, returns p50
+    auto printTimes = [ &out ]( const char *name, QVector<qint64> nsecs ) {
+        std::sort( nsecs.begin(), nsecs.end() );
+        out << name << " (ms, " << nsecs.size() << " runs): min " << percentileMsecs( nsecs, 0.0 ) << ", p50 "
+            << percentileMsecs( nsecs, 50.0 ) << ", max " << percentileMsecs( nsecs, 100.0 ) << endl;
+        return percentileMsecs( nsecs, 50.0 );
+    };
+
+    qreal coldMsecs = printTimes( "Cold load", coldLoadNsecs );
+    qreal warmMsecs = printTimes( "Warm load", warmLoadNsecs );
+    printTimes( "Cold stop", coldStopNsecs );
+    printTimes( "Warm stop", warmStopNsecs );
+    out << endl;
+
+    if( warmMsecs > 0.0 ) {
+        out << "Warm loads are " << coldMsecs / warmMsecs << "x as fast (p50)" << endl;
+    }
+}
+
+void HeadlessBenchmark::commandIn( Command command, QVariant data, qint64 timeStamp ) {
+    Q_UNUSED( timeStamp );
+
+    // The last of these arrives on Stop and covers the whole run
+    if( command == Command::SetPerfCounters ) {
+        perfCounters = data.toList();
+    }
+
+    if( command == Command::SetLibretroVideoFormat ) {
+        videoFormat = data.value<LibretroVideoFormat>();
+    }
+}
+
+void HeadlessBenchmark::dataIn( DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp ) {
+    Q_UNUSED( timeStamp );
+
+    switch( type ) {
+        case DataType::Video: {
+            videoFramesReceived++;
+
+            if( !hashingFrames ) {
+                break;
+            }
+
+            qint64 start = callbackTimer.nsecsElapsed();
+            mutex->lock();
+            quint64 hash = hashVideoFrame( *static_cast<uchar **>( data ), bytes, videoFormat );
+            mutex->unlock();
+            hashNsecs += callbackTimer.nsecsElapsed() - start;
+
+            int frame = hashes.size();
+            hashes.append( hash );
+
+            if( divergingFrame < 0 && !goldenHashes.isEmpty() &&
+                ( frame >= goldenHashes.size() || goldenHashes[ frame ] != hash ) ) {
+                divergingFrame = frame;
+            }
+
+            break;
+        }
+
+        case DataType::Audio: {
+            AudioRing *audioRing = static_cast<AudioRing *>( data );
+            AudioRingChunk chunk;
+
+            if( audioScratch.size() < static_cast<int>( audioRing->capacity() * 2 ) ) {
+                audioScratch.resize( static_cast<int>( audioRing->capacity() * 2 ) );
+            }
+
+            while( audioRing->read( audioScratch.data(), audioRing->capacity(), chunk ) ) {
+                audioBytesReceived += chunk.frames * 4;
+            }
+
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+// Private
+
+bool HeadlessBenchmark::loadCycle( QVector<qint64> &loadNsecs, QVector<qint64> &stopNsecs ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    emit commandOut( Command::Load, QVariant(), nodeCurrentTime() );
+    loadNsecs.append( timer.nsecsElapsed() );
+
+    if( !libretroCore.coreFile.isLoaded() ) {
+        QTextStream( stderr ) << "Could not load core " << source[ "core" ].toString() << ": "
+                              << libretroCore.coreFile.errorString() << endl;
+        return false;
+    }
+
+    // A load that failed would otherwise be timed as a fast one
+    if( !libretroCore.gameLoaded ) {
+        QTextStream( stderr ) << "Could not load game " << source[ "game" ].toString() << endl;
+        emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+        return false;
+    }
+
+    timer.start();
+    emit commandOut( Command::Stop, QVariant(), nodeCurrentTime() );
+    stopNsecs.append( timer.nsecsElapsed() );
+
+    return true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QObject>
+#include <QVariantMap>
+#include <QVector>
+
+#include "node.h"
+
+/*
+ * HeadlessBenchmark drives a LibretroLoader -> LibretroRunner pipeline without a window, QML or audio device so
+ * emulation throughput can be measured on machines with neither a GPU nor a sound card.
+ *
+ * It's both the pipeline's heartbeat source (unthrottled: the next heartbeat goes out as soon as the previous frame is
+ * done) and its null video/audio sink. Connect it as the loader's parent and as the runner's child, then call run().
+ *
+ * Software-rendered cores only, no OpenGL context is made available to the core.
+ */
+
+class HeadlessBenchmark : public Node {
+        Q_OBJECT
+
+    public:
+        explicit HeadlessBenchmark( Node *parent = nullptr );
+
+        // Load the given source, emulate the given number of frames as fast as possible then unload
+        // Returns false if the core or the game could not be loaded
+        bool run( QVariantMap source, int frames );
+
+        // Print the results of the last run() to stdout
+        void report();
+
+        // Have run() replay the movie at playPath in place of input and/or record one to recordPath (see
+        // LibretroMoviePlayer, LibretroMovieRecorder). An empty path leaves either off
+        void setMovies( QString playPath, QString recordPath );
+
+        // Have run() hash every video frame (see framehashes.h). If golden isn't empty, each hash is checked against it
+        // as it comes in and the run stops at the first frame that differs
+        void setFrameHashing( bool enabled, QVector<quint64> golden = QVector<quint64>() );
+
+        // Hashes of the video frames of the last run(), in order
+        QVector<quint64> frameHashes() const;
+
+        // Index of the first video frame of the last run() that didn't match the golden list (including a frame that
+        // should have been there but wasn't, or shouldn't have but was), -1 if they all did
+        int firstDivergingFrame() const;
+
+        // Load and stop the given source the given number of times with the core unloaded in between (cold), then as many
+        // times with it kept loaded (warm, see LibretroCore::keepCoreLoaded). No frames are emulated
+        // Returns false if the core or the game could not be loaded
+        bool runLoadCycles( QVariantMap source, int cycles );
+
+        // Print the results of the last runLoadCycles() to stdout
+        void reportLoadCycles();
+
+    public slots:
+        // Null sink, nothing is relayed
+        void commandIn( Command command, QVariant data, qint64 timeStamp ) override;
+        void dataIn( DataType type, QMutex *mutex, void *data, size_t bytes, qint64 timeStamp ) override;
+
+    private:
+        QVariantMap source;
+
+        QString moviePlayPath;
+        QString movieRecordPath;
+
+        // Time taken by each heartbeat (one retro_run() plus the pipeline work around it)
+        QVector<qint64> frameNsecs;
+        qint64 totalNsecs { 0 };
+
+        // Time taken by each Load and Stop in runLoadCycles()
+        QVector<qint64> coldLoadNsecs;
+        QVector<qint64> warmLoadNsecs;
+        QVector<qint64> coldStopNsecs;
+        QVector<qint64> warmStopNsecs;
+
+        // Load then Stop, appending how long each took. Returns false if the core or the game could not be loaded
+        bool loadCycle( QVector<qint64> &loadNsecs, QVector<qint64> &stopNsecs );
+
+        // The core's native framerate
+        qreal coreFPS { 0.0 };
+
+        // What reached the sink
+        int videoFramesReceived { 0 };
+
+        // Frame hashing
+
+        bool hashingFrames { false };
+        QVector<quint64> hashes;
+        QVector<quint64> goldenHashes;
+        int divergingFrame { -1 };
+        qint64 hashNsecs { 0 };
+
+        // Format of the frames coming in, for hashing only the visible part of them
+        LibretroVideoFormat videoFormat;
+        qint64 audioBytesReceived { 0 };
+
+        // The core's performance counters as of Stop, see Node::Command::SetPerfCounters
+        QVariantList perfCounters;
+
+        // Audio is drained from the core's AudioRing into here, like AudioOutput would
+        QVector<int16_t> audioScratch;
+};
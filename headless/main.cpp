@@ -0,0 +1,267 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QStringBuilder>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <limits.h>
+
+#include "audioringtest.h"
+#include "framehashes.h"
+#include "headlessbenchmark.h"
+#include "libretroloader.h"
+#include "libretromovie.h"
+#include "libretromovieplayer.h"
+#include "libretromovierecorder.h"
+#include "libretrorunner.h"
+#include "logging.h"
+#include "memorysearchbenchmark.h"
+#include "pixelconvertbenchmark.h"
+#include "rewindbenchmark.h"
+#include "stdiocapture.h"
+
+/*
+ * phoenix-headless: Runs a Libretro core without a window, QML or audio device and reports how fast it went
+ *
+ * Usage: phoenix-headless [options] <core> <game>
+ *        phoenix-headless --load-cycles <count> [options] <core> <game>
+ *        phoenix-headless --play-movie <file> [--record-movie <file>] [options] <core> <game>
+ *        phoenix-headless --play-movie <file> --check-frame-hashes <file> [options] <core> <game>
+ *        phoenix-headless --audio-ring-stress <seconds>
+ *        phoenix-headless --audio-callback-bench <frames>
+ *        phoenix-headless --memory-search-bench <megabytes>
+ *        phoenix-headless --pixel-convert-bench <frames>
+ *        phoenix-headless --rewind-bench <frames>
+ */
+
+int main( int argc, char *argv[] ) {
+    QCoreApplication app( argc, argv );
+    QCoreApplication::setApplicationName( "phoenix-headless" );
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription( "Emulates a game as fast as possible without a window, QML or audio device then "
+                                      "reports frames/sec, the frame time distribution and time spent in the video/audio callbacks." );
+    parser.addHelpOption();
+    parser.addPositionalArgument( "core", "Path to the Libretro core." );
+    parser.addPositionalArgument( "game", "Path to a game the core accepts." );
+
+    QCommandLineOption framesOption( QStringList() << "f" << "frames", "Number of frames to emulate (default: 3600).",
+                                     "frames", "3600" );
+    QCommandLineOption systemOption( QStringList() << "s" << "system", "System directory (default: the game's directory).",
+                                     "path" );
+    QCommandLineOption loadCyclesOption( "load-cycles", "Load and stop the game the given number of times with the core "
+                                         "unloaded in between, then with it kept loaded, and compare load times instead "
+                                         "of emulating frames.", "count" );
+    QCommandLineOption playMovieOption( "play-movie", "Replay the input recorded in the given movie file. Emulates as many "
+                                        "frames as the movie has unless --frames is given.", "file" );
+    QCommandLineOption recordMovieOption( "record-movie", "Record the input into the given movie file.", "file" );
+    QCommandLineOption writeFrameHashesOption( "write-frame-hashes", "Write the hash of every video frame to the given "
+                                               "file, to check later runs against.", "file" );
+    QCommandLineOption checkFrameHashesOption( "check-frame-hashes", "Check the hash of every video frame against the "
+                                               "given file and fail at the first one that differs. Emulates as many "
+                                               "frames as the file has unless --frames or --play-movie is given.", "file" );
+    QCommandLineOption verboseOption( QStringList() << "v" << "verbose", "Show debug output from the core and pipeline." );
+    QCommandLineOption audioRingStressOption( "audio-ring-stress", "Stress test AudioRing for the given number of seconds "
+                                              "instead of running a core.", "seconds" );
+    QCommandLineOption audioCallbackBenchOption( "audio-callback-bench", "Benchmark the audio callbacks with the given "
+                                                 "number of frames instead of running a core.", "frames" );
+    QCommandLineOption memorySearchBenchOption( "memory-search-bench", "Benchmark and check the memory search over the "
+                                                "given number of megabytes instead of running a core.", "megabytes" );
+    QCommandLineOption pixelConvertBenchOption( "pixel-convert-bench", "Benchmark and check the pixel converters with "
+                                                "the given number of frames instead of running a core.", "frames" );
+    QCommandLineOption rewindBenchOption( "rewind-bench", "Benchmark and check rewind history with the given number of "
+                                          "snapshots instead of running a core.", "frames" );
+    parser.addOption( framesOption );
+    parser.addOption( systemOption );
+    parser.addOption( loadCyclesOption );
+    parser.addOption( playMovieOption );
+    parser.addOption( recordMovieOption );
+    parser.addOption( writeFrameHashesOption );
+    parser.addOption( checkFrameHashesOption );
+    parser.addOption( verboseOption );
+    parser.addOption( audioRingStressOption );
+    parser.addOption( audioCallbackBenchOption );
+    parser.addOption( memorySearchBenchOption );
+    parser.addOption( pixelConvertBenchOption );
+    parser.addOption( rewindBenchOption );
+
+    parser.process( app );
+
+    // Self-contained checks and benchmarks that don't need a core
+    if( parser.isSet( audioRingStressOption ) || parser.isSet( audioCallbackBenchOption ) ||
+        parser.isSet( memorySearchBenchOption ) || parser.isSet( pixelConvertBenchOption ) ||
+        parser.isSet( rewindBenchOption ) ) {
+        QTextStream out( stdout );
+        bool passed = true;
+
+        if( parser.isSet( audioRingStressOption ) ) {
+            passed = audioRingStressTest( qMax( 1, parser.value( audioRingStressOption ).toInt() ), out );
+        }
+
+        if( parser.isSet( audioCallbackBenchOption ) ) {
+            audioCallbackBenchmark( qMax( 1, parser.value( audioCallbackBenchOption ).toInt() ), out );
+        }
+
+        if( parser.isSet( memorySearchBenchOption ) ) {
+            passed &= memorySearchBenchmark( qMax( 1, parser.value( memorySearchBenchOption ).toInt() ), out );
+        }
+
+        if( parser.isSet( pixelConvertBenchOption ) ) {
+            passed &= pixelConvertBenchmark( qMax( 1, parser.value( pixelConvertBenchOption ).toInt() ), out );
+        }
+
+        if( parser.isSet( rewindBenchOption ) ) {
+            passed &= rewindBenchmark( qMax( 2, parser.value( rewindBenchOption ).toInt() ), out );
+        }
+
+        return passed ? 0 : 1;
+    }
+
+    QStringList args = parser.positionalArguments();
+
+    if( args.size() != 2 ) {
+        parser.showHelp( 1 );
+    }
+
+    bool ok = false;
+    int frames = parser.value( framesOption ).toInt( &ok );
+
+    if( !ok || frames <= 0 ) {
+        QTextStream( stderr ) << "Invalid frame count: " << parser.value( framesOption ) << endl;
+        return 1;
+    }
+
+    QVector<quint64> goldenFrameHashes;
+
+    if( parser.isSet( checkFrameHashesOption ) ) {
+        if( !readFrameHashes( parser.value( checkFrameHashesOption ), goldenFrameHashes ) || goldenFrameHashes.isEmpty() ) {
+            QTextStream( stderr ) << "Could not read frame hashes from " << parser.value( checkFrameHashesOption ) << endl;
+            return 1;
+        }
+
+        if( !parser.isSet( framesOption ) ) {
+            frames = goldenFrameHashes.size();
+        }
+    }
+
+    // Run the whole movie by default
+    if( parser.isSet( playMovieOption ) && !parser.isSet( framesOption ) ) {
+        QFile movie( parser.value( playMovieOption ) );
+        LibretroMovieHeader header;
+
+        if( !movie.open( QIODevice::ReadOnly ) || !LibretroMovieReadHeader( &movie, header ) ) {
+            QTextStream( stderr ) << "Could not read movie " << movie.fileName() << endl;
+            return 1;
+        }
+
+        if( header.frameCount ) {
+            frames = static_cast<int>( qMin<quint64>( header.frameCount, INT_MAX ) );
+        }
+    }
+
+    if( !parser.isSet( verboseOption ) ) {
+        QLoggingCategory::setFilterRules( QStringLiteral( "*.debug=false" ) );
+    }
+
+    // Like the backend, so logging costs the same as it would there
+    startAsyncLogging();
+    startStdioCapture();
+
+    // SRAM gets written on unload, keep it away from any real saves
+    QTemporaryDir saveDir;
+
+    QFileInfo gameInfo( args[ 1 ] );
+
+    QVariantMap source;
+    source[ "type" ] = "libretro";
+    source[ "core" ] = QFileInfo( args[ 0 ] ).absoluteFilePath();
+    source[ "game" ] = gameInfo.absoluteFilePath();
+
+    // LibretroLoader takes the directory part of these paths, hence the trailing slashes
+    source[ "systemPath" ] = ( parser.isSet( systemOption ) ? QFileInfo( parser.value( systemOption ) ).absoluteFilePath()
+                               : gameInfo.absolutePath() ) + "/";
+    source[ "savePath" ] = saveDir.path() + "/";
+
+    // Pipeline: HeadlessBenchmark -> LibretroLoader -> LibretroRunner -> HeadlessBenchmark, LibretroMoviePlayer,
+    // LibretroMovieRecorder
+    HeadlessBenchmark benchmark;
+    LibretroLoader libretroLoader;
+    LibretroRunner libretroRunner;
+    LibretroMoviePlayer moviePlayer;
+    LibretroMovieRecorder movieRecorder;
+
+    connectNodes( &benchmark, &libretroLoader );
+    connectNodes( &libretroLoader, &libretroRunner );
+    connectNodes( &libretroRunner, &benchmark );
+    connectNodes( &libretroRunner, &moviePlayer );
+    connectNodes( &libretroRunner, &movieRecorder );
+
+    if( parser.isSet( loadCyclesOption ) ) {
+        if( !benchmark.runLoadCycles( source, qMax( 1, parser.value( loadCyclesOption ).toInt() ) ) ) {
+            return 1;
+        }
+
+        benchmark.reportLoadCycles();
+
+        return 0;
+    }
+
+    benchmark.setMovies( parser.value( playMovieOption ), parser.value( recordMovieOption ) );
+    benchmark.setFrameHashing( parser.isSet( writeFrameHashesOption ) || parser.isSet( checkFrameHashesOption ),
+                               goldenFrameHashes );
+
+    if( !benchmark.run( source, frames ) ) {
+        return 1;
+    }
+
+    if( parser.isSet( writeFrameHashesOption ) ) {
+        QString comment = QStringLiteral( "Core: " ) % QFileInfo( args[ 0 ] ).fileName() % QStringLiteral( "\nGame: " ) %
+                          gameInfo.fileName();
+
+        if( parser.isSet( playMovieOption ) ) {
+            comment += QStringLiteral( "\nMovie: " ) % QFileInfo( parser.value( playMovieOption ) ).fileName();
+        }
+
+        if( !writeFrameHashes( parser.value( writeFrameHashesOption ), benchmark.frameHashes(), comment ) ) {
+            QTextStream( stderr ) << "Could not write frame hashes to " << parser.value( writeFrameHashesOption ) << endl;
+            return 1;
+        }
+    }
+
+    benchmark.report();
+
+    if( parser.isSet( checkFrameHashesOption ) ) {
+        QTextStream out( stdout );
+        int frame = benchmark.firstDivergingFrame();
+        QVector<quint64> hashes = benchmark.frameHashes();
+
+        if( frame >= 0 ) {
+            out << endl << "FAIL: frame " << frame << " differs (expected ";
+
+            if( frame < goldenFrameHashes.size() ) {
+                out << hex << goldenFrameHashes[ frame ] << dec;
+            } else {
+                out << "no frame";
+            }
+
+            out << ", got ";
+
+            if( frame < hashes.size() ) {
+                out << hex << hashes[ frame ] << dec;
+            } else {
+                out << "no frame";
+            }
+
+            out << ")" << endl;
+
+            return 1;
+        }
+
+        out << endl << "PASS: all " << hashes.size() << " frames match" << endl;
+    }
+
+    return 0;
+}
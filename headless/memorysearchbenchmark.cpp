@@ -0,0 +1,123 @@
+#include "memorysearchbenchmark.h"
+#include "libretromemorysearch.h"
+
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+    typedef LibretroMemorySearch::Comparison Comparison;
+
+    inline quint32 xorshift( quint32 &state ) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    bool referenceMatch( Comparison comparison, quint8 current, quint8 previous, quint8 value ) {
+        switch( comparison ) {
+            case Comparison::Changed:
+                return current != previous;
+
+            case Comparison::Unchanged:
+                return current == previous;
+
+            case Comparison::Increased:
+                return current > previous;
+
+            case Comparison::Decreased:
+                return current < previous;
+
+            case Comparison::Equal:
+                return current == value;
+
+            case Comparison::NotEqual:
+                return current != value;
+
+            case Comparison::Greater:
+                return current > value;
+
+            case Comparison::Less:
+                return current < value;
+        }
+
+        return false;
+    }
+}
+
+bool memorySearchBenchmark( int megabytes, QTextStream &out ) {
+    static const struct {
+        Comparison comparison;
+        const char *name;
+    } comparisons[] = {
+        { Comparison::Changed, "changed" },
+        { Comparison::Unchanged, "unchanged" },
+        { Comparison::Increased, "increased" },
+        { Comparison::Decreased, "decreased" },
+        { Comparison::Equal, "equal" },
+        { Comparison::NotEqual, "notequal" },
+        { Comparison::Greater, "greater" },
+        { Comparison::Less, "less" },
+    };
+
+    // Odd size so the tail handling gets exercised too
+    int size = megabytes * 1024 * 1024 + 7;
+    QVector<quint8> memory( size );
+    quint32 random = 0x12345678;
+
+    for( quint8 &byte : memory ) {
+        byte = static_cast<quint8>( xorshift( random ) );
+    }
+
+    out << "Memory search benchmark (" << megabytes << " MB):" << endl;
+
+    bool passed = true;
+
+    for( const auto &entry : comparisons ) {
+        // Fresh search every time so each comparison sees every byte as a candidate
+        LibretroMemorySearch search;
+        search.reset( QVector<LibretroMemoryRegion>() << LibretroMemoryRegion { memory.data(), static_cast<size_t>( size ), 0 } );
+
+        // Change roughly one byte in eight, like a game would between two searches
+        // Detach the copy rather than memory, the search holds a pointer to memory's buffer
+        QVector<quint8> previous = memory;
+        previous.detach();
+
+        for( int i = 0; i < size; i += 1 + xorshift( random ) % 15 ) {
+            memory[ i ] = static_cast<quint8>( xorshift( random ) );
+        }
+
+        quint8 value = static_cast<quint8>( xorshift( random ) );
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 count = search.search( entry.comparison, value );
+        qint64 nsecs = timer.nsecsElapsed();
+
+        // Check against the simple version
+        qint64 expected = 0;
+
+        for( int i = 0; i < size; i++ ) {
+            expected += referenceMatch( entry.comparison, memory[ i ], previous[ i ], value );
+        }
+
+        QVector<LibretroMemoryMatch> matches = search.matches( 1000 );
+        bool correct = count == expected;
+
+        for( const LibretroMemoryMatch &match : matches ) {
+            correct &= referenceMatch( entry.comparison, memory[ static_cast<int>( match.address ) ],
+                                       previous[ static_cast<int>( match.address ) ], value );
+            correct &= match.value == memory[ static_cast<int>( match.address ) ];
+        }
+
+        passed &= correct;
+
+        out << "  " << entry.name << ": " << nsecs / 1000000.0 << "ms (" << size / ( nsecs / 1000000000.0 ) / ( 1024.0 * 1024.0 * 1024.0 )
+            << " GB/s), " << count << " candidates left" << ( correct ? "" : " MISMATCH" ) << endl;
+    }
+
+    out << ( passed ? "PASSED" : "FAILED" ) << endl;
+
+    return passed;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+class QTextStream;
+
+/*
+ * Measurements for LibretroMemorySearch, run by phoenix-headless.
+ */
+
+// Run every comparison over the given number of megabytes of simulated RAM (a fraction of which changes between
+// searches), timing each one and checking its results against a plain byte-by-byte implementation. Returns false if
+// any result differs
+bool memorySearchBenchmark( int megabytes, QTextStream &out );
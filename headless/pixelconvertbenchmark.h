@@ -0,0 +1,12 @@
+#pragma once
+
+class QTextStream;
+
+/*
+ * Measurements for the pixel converters in pixelconvert.h, run by phoenix-headless.
+ */
+
+// Convert a padded 640x480 frame the given number of times from each source format with each kernel available here,
+// timing each one and checking its output against the scalar kernel's. The time QImage takes to do the same conversion
+// is shown for comparison. Returns false if any kernel's output differs
+bool pixelConvertBenchmark( int frames, QTextStream &out );
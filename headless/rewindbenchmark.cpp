@@ -0,0 +1,97 @@
+#include "rewindbenchmark.h"
+#include "libretrorewind.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QTextStream>
+#include <QVector>
+
+#include <string.h>
+
+namespace {
+    inline quint32 xorshift( quint32 &state ) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
+
+bool rewindBenchmark( int frames, QTextStream &out ) {
+    // About what a 16-bit console's state takes, odd so the codec's tail handling gets exercised too
+    const int stateSize = 256 * 1024 + 5;
+    QVector<quint8> state( stateSize );
+    quint32 random = 0x12345678;
+
+    for( quint8 &byte : state ) {
+        byte = static_cast<quint8>( xorshift( random ) );
+    }
+
+    LibretroRewind rewind;
+    rewind.init( stateSize );
+
+    out << "Rewind benchmark (" << frames << " snapshots of " << stateSize / 1024.0 << " KB):" << endl;
+    out << "  Allocated after init(): " << rewind.bytesAllocated() / 1024.0 << " KB" << endl;
+
+    // The hash of every state pushed, to check what pop() restores against
+    QVector<uint> hashes( frames );
+    qint64 pushNsecs = 0;
+    qint64 pushMaxNsecs = 0;
+
+    for( int frame = 0; frame < frames; frame++ ) {
+        // Change a few short runs of bytes, like a game would between two frames
+        for( int run = 0; run < 32; run++ ) {
+            int start = static_cast<int>( xorshift( random ) % stateSize );
+            int length = qMin( 1 + static_cast<int>( xorshift( random ) % 64 ), stateSize - start );
+
+            for( int i = start; i < start + length; i++ ) {
+                state[ i ] = static_cast<quint8>( xorshift( random ) );
+            }
+        }
+
+        hashes[ frame ] = qHashBits( state.constData(), stateSize );
+
+        QElapsedTimer timer;
+        timer.start();
+        memcpy( rewind.scratch(), state.constData(), stateSize );
+        rewind.push();
+        qint64 nsecs = timer.nsecsElapsed();
+
+        pushNsecs += nsecs;
+        pushMaxNsecs = qMax( pushMaxNsecs, nsecs );
+    }
+
+    int count = rewind.count();
+
+    out << "  push: " << pushNsecs / frames / 1000.0 << "us avg, " << pushMaxNsecs / 1000.0 << "us max" << endl;
+    out << "  History: " << count << " snapshots in " << rewind.bytesUsed() / ( 1024.0 * 1024.0 ) << " MB ("
+        << ( count ? rewind.bytesUsed() / count : 0 ) << " bytes each), "
+        << rewind.bytesAllocated() / ( 1024.0 * 1024.0 ) << " MB allocated" << endl;
+
+    bool correct = true;
+    qint64 popNsecs = 0;
+
+    // Snapshots older than the budget allows were dropped, the newest count are left before the last one
+    for( int i = 0; i < count; i++ ) {
+        QElapsedTimer timer;
+        timer.start();
+        const void *restored = rewind.pop();
+        popNsecs += timer.nsecsElapsed();
+
+        if( !restored || qHashBits( restored, stateSize ) != hashes[ frames - 2 - i ] ) {
+            out << "  Snapshot " << frames - 2 - i << " MISMATCH" << endl;
+            correct = false;
+            break;
+        }
+    }
+
+    correct &= rewind.pop() == nullptr;
+
+    if( count ) {
+        out << "  pop: " << popNsecs / count / 1000.0 << "us avg" << endl;
+    }
+
+    out << ( correct ? "PASSED" : "FAILED" ) << endl;
+
+    return correct;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+class QTextStream;
+
+/*
+ * Measurements for LibretroRewind, run by phoenix-headless.
+ */
+
+// Push the given number of snapshots of a simulated core state (a small fraction of which changes from one to the next)
+// into a rewind history, then step back through all of it, timing both and checking every restored state against the
+// original. Returns false if any restored state differs
+bool rewindBenchmark( int frames, QTextStream &out );
@@ -0,0 +1,217 @@
+#include "audioring.h"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+    size_t nextPowerOfTwo( size_t value ) {
+        size_t result = 1;
+
+        while( result < value ) {
+            result <<= 1;
+        }
+
+        return result;
+    }
+
+    // Keeps the buffers that follow the shared positions in attached memory cache line aligned
+    size_t roundUpToCacheLine( size_t value ) {
+        return ( value + AUDIORING_CACHE_LINE - 1 ) & ~static_cast<size_t>( AUDIORING_CACHE_LINE - 1 );
+    }
+}
+
+AudioRing::~AudioRing() {
+    free();
+}
+
+void AudioRing::init( size_t minFrames, size_t maxChunks ) {
+    free();
+
+    if( minFrames == 0 || maxChunks == 0 ) {
+        return;
+    }
+
+    // Power of two sizes so positions can wrap with a mask
+    frameCapacity = nextPowerOfTwo( minFrames );
+    frameMask = frameCapacity - 1;
+    frameBuffer = new uint32_t[ frameCapacity ]();
+
+    chunkCapacity = nextPowerOfTwo( maxChunks );
+    chunkMask = chunkCapacity - 1;
+    chunkBuffer = new AudioRingChunk[ chunkCapacity ]();
+}
+
+bool AudioRing::attach( void *memory, size_t minFrames, size_t maxChunks, bool initialize ) {
+    free();
+
+    if( !memory || minFrames == 0 || maxChunks == 0 ) {
+        return false;
+    }
+
+    size_t frames = nextPowerOfTwo( minFrames );
+    size_t chunks = nextPowerOfTwo( maxChunks );
+    uint8_t *base = static_cast<uint8_t *>( memory );
+    Shared *block = reinterpret_cast<Shared *>( base );
+
+    if( initialize ) {
+        block = new( base ) Shared();
+        block->frameCapacity = frames;
+        block->chunkCapacity = chunks;
+    } else if( block->frameCapacity != frames || block->chunkCapacity != chunks ) {
+        return false;
+    }
+
+    // Shared block, then chunks, then frames
+    shared = block;
+    external = true;
+
+    chunkCapacity = chunks;
+    chunkMask = chunkCapacity - 1;
+    chunkBuffer = reinterpret_cast<AudioRingChunk *>( base + roundUpToCacheLine( sizeof( Shared ) ) );
+
+    frameCapacity = frames;
+    frameMask = frameCapacity - 1;
+    frameBuffer = reinterpret_cast<uint32_t *>( base + roundUpToCacheLine( sizeof( Shared ) ) + chunkCapacity * sizeof( AudioRingChunk ) );
+
+    return true;
+}
+
+size_t AudioRing::sharedMemorySize( size_t minFrames, size_t maxChunks ) {
+    return roundUpToCacheLine( sizeof( Shared ) ) + nextPowerOfTwo( maxChunks ) * sizeof( AudioRingChunk ) +
+           nextPowerOfTwo( minFrames ) * sizeof( uint32_t );
+}
+
+void AudioRing::free() {
+    // Attached memory belongs to whoever provided it, and may be in use by the other side
+    if( !external ) {
+        delete[] frameBuffer;
+        delete[] chunkBuffer;
+    }
+
+    frameBuffer = nullptr;
+    chunkBuffer = nullptr;
+
+    frameCapacity = 0;
+    frameMask = 0;
+    chunkCapacity = 0;
+    chunkMask = 0;
+
+    writePos = 0;
+    committedPos = 0;
+    chunkWritePos = 0;
+    cachedReadPos = 0;
+    cachedChunkReadPos = 0;
+    readPos = 0;
+    chunkReadPos = 0;
+    shared = &ownedShared;
+    external = false;
+    ownedShared.chunkWritePos.store( 0 );
+    ownedShared.readPos.store( 0 );
+    ownedShared.chunkReadPos.store( 0 );
+    ownedShared.dropped.store( 0 );
+}
+
+bool AudioRing::isActive() const {
+    return frameBuffer != nullptr;
+}
+
+bool AudioRing::isExternal() const {
+    return external;
+}
+
+size_t AudioRing::capacity() const {
+    return frameCapacity;
+}
+
+// Producer
+
+size_t AudioRing::write( const int16_t *data, size_t frames ) {
+    if( frameCapacity - ( writePos - cachedReadPos ) < frames ) {
+        cachedReadPos = shared->readPos.load( std::memory_order_acquire );
+    }
+
+    size_t count = std::min( frames, frameCapacity - ( writePos - cachedReadPos ) );
+
+    if( count < frames ) {
+        shared->dropped.fetch_add( frames - count, std::memory_order_relaxed );
+
+        if( !count ) {
+            return 0;
+        }
+    }
+
+    // Copy in up to two runs, split where the ring wraps around
+    size_t start = writePos & frameMask;
+    size_t firstRun = std::min( count, frameCapacity - start );
+    memcpy( frameBuffer + start, data, firstRun * sizeof( uint32_t ) );
+    memcpy( frameBuffer, data + firstRun * 2, ( count - firstRun ) * sizeof( uint32_t ) );
+
+    writePos += count;
+
+    return count;
+}
+
+bool AudioRing::commit( qint64 timeStamp ) {
+    size_t frames = writePos - committedPos;
+
+    if( !frames ) {
+        return false;
+    }
+
+    if( chunkWritePos - cachedChunkReadPos == chunkCapacity ) {
+        cachedChunkReadPos = shared->chunkReadPos.load( std::memory_order_acquire );
+
+        if( chunkWritePos - cachedChunkReadPos == chunkCapacity ) {
+            return false;
+        }
+    }
+
+    AudioRingChunk &chunk = chunkBuffer[ chunkWritePos & chunkMask ];
+    chunk.frames = frames;
+    chunk.timeStamp = timeStamp;
+
+    chunkWritePos++;
+    committedPos = writePos;
+
+    // Publishes the chunk descriptor and the frames written before it
+    shared->chunkWritePos.store( chunkWritePos, std::memory_order_release );
+
+    return true;
+}
+
+quint64 AudioRing::framesDropped() const {
+    return shared->dropped.load( std::memory_order_relaxed );
+}
+
+// Consumer
+
+bool AudioRing::read( int16_t *out, size_t maxFrames, AudioRingChunk &chunk ) {
+    if( chunkReadPos == shared->chunkWritePos.load( std::memory_order_acquire ) ) {
+        return false;
+    }
+
+    const AudioRingChunk &next = chunkBuffer[ chunkReadPos & chunkMask ];
+    size_t count = std::min( next.frames, maxFrames );
+
+    size_t start = readPos & frameMask;
+    size_t firstRun = std::min( count, frameCapacity - start );
+    memcpy( out, frameBuffer + start, firstRun * sizeof( uint32_t ) );
+    memcpy( out + firstRun * 2, frameBuffer, ( count - firstRun ) * sizeof( uint32_t ) );
+
+    chunk.frames = count;
+    chunk.timeStamp = next.timeStamp;
+
+    // Frames that didn't fit in out are skipped
+    readPos += next.frames;
+    chunkReadPos++;
+
+    // Hand the space back to the producer only once we're done copying out of it
+    shared->readPos.store( readPos, std::memory_order_release );
+    shared->chunkReadPos.store( chunkReadPos, std::memory_order_release );
+
+    return true;
+}
+
+size_t AudioRing::chunksAvailable() const {
+    return shared->chunkWritePos.load( std::memory_order_acquire ) - chunkReadPos;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Default number of chunks that may be in flight at once, far more than a consumer should ever fall behind by
+#define AUDIORING_DEFAULT_CHUNKS 256
+
+// Keeps the producer's and consumer's positions on separate cache lines
+#define AUDIORING_CACHE_LINE 64
+
+// A run of frames committed to an AudioRing in one go
+struct AudioRingChunk {
+    size_t frames;
+    qint64 timeStamp;
+};
+
+/*
+ * AudioRing is a lock-free single-producer, single-consumer ring of 16-bit stereo audio frames, the hand-off between a
+ * Core's audio callbacks and AudioOutput.
+ *
+ * The producer writes frames one at a time (writeFrame(), cheap enough for per-sample callbacks) or in batches (write()).
+ * Written frames only become visible to the consumer once committed as a chunk with commit(), which records how many
+ * frames it holds and a timestamp. The consumer reads whole chunks with read().
+ *
+ * Frames are never overwritten before they're read: if the consumer falls behind, the producer drops new frames instead
+ * and counts them in framesDropped().
+ *
+ * Frame counts are in stereo frames (1 frame = 4 bytes: L, L, R, R). init(), attach() and free() are not thread-safe, only
+ * call them while neither side is using the ring.
+ *
+ * The ring normally allocates its own memory with init(). attach() places it in memory provided by the caller instead,
+ * which lets the producer and the consumer live in different processes: each process attaches its own AudioRing to the
+ * same shared memory, one as the producer and the other as the consumer.
+ */
+
+class AudioRing {
+    public:
+        AudioRing() = default;
+        ~AudioRing();
+
+        AudioRing( const AudioRing & ) = delete;
+        AudioRing &operator=( const AudioRing & ) = delete;
+
+        // Allocate room for at least the given number of frames, discarding anything in the ring
+        void init( size_t minFrames, size_t maxChunks = AUDIORING_DEFAULT_CHUNKS );
+
+        // Lay the ring out in memory, which must be at least sharedMemorySize( minFrames, maxChunks ) bytes, aligned to
+        // AUDIORING_CACHE_LINE and stay valid until free(). Exactly one side initializes the memory, and both sides must be
+        // attached before anything is written. Returns false if the memory was initialized for a differently sized ring
+        bool attach( void *memory, size_t minFrames, size_t maxChunks = AUDIORING_DEFAULT_CHUNKS, bool initialize = false );
+
+        // Bytes of memory attach() needs for the given ring size
+        static size_t sharedMemorySize( size_t minFrames, size_t maxChunks = AUDIORING_DEFAULT_CHUNKS );
+
+        // Release all memory (or detach from it, if attached)
+        void free();
+
+        bool isActive() const;
+
+        // True if attached to memory the ring doesn't own
+        bool isExternal() const;
+
+        // Number of frames the ring can hold
+        size_t capacity() const;
+
+        // Producer
+
+        // Append a single frame. Returns false (and drops the frame) if the ring is full
+        inline bool writeFrame( int16_t left, int16_t right ) {
+            if( writePos - cachedReadPos == frameCapacity ) {
+                cachedReadPos = shared->readPos.load( std::memory_order_acquire );
+
+                if( writePos - cachedReadPos == frameCapacity ) {
+                    shared->dropped.fetch_add( 1, std::memory_order_relaxed );
+                    return false;
+                }
+            }
+
+            int16_t frame[ 2 ] = { left, right };
+            memcpy( &frameBuffer[ writePos & frameMask ], frame, sizeof( frame ) );
+            writePos++;
+            return true;
+        }
+
+        // Append interleaved frames. Returns how many fit, the rest are dropped
+        size_t write( const int16_t *data, size_t frames );
+
+        // Frames written since the last successful commit()
+        inline size_t pendingFrames() const {
+            return writePos - committedPos;
+        }
+
+        // Publish all pending frames to the consumer as one chunk. Returns false if there was nothing to commit or if the
+        // consumer has too many chunks outstanding, in which case the frames stay pending until the next commit()
+        bool commit( qint64 timeStamp );
+
+        // Frames dropped because the ring was full
+        quint64 framesDropped() const;
+
+        // Consumer
+
+        // Copy the oldest chunk's frames (interleaved, up to maxFrames of them) to out. chunk receives the number of
+        // frames copied and the chunk's timestamp. Returns false if no chunk is available
+        bool read( int16_t *out, size_t maxFrames, AudioRingChunk &chunk );
+
+        // Number of committed chunks waiting to be read
+        size_t chunksAvailable() const;
+
+    private:
+        // Everything both sides touch, lives at the start of the memory when attached
+        struct Shared {
+            // Written by the producer
+            alignas( AUDIORING_CACHE_LINE ) std::atomic<size_t> chunkWritePos { 0 };
+
+            // Written by the consumer
+            alignas( AUDIORING_CACHE_LINE ) std::atomic<size_t> readPos { 0 };
+            std::atomic<size_t> chunkReadPos { 0 };
+
+            // Written by the producer
+            std::atomic<quint64> dropped { 0 };
+
+            // Lets attach() check both sides agree on the layout
+            size_t frameCapacity { 0 };
+            size_t chunkCapacity { 0 };
+        };
+
+        // Each frame is stored as a packed L/R pair
+        uint32_t *frameBuffer { nullptr };
+        size_t frameCapacity { 0 };
+        size_t frameMask { 0 };
+
+        AudioRingChunk *chunkBuffer { nullptr };
+        size_t chunkCapacity { 0 };
+        size_t chunkMask { 0 };
+
+        // Positions below are free-running counters, masked when indexing
+
+        // Producer-owned
+        alignas( AUDIORING_CACHE_LINE ) size_t writePos { 0 };
+        size_t committedPos { 0 };
+        size_t chunkWritePos { 0 };
+        size_t cachedReadPos { 0 };
+        size_t cachedChunkReadPos { 0 };
+
+        // Consumer-owned
+        alignas( AUDIORING_CACHE_LINE ) size_t readPos { 0 };
+        size_t chunkReadPos { 0 };
+
+        // Shared, each written by one side only. Points into the attached memory or at ownedShared
+        Shared ownedShared;
+        Shared *shared { &ownedShared };
+        bool external { false };
+};
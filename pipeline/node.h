@@ -96,6 +96,71 @@ class Node : public QObject {
             // bool
             SetRewindable,
 
+            // Serialize the core's state and write it to the given slot on disk
+            // int
+            SaveState,
+
+            // Restore the core's state from the given slot on disk
+            // int
+            LoadState,
+
+            // Serialize the core's state to the given in-memory slot. Quick states are lost once the game is stopped
+            // int
+            SaveQuickState,
+
+            // Restore the core's state from the given in-memory slot
+            // int
+            LoadQuickState,
+
+            // Number of frames to run ahead of the real emulated state to hide a core's internal input lag. 0 disables
+            // run-ahead. Has no effect unless the core supports serialization. LibretroRunner sends 0 if the core can't save
+            // or restore its state, then the value asked for again once the game stops
+            // int
+            SetRunAhead,
+
+            // Search the core's RAM, see LibretroMemorySearch. Keys: "comparison" (QString: "reset", "changed",
+            // "unchanged", "increased", "decreased", "equal", "notequal", "greater" or "less") and "value" (int, only used
+            // by the last four). "reset" starts a new search with every byte as a candidate
+            // QVariantMap
+            SearchMemory,
+
+            // Outcome of the last SearchMemory. Keys: "count" (qint64, candidates left), "size" (qint64, bytes searched),
+            // "msecs" (qreal) and "matches" (QVariantList of QVariantMaps with "address" and "value", the first few
+            // candidates only)
+            // QVariantMap
+            SetMemorySearchResults,
+
+            // The core's performance counters (see LibretroPerf) since the game was loaded, sent about once a second while
+            // playing and once more on Stop. One QVariantMap per counter, most total time first. Keys: "name" (QString),
+            // "count" (qint64), "totalMsecs", "p50Usecs" and "p99Usecs" (qreal)
+            // QVariantList
+            SetPerfCounters,
+
+            // Publish the core's memory to other processes through shared memory (see LibretroMemoryExport): copied
+            // into it every this many frames if positive, in place (nothing copied) if negative. 0 disables the export
+            // int
+            SetMemoryExport,
+
+            // Name of the shared memory segment the core's memory is exported to (see LibretroMemoryExport), sent by
+            // LibretroRunner when the export starts. Empty once it stops or if it failed to start
+            // QString
+            SetMemoryExportName,
+
+            // Keep the core loaded and initialized after Stop so the next game on the same core loads faster. Setting it
+            // to false while stopped unloads a core kept loaded this way
+            // bool
+            SetKeepCoreLoaded,
+
+            // Record the input fed to the core into a movie at the given path (see LibretroMovieRecorder). An empty path
+            // stops recording
+            // QString
+            RecordMovie,
+
+            // Replay the movie at the given path in place of live input (see LibretroMoviePlayer). An empty path stops
+            // playback
+            // QString
+            PlayMovie,
+
             // Set volume. Range: [0.0, 1.0]
             // qreal
             SetVolume,
@@ -127,10 +192,6 @@ class Node : public QObject {
             // QOpenGLContext *
             SetOpenGLContext,
 
-            // Set the texture for rendering
-            // GLuint
-            SetOpenGLTexture,
-
             // Audio
 
             // Sample rate in Hz
@@ -153,11 +214,12 @@ class Node : public QObject {
             // uchar **
             Video,
 
-            // Render the stored textureID
-            // nullptr
+            // A hardware-rendered core published a frame, render the newest one. Frames are handed over and back through
+            // fences, mutex is unused (nullptr). Only one consumer (the one that renders) may update() it
+            // LibretroGLFrames *
             VideoGL,
 
-            // short **
+            // AudioRing *, bytes is the size of the chunk that was just committed. mutex is unused (nullptr)
             Audio,
 
             // GamepadState *
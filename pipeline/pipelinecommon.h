@@ -5,6 +5,9 @@
 #include <QAudioFormat>
 #include <QImage>
 
+#include "glfences.h"
+#include "triplebuffer.h"
+
 /*
  * Structures usable by all nodes
  */
@@ -37,5 +40,27 @@ struct LibretroVideoFormat {
 Q_DECLARE_METATYPE( size_t )
 Q_DECLARE_METATYPE( LibretroVideoFormat )
 
+// A frame a hardware-rendered core drew into one of its textures, see Node::DataType::VideoGL
+struct LibretroGLFrame {
+    // Which of the core's framebuffers the texture belongs to
+    int index { 0 };
+
+    // The frame is the size x size rectangle in the bottom-left corner of the textureSize texture
+    GLuint texture { 0 };
+    QSize textureSize;
+    QSize size;
+
+    // Signaled once the core is done drawing the frame, set by the core. The consumer makes its commands wait on it
+    // then frees it
+    GLFence ready { nullptr };
+
+    // Signaled once the consumer is done sampling the texture, set by the consumer before it takes a newer frame. The
+    // core makes its commands wait on it then frees it before drawing into the texture again
+    GLFence released { nullptr };
+};
+
+// Produced by the core's thread, consumed by the render thread
+typedef TripleBuffer<LibretroGLFrame> LibretroGLFrames;
+
 typedef QMap<QString, QString> QStringMap;
 Q_DECLARE_METATYPE( QStringMap )
@@ -0,0 +1,72 @@
+#include "glfences.h"
+#include "logging.h"
+
+#include <QOpenGLFunctions>
+
+// Not in every platform's GL headers
+#define GLFENCES_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GLFENCES_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+
+bool GLFences::init( QOpenGLContext *context ) {
+    if( context == currentContext ) {
+        return isSupported();
+    }
+
+    currentContext = context;
+    fenceSync = nullptr;
+    waitSync = nullptr;
+    deleteSync = nullptr;
+
+    if( !context ) {
+        return false;
+    }
+
+    QSurfaceFormat format = context->format();
+    bool supported = context->isOpenGLES() ? format.majorVersion() >= 3 :
+                     format.version() >= qMakePair( 3, 2 ) || context->hasExtension( "GL_ARB_sync" );
+
+    if( supported ) {
+        fenceSync = reinterpret_cast<FenceSyncFunction>( context->getProcAddress( "glFenceSync" ) );
+        waitSync = reinterpret_cast<WaitSyncFunction>( context->getProcAddress( "glWaitSync" ) );
+        deleteSync = reinterpret_cast<DeleteSyncFunction>( context->getProcAddress( "glDeleteSync" ) );
+    }
+
+    if( !isSupported() ) {
+        qCDebug( phxVideo ) << "Fence syncs not supported by" << context << "falling back to glFinish()";
+    }
+
+    return isSupported();
+}
+
+bool GLFences::isSupported() const {
+    return fenceSync && waitSync && deleteSync;
+}
+
+QOpenGLContext *GLFences::context() const {
+    return currentContext;
+}
+
+GLFence GLFences::insert() {
+    if( !isSupported() ) {
+        return nullptr;
+    }
+
+    GLFence fence = fenceSync( GLFENCES_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+    // Another context waiting on a fence that was never flushed would wait forever
+    currentContext->functions()->glFlush();
+
+    return fence;
+}
+
+void GLFences::wait( GLFence fence ) {
+    if( fence && isSupported() ) {
+        waitSync( fence, 0, GLFENCES_TIMEOUT_IGNORED );
+    }
+}
+
+void GLFences::remove( GLFence fence ) {
+    if( fence && isSupported() ) {
+        deleteSync( fence );
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+// A GLsync, kept opaque so this builds against GL headers that don't have them
+typedef void *GLFence;
+
+/*
+ * GLFences wraps the fence sync functions (desktop GL 3.2, GL_ARB_sync and ES 3.0) that hand textures between the
+ * core's context and the scene graph's: one context inserts a fence after drawing to or sampling from a texture, the
+ * other makes its own commands wait for it before touching the texture. Only the GPU waits, neither thread blocks.
+ *
+ * Fences are shared between contexts that share objects. The functions are resolved once per context, everything but
+ * init() must be called with that context current.
+ */
+
+class GLFences {
+    public:
+        // Resolve the functions from context, which must be current. Does nothing if context is the one already used
+        // Returns false if context doesn't support fences
+        bool init( QOpenGLContext *context );
+        bool isSupported() const;
+
+        // The context init() resolved the functions from, nullptr if not initialized
+        QOpenGLContext *context() const;
+
+        // Fence everything issued so far and flush it so other contexts can wait on it. nullptr if fences aren't
+        // supported, the caller must glFinish() to be safe then
+        GLFence insert();
+
+        // Make commands issued after this wait for fence. Returns immediately
+        void wait( GLFence fence );
+
+        // Free fence, safe even if a wait() on it is still pending. Does nothing if fence is nullptr
+        void remove( GLFence fence );
+
+    private:
+        typedef GLFence( QOPENGLF_APIENTRYP FenceSyncFunction )( GLenum condition, GLbitfield flags );
+        typedef void ( QOPENGLF_APIENTRYP WaitSyncFunction )( GLFence fence, GLbitfield flags, quint64 timeout );
+        typedef void ( QOPENGLF_APIENTRYP DeleteSyncFunction )( GLFence fence );
+
+        QOpenGLContext *currentContext { nullptr };
+        FenceSyncFunction fenceSync { nullptr };
+        WaitSyncFunction waitSync { nullptr };
+        DeleteSyncFunction deleteSync { nullptr };
+};
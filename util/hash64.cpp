@@ -0,0 +1,102 @@
+#include "hash64.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+namespace {
+    const quint64 prime1 = 0x9E3779B185EBCA87ULL;
+    const quint64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+    const quint64 prime3 = 0x165667B19E3779F9ULL;
+    const quint64 prime4 = 0x85EBCA77C2B2AE63ULL;
+    const quint64 prime5 = 0x27D4EB2F165667C5ULL;
+
+    inline quint64 rotateLeft( quint64 value, int bits ) {
+        return ( value << bits ) | ( value >> ( 64 - bits ) );
+    }
+
+    // Unaligned little-endian reads, memcpy compiles down to a single load
+    inline quint64 read64( const quint8 *p ) {
+        quint64 value;
+        memcpy( &value, p, sizeof( value ) );
+        return qFromLittleEndian( value );
+    }
+
+    inline quint32 read32( const quint8 *p ) {
+        quint32 value;
+        memcpy( &value, p, sizeof( value ) );
+        return qFromLittleEndian( value );
+    }
+
+    inline quint64 round( quint64 accumulator, quint64 input ) {
+        accumulator += input * prime2;
+        accumulator = rotateLeft( accumulator, 31 );
+        return accumulator * prime1;
+    }
+
+    inline quint64 mergeRound( quint64 accumulator, quint64 value ) {
+        accumulator ^= round( 0, value );
+        return accumulator * prime1 + prime4;
+    }
+}
+
+quint64 hash64( const void *data, size_t bytes, quint64 seed ) {
+    const quint8 *p = static_cast<const quint8 *>( data );
+    const quint8 *end = p + bytes;
+    quint64 hash;
+
+    if( bytes >= 32 ) {
+        const quint8 *limit = end - 32;
+        quint64 v1 = seed + prime1 + prime2;
+        quint64 v2 = seed + prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - prime1;
+
+        // The four lanes don't depend on each other, so their multiplies overlap in the pipeline
+        do {
+            v1 = round( v1, read64( p ) );
+            v2 = round( v2, read64( p + 8 ) );
+            v3 = round( v3, read64( p + 16 ) );
+            v4 = round( v4, read64( p + 24 ) );
+            p += 32;
+        } while( p <= limit );
+
+        hash = rotateLeft( v1, 1 ) + rotateLeft( v2, 7 ) + rotateLeft( v3, 12 ) + rotateLeft( v4, 18 );
+        hash = mergeRound( hash, v1 );
+        hash = mergeRound( hash, v2 );
+        hash = mergeRound( hash, v3 );
+        hash = mergeRound( hash, v4 );
+    } else {
+        hash = seed + prime5;
+    }
+
+    hash += static_cast<quint64>( bytes );
+
+    // Tail
+    while( p + 8 <= end ) {
+        hash ^= round( 0, read64( p ) );
+        hash = rotateLeft( hash, 27 ) * prime1 + prime4;
+        p += 8;
+    }
+
+    if( p + 4 <= end ) {
+        hash ^= static_cast<quint64>( read32( p ) ) * prime1;
+        hash = rotateLeft( hash, 23 ) * prime2 + prime3;
+        p += 4;
+    }
+
+    while( p < end ) {
+        hash ^= ( *p ) * prime5;
+        hash = rotateLeft( hash, 11 ) * prime1;
+        p++;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
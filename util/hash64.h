@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <stddef.h>
+
+/*
+ * Fast non-cryptographic 64-bit hash (XXH64) for change detection on large buffers: SRAM, framebuffers, states.
+ * Runs four independent lanes so it goes at several GB/s, hashing a few hundred KB takes tens of microseconds.
+ */
+
+quint64 hash64( const void *data, size_t bytes, quint64 seed = 0 );
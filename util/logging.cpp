@@ -1,4 +1,34 @@
 #include "logging.h"
+#include "logring.h"
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QWaitCondition>
+
+#include <atomic>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined( Q_OS_UNIX )
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+// How often the logger thread writes out what's been queued, in ms
+#define LOGGING_WRITE_INTERVAL 10
+
+// Longest category, file and function names kept with each queued message, the rest of the record is for the message
+#define LOGGING_MAX_CATEGORY_LENGTH 64
+#define LOGGING_MAX_LOCATION_LENGTH 192
+
+// Starts each line written with record output on, see setLogRecordOutput()
+#define LOGGING_RECORD_MARKER '\x1e'
 
 Q_LOGGING_CATEGORY( phxAudioOutput, "phoenix.audiooutput" )
 Q_LOGGING_CATEGORY( phxControl, "phoenix.control" )
@@ -9,3 +39,437 @@ Q_LOGGING_CATEGORY( phxGameConsole, "phoenix.gameconsole" )
 Q_LOGGING_CATEGORY( phxInput, "phoenix.input" )
 Q_LOGGING_CATEGORY( phxTimer, "phoenix.timer" )
 Q_LOGGING_CATEGORY( phxVideo, "phoenix.video" )
+
+// Asynchronous logging
+
+namespace {
+    const char *coreLevelPrefixes[] = {
+        "RETRO_LOG_DEBUG: ",
+        "RETRO_LOG_INFO: ",
+        "RETRO_LOG_WARN: ",
+        "RETRO_LOG_ERROR: ",
+    };
+
+    LogRing logRing;
+    std::atomic<bool> asyncLogging { false };
+
+    // Where messages finally go, whatever handler was installed before ours (Qt's default one, usually)
+    QtMessageHandler previousHandler { nullptr };
+    bool previousHandlerIsDefault { false };
+
+    // If set, where messages go instead of the previous handler, see setLogOutputFd()
+    std::atomic<int> logOutputFd { -1 };
+
+    // See setLogRecordOutput()
+    std::atomic<bool> recordOutput { false };
+
+    // Held while writing out queued messages, the ring only allows one reader at a time
+    QMutex writeMutex;
+    quint64 reportedDrops { 0 };
+
+    // <marker><type>\t<category>\t<message>, with backslashes and newlines in the message escaped so it stays on one line
+    void writeLogRecord( QtMsgType type, const QMessageLogContext &context, const QString &message ) {
+        QString escaped = message;
+        escaped.replace( QLatin1Char( '\\' ), QLatin1String( "\\\\" ) ).replace( QLatin1Char( '\n' ), QLatin1String( "\\n" ) );
+
+        QByteArray line;
+        line += LOGGING_RECORD_MARKER;
+        line += QByteArray::number( static_cast<int>( type ) ) + '\t';
+        line += QByteArray( context.category ? context.category : "default" ) + '\t';
+        line += escaped.toUtf8() + '\n';
+
+        fwrite( line.constData(), 1, static_cast<size_t>( line.size() ), stderr );
+        fflush( stderr );
+    }
+
+    QString unescapeLogRecord( const QString &escaped ) {
+        QString message;
+        message.reserve( escaped.size() );
+
+        for( int i = 0; i < escaped.size(); i++ ) {
+            if( escaped[ i ] == QLatin1Char( '\\' ) && i + 1 < escaped.size() ) {
+                i++;
+                message += escaped[ i ] == QLatin1Char( 'n' ) ? QChar( QLatin1Char( '\n' ) ) : escaped[ i ];
+            } else {
+                message += escaped[ i ];
+            }
+        }
+
+        return message;
+    }
+
+    // Relayed records are logged under a category of the same name, made the first time it's seen. QLoggingCategory
+    // keeps the pointer it's given, so the names are never freed either
+    QLoggingCategory &relayCategory( const QByteArray &name ) {
+        static QMutex mutex;
+        static QHash<QByteArray, QLoggingCategory *> categories;
+
+        QMutexLocker locker( &mutex );
+        QLoggingCategory *&category = categories[ name ];
+
+        if( !category ) {
+            category = new QLoggingCategory( qstrdup( name.constData() ) );
+        }
+
+        return *category;
+    }
+
+    void writeMessage( QtMsgType type, const QMessageLogContext &context, const QString &message ) {
+        if( recordOutput.load( std::memory_order_acquire ) ) {
+            writeLogRecord( type, context, message );
+            return;
+        }
+
+        int fd = logOutputFd.load( std::memory_order_acquire );
+
+#if defined( Q_OS_UNIX )
+        // Formatted the way Qt's handler would have
+        if( fd >= 0 ) {
+            QByteArray line = qFormatLogMessage( type, context, message ).toLocal8Bit() + '\n';
+            const char *data = line.constData();
+            ssize_t left = line.size();
+
+            while( left > 0 ) {
+                ssize_t written = write( fd, data, static_cast<size_t>( left ) );
+
+                if( written < 0 ) {
+                    if( errno == EINTR ) {
+                        continue;
+                    }
+
+                    break;
+                }
+
+                data += written;
+                left -= written;
+            }
+
+            return;
+        }
+#else
+        Q_UNUSED( fd );
+#endif
+
+        if( previousHandler ) {
+            previousHandler( type, context, message );
+        } else {
+            fprintf( stderr, "%s\n", message.toLocal8Bit().constData() );
+        }
+    }
+
+    void writeRecord( const LogRecord &record ) {
+        // Empty names were null to begin with
+        const char *category = record.text;
+        const char *file = record.text + record.fileOffset;
+        const char *function = record.text + record.functionOffset;
+        QMessageLogContext context( *file ? file : nullptr, record.line, *function ? function : nullptr,
+                                    *category ? category : nullptr );
+        const char *messageData = record.text + record.messageOffset;
+        QString message;
+
+        if( record.coreLevel ) {
+            message = QString::fromLatin1( record.coreLevel <= 4 ? coreLevelPrefixes[ record.coreLevel - 1 ]
+                                           : "RETRO_LOG (unknown category!?): " );
+        }
+
+        if( record.wide ) {
+            // Copied in unaligned, copy it out the same way
+            QVarLengthArray<ushort, LOGRING_TEXT_SIZE / 2> utf16( record.messageBytes / 2 );
+            memcpy( utf16.data(), messageData, record.messageBytes );
+            message += QString::fromUtf16( utf16.constData(), utf16.size() );
+        } else {
+            message += QString::fromLocal8Bit( messageData, record.messageBytes );
+        }
+
+        if( record.truncated ) {
+            message += QStringLiteral( " [truncated]" );
+        }
+
+        writeMessage( static_cast<QtMsgType>( record.type ), context, message );
+    }
+
+    void writeQueuedRecords() {
+        QMutexLocker locker( &writeMutex );
+
+        while( LogRecord *record = logRing.front() ) {
+            writeRecord( *record );
+            logRing.pop();
+        }
+
+        quint64 dropped = logRing.dropped();
+
+        if( dropped != reportedDrops ) {
+            writeMessage( QtWarningMsg, QMessageLogContext(), QStringLiteral( "%1 log messages dropped, they were logged "
+                          "faster than they could be written" ).arg( dropped - reportedDrops ) );
+            reportedDrops = dropped;
+        }
+    }
+
+    // Fills in everything but the message, returns where the message goes
+    quint16 beginRecord( LogRecord *record, QtMsgType type, int coreLevel, const char *category, const char *file,
+                         int line, const char *function ) {
+        record->type = static_cast<quint8>( type );
+        record->coreLevel = static_cast<quint8>( coreLevel );
+        record->truncated = false;
+        record->line = line;
+
+        quint16 offset = LogRing::appendString( record, 0, category, LOGGING_MAX_CATEGORY_LENGTH );
+        record->fileOffset = offset;
+        offset = LogRing::appendString( record, offset, file, LOGGING_MAX_LOCATION_LENGTH );
+        record->functionOffset = offset;
+        offset = LogRing::appendString( record, offset, function, LOGGING_MAX_LOCATION_LENGTH );
+        return offset;
+    }
+
+    void messageHandler( QtMsgType type, const QMessageLogContext &context, const QString &message ) {
+        if( type == QtFatalMsg || !asyncLogging.load( std::memory_order_acquire ) ) {
+            writeQueuedRecords();
+            writeMessage( type, context, message );
+            return;
+        }
+
+        LogRecord *record = logRing.claim();
+
+        if( !record ) {
+            return;
+        }
+
+        // Keep the UTF-16 as it is, converting it is the logger thread's job
+        quint16 offset = beginRecord( record, type, 0, context.category, context.file, context.line, context.function );
+        size_t space = ( LOGRING_TEXT_SIZE - offset ) & ~static_cast<size_t>( 1 );
+        size_t bytes = static_cast<size_t>( message.size() ) * 2;
+
+        record->truncated = bytes > space;
+        record->wide = true;
+        record->messageOffset = offset;
+        record->messageBytes = static_cast<quint16>( qMin( bytes, space ) );
+        memcpy( record->text + offset, message.constData(), record->messageBytes );
+
+        logRing.publish( record );
+    }
+
+    class LoggerThread : public QThread {
+        public:
+            void stop() {
+                QMutexLocker locker( &mutex );
+                stopping = true;
+                condition.wakeOne();
+            }
+
+        protected:
+            void run() override {
+                QMutexLocker locker( &mutex );
+
+                while( !stopping ) {
+                    locker.unlock();
+                    writeQueuedRecords();
+                    locker.relock();
+
+                    if( !stopping ) {
+                        condition.wait( &mutex, LOGGING_WRITE_INTERVAL );
+                    }
+                }
+
+                locker.unlock();
+                writeQueuedRecords();
+            }
+
+        private:
+            QMutex mutex;
+            QWaitCondition condition;
+            bool stopping { false };
+    };
+
+    LoggerThread *loggerThread { nullptr };
+}
+
+void startAsyncLogging() {
+    if( loggerThread ) {
+        return;
+    }
+
+    loggerThread = new LoggerThread;
+    loggerThread->setObjectName( "Logger thread" );
+    loggerThread->start( QThread::LowPriority );
+
+    previousHandler = qInstallMessageHandler( messageHandler );
+
+    // Putting Qt's handler back gets us its address, so we can tell if that's what was installed before
+    qInstallMessageHandler( nullptr );
+    previousHandlerIsDefault = qInstallMessageHandler( messageHandler ) == previousHandler;
+
+    asyncLogging.store( true, std::memory_order_release );
+
+    qAddPostRoutine( stopAsyncLogging );
+}
+
+void stopAsyncLogging() {
+    if( !loggerThread ) {
+        return;
+    }
+
+    asyncLogging.store( false, std::memory_order_release );
+
+    loggerThread->stop();
+    loggerThread->wait();
+    delete loggerThread;
+    loggerThread = nullptr;
+
+    qInstallMessageHandler( previousHandler );
+    writeQueuedRecords();
+}
+
+bool setLogOutputFd( int fd ) {
+    if( fd >= 0 && ( !loggerThread || !previousHandlerIsDefault ) ) {
+        return false;
+    }
+
+    // Don't switch in the middle of writing out a batch
+    QMutexLocker locker( &writeMutex );
+    logOutputFd.store( fd, std::memory_order_release );
+    return true;
+}
+
+void setLogRecordOutput( bool enabled ) {
+    QMutexLocker locker( &writeMutex );
+    recordOutput.store( enabled, std::memory_order_release );
+}
+
+void relayLogLine( const QByteArray &line, const QString &source ) {
+    int typeEnd = line.indexOf( '\t' );
+    int categoryEnd = typeEnd < 0 ? -1 : line.indexOf( '\t', typeEnd + 1 );
+
+    // Not a record, something (the core, usually) wrote to stdout or stderr directly
+    if( !line.startsWith( LOGGING_RECORD_MARKER ) || categoryEnd < 0 ) {
+        qCInfo( phxCore ).noquote().nospace() << "[" << source << "] " << QString::fromLocal8Bit( line );
+        return;
+    }
+
+    QtMsgType type = static_cast<QtMsgType>( line.mid( 1, typeEnd - 1 ).toInt() );
+    QLoggingCategory &category = relayCategory( line.mid( typeEnd + 1, categoryEnd - typeEnd - 1 ) );
+
+    switch( type ) {
+        case QtDebugMsg:
+            if( !category.isDebugEnabled() ) {
+                return;
+            }
+
+            break;
+
+        case QtInfoMsg:
+            if( !category.isInfoEnabled() ) {
+                return;
+            }
+
+            break;
+
+        case QtWarningMsg:
+            if( !category.isWarningEnabled() ) {
+                return;
+            }
+
+            break;
+
+        // A fatal message took the other process down, not this one
+        default:
+            if( !category.isCriticalEnabled() ) {
+                return;
+            }
+
+            type = QtCriticalMsg;
+            break;
+    }
+
+    QString message = QStringLiteral( "[" ) + source + QStringLiteral( "] " ) +
+                      unescapeLogRecord( QString::fromUtf8( line.constData() + categoryEnd + 1, line.size() - categoryEnd - 1 ) );
+    QMessageLogContext context( nullptr, 0, nullptr, category.categoryName() );
+    qt_message_output( type, context, message );
+}
+
+void logCoreMessage( int level, const char *fmt, va_list args ) {
+    QtMsgType type;
+
+    switch( level ) {
+        case 0: // RETRO_LOG_DEBUG
+        case 1: // RETRO_LOG_INFO
+            if( !PHX_DEBUG_phxCore || !phxCore().isDebugEnabled() ) {
+                return;
+            }
+
+            type = QtDebugMsg;
+            break;
+
+        case 3: // RETRO_LOG_ERROR
+            if( !phxCore().isCriticalEnabled() ) {
+                return;
+            }
+
+            type = QtCriticalMsg;
+            break;
+
+        default:
+            if( !phxCore().isWarningEnabled() ) {
+                return;
+            }
+
+            type = QtWarningMsg;
+            break;
+    }
+
+    LogRecord *record = asyncLogging.load( std::memory_order_acquire ) ? logRing.claim() : nullptr;
+
+    // Not running (or the ring is full, in which case the message is counted as dropped)
+    if( !record ) {
+        if( asyncLogging.load( std::memory_order_relaxed ) ) {
+            return;
+        }
+
+        QVarLengthArray<char, 1024> buffer( 1024 );
+        va_list argsCopy;
+        va_copy( argsCopy, args );
+        int length = vsnprintf( buffer.data(), buffer.size(), fmt, argsCopy );
+        va_end( argsCopy );
+
+        if( length < 0 ) {
+            return;
+        }
+
+        if( length >= buffer.size() ) {
+            buffer.resize( length + 1 );
+            vsnprintf( buffer.data(), buffer.size(), fmt, args );
+        }
+
+        while( length > 0 && ( buffer[ length - 1 ] == '\n' || buffer[ length - 1 ] == '\r' ) ) {
+            length--;
+        }
+
+        QString message = QString::fromLatin1( level >= 0 && level <= 3 ? coreLevelPrefixes[ level ]
+                                               : "RETRO_LOG (unknown category!?): " ) +
+                          QString::fromLocal8Bit( buffer.constData(), length );
+        QMessageLogContext context( nullptr, 0, nullptr, phxCore().categoryName() );
+        qt_message_output( type, context, message );
+        return;
+    }
+
+    quint16 offset = beginRecord( record, type, level + 1, phxCore().categoryName(), nullptr, 0, nullptr );
+    size_t space = LOGRING_TEXT_SIZE - offset;
+    int length = vsnprintf( record->text + offset, space, fmt, args );
+
+    if( length < 0 ) {
+        length = 0;
+    }
+
+    record->truncated = static_cast<size_t>( length ) >= space;
+    length = qMin( length, static_cast<int>( space ) - 1 );
+
+    // The logger adds its own newline
+    while( length > 0 && ( record->text[ offset + length - 1 ] == '\n' || record->text[ offset + length - 1 ] == '\r' ) ) {
+        length--;
+    }
+
+    record->wide = false;
+    record->messageOffset = offset;
+    record->messageBytes = static_cast<quint16>( length );
+
+    logRing.publish( record );
+}
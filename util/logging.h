@@ -3,6 +3,8 @@
 #include <QLoggingCategory>
 #include <QDebug>
 
+#include <stdarg.h>
+
 /* This is used for debugging Phoenix. Instead of using qDebug(), developers should use qCDebug(%category%), such as
  * qCDebug(phxLibrary). The category used for debugging should be relevant to whatever class is being worked on.
  *
@@ -18,3 +20,88 @@ Q_DECLARE_LOGGING_CATEGORY( phxCore )
 Q_DECLARE_LOGGING_CATEGORY( phxInput )
 Q_DECLARE_LOGGING_CATEGORY( phxTimer )
 Q_DECLARE_LOGGING_CATEGORY( phxVideo )
+
+// Compile-time filtering
+// Defining PHX_NO_DEBUG_<CATEGORY> (DEFINES += PHX_NO_DEBUG_CORE, for instance) compiles that category's debug output out
+// entirely: the qCDebug() statements and everything streamed into them are dead code, not just skipped at runtime.
+// Otherwise Qt's runtime filter rules apply as usual. New categories need an entry here too
+
+#if defined( PHX_NO_DEBUG_AUDIOOUTPUT )
+#define PHX_DEBUG_phxAudioOutput false
+#else
+#define PHX_DEBUG_phxAudioOutput true
+#endif
+
+#if defined( PHX_NO_DEBUG_CONTROL )
+#define PHX_DEBUG_phxControl false
+#else
+#define PHX_DEBUG_phxControl true
+#endif
+
+#if defined( PHX_NO_DEBUG_CONTROLOUTPUT )
+#define PHX_DEBUG_phxControlOutput false
+#else
+#define PHX_DEBUG_phxControlOutput true
+#endif
+
+#if defined( PHX_NO_DEBUG_CONTROLPROXY )
+#define PHX_DEBUG_phxControlProxy false
+#else
+#define PHX_DEBUG_phxControlProxy true
+#endif
+
+#if defined( PHX_NO_DEBUG_CORE )
+#define PHX_DEBUG_phxCore false
+#else
+#define PHX_DEBUG_phxCore true
+#endif
+
+#if defined( PHX_NO_DEBUG_INPUT )
+#define PHX_DEBUG_phxInput false
+#else
+#define PHX_DEBUG_phxInput true
+#endif
+
+#if defined( PHX_NO_DEBUG_TIMER )
+#define PHX_DEBUG_phxTimer false
+#else
+#define PHX_DEBUG_phxTimer true
+#endif
+
+#if defined( PHX_NO_DEBUG_VIDEO )
+#define PHX_DEBUG_phxVideo false
+#else
+#define PHX_DEBUG_phxVideo true
+#endif
+
+// Same as Qt's, with the compile-time switch checked first
+#undef qCDebug
+#define qCDebug( category, ... ) \
+    for( bool phxDebugEnabled = PHX_DEBUG_##category && category().isDebugEnabled(); phxDebugEnabled; phxDebugEnabled = false ) \
+        QMessageLogger( QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, QT_MESSAGELOG_FUNC, category().categoryName() ).debug( __VA_ARGS__ )
+
+// Asynchronous logging
+// Once started, Qt's messages (qDebug(), qCWarning()...) from every thread are queued in a LogRing as they're logged and
+// written out by a logger thread, so logging never waits on stdout/stderr. Fatal messages are still written right away,
+// after whatever was queued before them. Needs a QCoreApplication, stops on its own when it's destroyed
+void startAsyncLogging();
+
+// Write out what's queued and go back to writing messages as they're logged
+void stopAsyncLogging();
+
+// Write messages the previous handler would have written to stderr to this file descriptor instead, -1 to go back to
+// the previous handler. Returns false (and changes nothing) if async logging isn't running or the previous handler isn't
+// Qt's own, we can't tell where a custom one writes to. Used by stdio capture (see stdiocapture.h)
+bool setLogOutputFd( int fd );
+
+// Relaying another process's log
+// A process with record output on writes each message to stderr as a record that keeps its type and category, instead
+// of formatting it. The process reading that stderr passes each line to relayLogLine(), which logs records as if they
+// had been logged here (same type, same category, same filter rules) and anything else as info under phxCore. Used by
+// phoenix-corehost and LibretroCoreProxy
+void setLogRecordOutput( bool enabled );
+void relayLogLine( const QByteArray &line, const QString &source );
+
+// Log a message from a Libretro core's log callback (level is a retro_log_level). Only the printf-style formatting happens
+// on the calling thread, the record is queued as is and prefixed with its level by the logger thread
+void logCoreMessage( int level, const char *fmt, va_list args );
@@ -0,0 +1,83 @@
+#include "logring.h"
+
+#include <string.h>
+
+LogRing::LogRing() {
+    for( size_t i = 0; i < LOGRING_SIZE; i++ ) {
+        records[ i ].sequence.store( i, std::memory_order_relaxed );
+    }
+}
+
+LogRecord *LogRing::claim() {
+    size_t position = claimPosition.load( std::memory_order_relaxed );
+
+    while( true ) {
+        LogRecord *record = &records[ position & ( LOGRING_SIZE - 1 ) ];
+        size_t sequence = record->sequence.load( std::memory_order_acquire );
+        ptrdiff_t difference = static_cast<ptrdiff_t>( sequence ) - static_cast<ptrdiff_t>( position );
+
+        // Free, try to take it
+        if( difference == 0 ) {
+            if( claimPosition.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) ) {
+                record->position = position;
+                return record;
+            }
+        }
+
+        // Still holds a record from the last lap the consumer hasn't freed
+        else if( difference < 0 ) {
+            droppedCount.fetch_add( 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+
+        // Another producer got it first
+        else {
+            position = claimPosition.load( std::memory_order_relaxed );
+        }
+    }
+}
+
+void LogRing::publish( LogRecord *record ) {
+    record->sequence.store( record->position + 1, std::memory_order_release );
+}
+
+LogRecord *LogRing::front() {
+    LogRecord *record = &records[ readPosition & ( LOGRING_SIZE - 1 ) ];
+
+    if( record->sequence.load( std::memory_order_acquire ) != readPosition + 1 ) {
+        return nullptr;
+    }
+
+    return record;
+}
+
+void LogRing::pop() {
+    LogRecord *record = &records[ readPosition & ( LOGRING_SIZE - 1 ) ];
+    record->sequence.store( readPosition + LOGRING_SIZE, std::memory_order_release );
+    readPosition++;
+}
+
+quint64 LogRing::dropped() const {
+    return droppedCount.load( std::memory_order_relaxed );
+}
+
+quint16 LogRing::appendString( LogRecord *record, quint16 offset, const char *string, size_t maxLength ) {
+    size_t length = string ? strlen( string ) : 0;
+    size_t space = LOGRING_TEXT_SIZE - offset - 1;
+
+    if( length > maxLength ) {
+        length = maxLength;
+    }
+
+    if( length > space ) {
+        length = space;
+    }
+
+    if( length ) {
+        memcpy( record->text + offset, string, length );
+    }
+
+    record->text[ offset + length ] = '\0';
+
+    return static_cast<quint16>( offset + length + 1 );
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+
+#include <stddef.h>
+
+// Records the ring holds, a power of two
+#define LOGRING_SIZE 512
+
+// Bytes of text each record holds (category, file and function names plus the message), longer messages are truncated
+#define LOGRING_TEXT_SIZE 984
+
+// A log message as it was logged, before any formatting
+struct LogRecord {
+    // Owned by LogRing
+    std::atomic<size_t> sequence;
+    size_t position;
+
+    // QtMsgType
+    quint8 type;
+
+    // retro_log_level + 1 if the message is from a Libretro core, 0 otherwise
+    quint8 coreLevel;
+
+    // Message is UTF-16 (from a QString) instead of 8-bit (from a core)
+    bool wide;
+
+    // Message didn't fit and was cut short
+    bool truncated;
+
+    int line;
+
+    // text holds the NUL-terminated category, file and function names at these offsets, followed by the message
+    quint16 fileOffset;
+    quint16 functionOffset;
+    quint16 messageOffset;
+    quint16 messageBytes;
+    char text[ LOGRING_TEXT_SIZE ];
+};
+
+/*
+ * LogRing is a bounded queue of LogRecords that any number of threads can log into without locking or allocating, and
+ * that one thread at a time reads from.
+ *
+ * Producers claim() a record, fill it in place then publish() it. If the ring is full the message is dropped (and
+ * counted) rather than waiting for the consumer: logging must never hold up the game thread. The consumer reads
+ * published records with front() and frees them with pop(), in the order they were claimed.
+ *
+ * Each record has a sequence number that tells producers and the consumer whose turn it is (see "bounded MPMC queue",
+ * D. Vyukov), so the only contended operation is the compare-and-swap producers use to claim a position.
+ */
+
+class LogRing {
+    public:
+        LogRing();
+
+        // Producer: claim a record to fill in. Returns nullptr if the ring is full
+        LogRecord *claim();
+
+        // Producer: hand a claimed record over to the consumer
+        void publish( LogRecord *record );
+
+        // Consumer: oldest record, nullptr if it hasn't been published yet or the ring is empty
+        LogRecord *front();
+
+        // Consumer: free the record front() returned
+        void pop();
+
+        // Messages dropped because the ring was full
+        quint64 dropped() const;
+
+        // Copy string, cut to maxLength bytes, NUL-terminated to text + offset. Returns the offset right after it
+        // offset must be within text, the string is cut further if it doesn't fit
+        static quint16 appendString( LogRecord *record, quint16 offset, const char *string, size_t maxLength );
+
+    private:
+        LogRecord records[ LOGRING_SIZE ];
+
+        alignas( 64 ) std::atomic<size_t> claimPosition { 0 };
+        alignas( 64 ) size_t readPosition { 0 };
+        std::atomic<quint64> droppedCount { 0 };
+};
@@ -0,0 +1,69 @@
+#include "memoryusage.h"
+
+#include <QFile>
+
+#if defined( Q_OS_UNIX )
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#if defined( Q_OS_WIN )
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+qint64 peakResidentSetSize() {
+#if defined( Q_OS_UNIX )
+    struct rusage usage;
+
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+        return -1;
+    }
+
+    // Bytes on macOS, kilobytes everywhere else
+#if defined( Q_OS_DARWIN )
+    return static_cast<qint64>( usage.ru_maxrss );
+#else
+    return static_cast<qint64>( usage.ru_maxrss ) * 1024;
+#endif
+#elif defined( Q_OS_WIN )
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) ) {
+        return -1;
+    }
+
+    return static_cast<qint64>( counters.PeakWorkingSetSize );
+#else
+    return -1;
+#endif
+}
+
+qint64 currentResidentSetSize() {
+#if defined( Q_OS_LINUX )
+    // Second field is the resident set size in pages
+    QFile statm( QStringLiteral( "/proc/self/statm" ) );
+
+    if( !statm.open( QIODevice::ReadOnly ) ) {
+        return -1;
+    }
+
+    QList<QByteArray> fields = statm.readAll().split( ' ' );
+
+    if( fields.size() < 2 ) {
+        return -1;
+    }
+
+    return fields[ 1 ].toLongLong() * sysconf( _SC_PAGESIZE );
+#elif defined( Q_OS_WIN )
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) ) {
+        return -1;
+    }
+
+    return static_cast<qint64>( counters.WorkingSetSize );
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QtGlobal>
+
+/*
+ * Process memory statistics, for load-time and benchmark reporting. Both return -1 where unsupported.
+ */
+
+// Largest resident set size (physical memory in use) this process has reached so far, in bytes
+qint64 peakResidentSetSize();
+
+// Current resident set size, in bytes
+qint64 currentResidentSetSize();
@@ -0,0 +1,245 @@
+#include "pixelconvert.h"
+
+#include <string.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PIXELCONVERT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled for its own functions only and only run if the CPU has it
+#if defined( PIXELCONVERT_USE_SSE2 ) && defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define PIXELCONVERT_USE_AVX2
+#define PIXELCONVERT_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+#include <immintrin.h>
+#endif
+
+namespace {
+    typedef void ( *LineConverter )( quint32 *destination, const uchar *source, int width );
+
+    template<QImage::Format Source>
+    struct SourceFormat {
+        static const int bytesPerPixel = Source == QImage::Format_RGB32 ? 4 : 2;
+    };
+
+    // Scalar
+
+    template<QImage::Format Source>
+    inline void scalarLine( quint32 *destination, const uchar *source, int width ) {
+        if( Source == QImage::Format_RGB32 ) {
+            for( int x = 0; x < width; x++ ) {
+                quint32 pixel;
+                memcpy( &pixel, source + x * 4, sizeof( pixel ) );
+                destination[ x ] = pixel | 0xFF000000;
+            }
+
+            return;
+        }
+
+        for( int x = 0; x < width; x++ ) {
+            quint16 pixel;
+            memcpy( &pixel, source + x * 2, sizeof( pixel ) );
+
+            quint32 r, g, b;
+
+            if( Source == QImage::Format_RGB16 ) {
+                r = pixel >> 11;
+                g = ( pixel >> 5 ) & 0x3F;
+                b = pixel & 0x1F;
+                g = ( g << 2 ) | ( g >> 4 );
+            } else {
+                r = ( pixel >> 10 ) & 0x1F;
+                g = ( pixel >> 5 ) & 0x1F;
+                b = pixel & 0x1F;
+                g = ( g << 3 ) | ( g >> 2 );
+            }
+
+            // Replicate the top bits into the bottom ones so full intensity maps to 0xFF
+            r = ( r << 3 ) | ( r >> 2 );
+            b = ( b << 3 ) | ( b >> 2 );
+
+            destination[ x ] = 0xFF000000 | ( r << 16 ) | ( g << 8 ) | b;
+        }
+    }
+
+    // SSE2
+
+#if defined( PIXELCONVERT_USE_SSE2 )
+    template<QImage::Format Source>
+    inline void sse2Line( quint32 *destination, const uchar *source, int width ) {
+        int x = 0;
+
+        if( Source == QImage::Format_RGB32 ) {
+            const __m128i alpha = _mm_set1_epi32( static_cast<int>( 0xFF000000 ) );
+
+            for( ; x + 4 <= width; x += 4 ) {
+                __m128i pixels = _mm_loadu_si128( reinterpret_cast<const __m128i *>( source + x * 4 ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i *>( destination + x ), _mm_or_si128( pixels, alpha ) );
+            }
+        } else {
+            const __m128i mask5 = _mm_set1_epi16( 0x1F );
+            const __m128i mask6 = _mm_set1_epi16( 0x3F );
+            const __m128i alpha = _mm_set1_epi16( static_cast<short>( 0xFF00 ) );
+
+            for( ; x + 8 <= width; x += 8 ) {
+                __m128i pixels = _mm_loadu_si128( reinterpret_cast<const __m128i *>( source + x * 2 ) );
+                __m128i r, g, b;
+
+                // Each channel in a 16-bit lane, widened to 8 bits
+                if( Source == QImage::Format_RGB16 ) {
+                    r = _mm_srli_epi16( pixels, 11 );
+                    g = _mm_and_si128( _mm_srli_epi16( pixels, 5 ), mask6 );
+                    g = _mm_or_si128( _mm_slli_epi16( g, 2 ), _mm_srli_epi16( g, 4 ) );
+                } else {
+                    r = _mm_and_si128( _mm_srli_epi16( pixels, 10 ), mask5 );
+                    g = _mm_and_si128( _mm_srli_epi16( pixels, 5 ), mask5 );
+                    g = _mm_or_si128( _mm_slli_epi16( g, 3 ), _mm_srli_epi16( g, 2 ) );
+                }
+
+                b = _mm_and_si128( pixels, mask5 );
+                r = _mm_or_si128( _mm_slli_epi16( r, 3 ), _mm_srli_epi16( r, 2 ) );
+                b = _mm_or_si128( _mm_slli_epi16( b, 3 ), _mm_srli_epi16( b, 2 ) );
+
+                // Low half of each output pixel is GGBB, high half is FFRR
+                __m128i greenBlue = _mm_or_si128( _mm_slli_epi16( g, 8 ), b );
+                __m128i alphaRed = _mm_or_si128( r, alpha );
+
+                _mm_storeu_si128( reinterpret_cast<__m128i *>( destination + x ), _mm_unpacklo_epi16( greenBlue, alphaRed ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i *>( destination + x + 4 ), _mm_unpackhi_epi16( greenBlue, alphaRed ) );
+            }
+        }
+
+        scalarLine<Source>( destination + x, source + x * SourceFormat<Source>::bytesPerPixel, width - x );
+    }
+#endif
+
+    // AVX2, same as SSE2 twice as wide
+
+#if defined( PIXELCONVERT_USE_AVX2 )
+    template<QImage::Format Source>
+    PIXELCONVERT_AVX2_TARGET inline void avx2Line( quint32 *destination, const uchar *source, int width ) {
+        int x = 0;
+
+        if( Source == QImage::Format_RGB32 ) {
+            const __m256i alpha = _mm256_set1_epi32( static_cast<int>( 0xFF000000 ) );
+
+            for( ; x + 8 <= width; x += 8 ) {
+                __m256i pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( source + x * 4 ) );
+                _mm256_storeu_si256( reinterpret_cast<__m256i *>( destination + x ), _mm256_or_si256( pixels, alpha ) );
+            }
+        } else {
+            const __m256i mask5 = _mm256_set1_epi16( 0x1F );
+            const __m256i mask6 = _mm256_set1_epi16( 0x3F );
+            const __m256i alpha = _mm256_set1_epi16( static_cast<short>( 0xFF00 ) );
+
+            for( ; x + 16 <= width; x += 16 ) {
+                __m256i pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( source + x * 2 ) );
+                __m256i r, g, b;
+
+                if( Source == QImage::Format_RGB16 ) {
+                    r = _mm256_srli_epi16( pixels, 11 );
+                    g = _mm256_and_si256( _mm256_srli_epi16( pixels, 5 ), mask6 );
+                    g = _mm256_or_si256( _mm256_slli_epi16( g, 2 ), _mm256_srli_epi16( g, 4 ) );
+                } else {
+                    r = _mm256_and_si256( _mm256_srli_epi16( pixels, 10 ), mask5 );
+                    g = _mm256_and_si256( _mm256_srli_epi16( pixels, 5 ), mask5 );
+                    g = _mm256_or_si256( _mm256_slli_epi16( g, 3 ), _mm256_srli_epi16( g, 2 ) );
+                }
+
+                b = _mm256_and_si256( pixels, mask5 );
+                r = _mm256_or_si256( _mm256_slli_epi16( r, 3 ), _mm256_srli_epi16( r, 2 ) );
+                b = _mm256_or_si256( _mm256_slli_epi16( b, 3 ), _mm256_srli_epi16( b, 2 ) );
+
+                __m256i greenBlue = _mm256_or_si256( _mm256_slli_epi16( g, 8 ), b );
+                __m256i alphaRed = _mm256_or_si256( r, alpha );
+
+                // Unpacking works within each 128-bit half: low holds pixels 0-3 and 8-11, high 4-7 and 12-15
+                __m256i low = _mm256_unpacklo_epi16( greenBlue, alphaRed );
+                __m256i high = _mm256_unpackhi_epi16( greenBlue, alphaRed );
+
+                _mm256_storeu_si256( reinterpret_cast<__m256i *>( destination + x ), _mm256_permute2x128_si256( low, high, 0x20 ) );
+                _mm256_storeu_si256( reinterpret_cast<__m256i *>( destination + x + 8 ), _mm256_permute2x128_si256( low, high, 0x31 ) );
+            }
+        }
+
+        scalarLine<Source>( destination + x, source + x * SourceFormat<Source>::bytesPerPixel, width - x );
+    }
+
+    template<QImage::Format Source>
+    PIXELCONVERT_AVX2_TARGET void avx2Frame( uchar *destination, size_t destinationPitch, const uchar *source,
+                                             size_t sourcePitch, int width, int height ) {
+        for( int y = 0; y < height; y++ ) {
+            avx2Line<Source>( reinterpret_cast<quint32 *>( destination + y * destinationPitch ), source + y * sourcePitch, width );
+        }
+    }
+
+    bool cpuHasAVX2() {
+        static const bool hasAVX2 = [] {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports( "avx2" ) != 0;
+        }();
+
+        return hasAVX2;
+    }
+#endif
+
+    template<QImage::Format Source, LineConverter line>
+    void convertFrame( uchar *destination, size_t destinationPitch, const uchar *source, size_t sourcePitch, int width,
+                       int height ) {
+        for( int y = 0; y < height; y++ ) {
+            line( reinterpret_cast<quint32 *>( destination + y * destinationPitch ), source + y * sourcePitch, width );
+        }
+    }
+
+    template<QImage::Format Source>
+    PixelConverter converterFor( PixelConverterKernel kernel ) {
+        switch( kernel ) {
+            case PixelConverterKernel::Scalar:
+                return &convertFrame<Source, &scalarLine<Source>>;
+
+            case PixelConverterKernel::SSE2:
+#if defined( PIXELCONVERT_USE_SSE2 )
+                return &convertFrame<Source, &sse2Line<Source>>;
+#else
+                return nullptr;
+#endif
+
+            case PixelConverterKernel::AVX2:
+#if defined( PIXELCONVERT_USE_AVX2 )
+                return cpuHasAVX2() ? &avx2Frame<Source> : nullptr;
+#else
+                return nullptr;
+#endif
+        }
+
+        return nullptr;
+    }
+}
+
+PixelConverter pixelConverter( QImage::Format sourceFormat ) {
+    PixelConverterKernel kernels[] = { PixelConverterKernel::AVX2, PixelConverterKernel::SSE2, PixelConverterKernel::Scalar };
+
+    for( PixelConverterKernel kernel : kernels ) {
+        if( PixelConverter converter = pixelConverter( sourceFormat, kernel ) ) {
+            return converter;
+        }
+    }
+
+    return nullptr;
+}
+
+PixelConverter pixelConverter( QImage::Format sourceFormat, PixelConverterKernel kernel ) {
+    switch( sourceFormat ) {
+        case QImage::Format_RGB555:
+            return converterFor<QImage::Format_RGB555>( kernel );
+
+        case QImage::Format_RGB16:
+            return converterFor<QImage::Format_RGB16>( kernel );
+
+        case QImage::Format_RGB32:
+            return converterFor<QImage::Format_RGB32>( kernel );
+
+        default:
+            return nullptr;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QImage>
+#include <QtGlobal>
+
+#include <stddef.h>
+
+/*
+ * Pixel format conversion for software-rendered video: turns a frame in one of the formats Libretro cores produce
+ * (0RGB1555 aka QImage::Format_RGB555, RGB565 aka QImage::Format_RGB16 or XRGB8888 aka QImage::Format_RGB32) into
+ * 0xffRRGGBB (QImage::Format_RGB32), which Qt uploads to a texture as-is. Qt would otherwise convert 16-bit frames one
+ * pixel at a time on the render thread every frame.
+ *
+ * Each converter is specialized at compile time for its source format and walks the frame line by line, converting
+ * straight out of the core's buffer at its pitch into a destination at another pitch, so the copy out of the core's
+ * buffer and the conversion are one pass. The padding at the end of the source's lines is skipped.
+ *
+ * Kernels: scalar everywhere, SSE2 (8 pixels at a time) where the compiler targets it (x86-64 always does) and AVX2
+ * (16 pixels at a time) with GCC and Clang on x86 CPUs that have it, chosen at runtime. Every kernel produces the same
+ * output.
+ */
+
+enum class PixelConverterKernel {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+// source is height lines of width pixels in sourceFormat, sourcePitch bytes apart. destination gets the same in
+// 0xffRRGGBB, destinationPitch bytes apart
+typedef void ( *PixelConverter )( uchar *destination, size_t destinationPitch, const uchar *source, size_t sourcePitch,
+                                  int width, int height );
+
+// The fastest converter from sourceFormat this CPU can run, nullptr if sourceFormat isn't one of the three above
+PixelConverter pixelConverter( QImage::Format sourceFormat );
+
+// The converter from sourceFormat using the given kernel, nullptr if that kernel isn't available in this build or on
+// this CPU (or sourceFormat isn't supported)
+PixelConverter pixelConverter( QImage::Format sourceFormat, PixelConverterKernel kernel );
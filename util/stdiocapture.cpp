@@ -0,0 +1,224 @@
+#include "stdiocapture.h"
+#include "logging.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QTime>
+
+#include <stdio.h>
+
+#if defined( Q_OS_UNIX )
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Lines longer than this are logged in pieces
+#define STDIOCAPTURE_MAX_LINE_LENGTH 4096
+
+#if defined( Q_OS_UNIX )
+
+namespace {
+    // One per captured stream
+    struct Stream {
+        const char *name;
+        int fd;
+
+        // Where fd pointed before capture
+        int originalFd;
+
+        // Read end of the pipe fd now points to
+        int readFd;
+
+        // Unfinished line
+        QByteArray pending;
+
+        // When the first byte of pending was read
+        QTime pendingTime;
+    };
+
+    Stream streams[ 2 ] = {
+        { "stdout", STDOUT_FILENO, -1, -1, QByteArray(), QTime() },
+        { "stderr", STDERR_FILENO, -1, -1, QByteArray(), QTime() },
+    };
+
+    // Lines carry the time they were read, the log's own timestamp (if QT_MESSAGE_PATTERN has one) is when the logger
+    // thread got around to them
+    void logLine( const Stream &stream, const QByteArray &line, const QTime &time ) {
+        qCInfo( phxCore ).noquote().nospace() << "[" << stream.name << " "
+                                              << time.toString( QStringLiteral( "hh:mm:ss.zzz" ) ) << "] "
+                                              << QString::fromLocal8Bit( line );
+    }
+
+    // Log every complete line in pending, and the rest too if flush is set. now is when the newest data was read
+    void logPending( Stream &stream, bool flush, const QTime &now ) {
+        int start = 0;
+
+        while( true ) {
+            int end = stream.pending.indexOf( '\n', start );
+
+            if( end < 0 ) {
+                break;
+            }
+
+            int length = end - start;
+
+            // Drop the carriage return of a CRLF
+            if( length > 0 && stream.pending.at( end - 1 ) == '\r' ) {
+                length--;
+            }
+
+            // Only the first line can have started in an earlier read, the earlier lines were logged back then
+            logLine( stream, stream.pending.mid( start, length ), start ? now : stream.pendingTime );
+            start = end + 1;
+        }
+
+        stream.pending.remove( 0, start );
+
+        if( start ) {
+            stream.pendingTime = now;
+        }
+
+        if( ( flush && !stream.pending.isEmpty() ) || stream.pending.size() >= STDIOCAPTURE_MAX_LINE_LENGTH ) {
+            logLine( stream, stream.pending, stream.pendingTime );
+            stream.pending.clear();
+        }
+    }
+
+    class ReaderThread : public QThread {
+        protected:
+            void run() override {
+                char buffer[ 4096 ];
+                pollfd fds[ 2 ];
+                int open = 2;
+
+                for( int i = 0; i < 2; i++ ) {
+                    fds[ i ].fd = streams[ i ].readFd;
+                    fds[ i ].events = POLLIN;
+                }
+
+                // Runs until both pipes have been closed on the write end (stopStdioCapture())
+                while( open > 0 ) {
+                    if( poll( fds, 2, -1 ) < 0 ) {
+                        if( errno == EINTR ) {
+                            continue;
+                        }
+
+                        break;
+                    }
+
+                    QTime now = QTime::currentTime();
+
+                    for( int i = 0; i < 2; i++ ) {
+                        if( fds[ i ].fd < 0 || !( fds[ i ].revents & ( POLLIN | POLLHUP | POLLERR ) ) ) {
+                            continue;
+                        }
+
+                        ssize_t bytes = read( fds[ i ].fd, buffer, sizeof( buffer ) );
+
+                        if( bytes > 0 ) {
+                            if( streams[ i ].pending.isEmpty() ) {
+                                streams[ i ].pendingTime = now;
+                            }
+
+                            streams[ i ].pending.append( buffer, static_cast<int>( bytes ) );
+                            logPending( streams[ i ], false, now );
+                        } else if( bytes == 0 || errno != EINTR ) {
+                            logPending( streams[ i ], true, now );
+                            fds[ i ].fd = -1;
+                            open--;
+                        }
+                    }
+                }
+            }
+    };
+
+    ReaderThread *readerThread { nullptr };
+}
+
+void startStdioCapture() {
+    if( readerThread ) {
+        return;
+    }
+
+    fflush( stdout );
+    fflush( stderr );
+
+    for( Stream &stream : streams ) {
+        stream.originalFd = dup( stream.fd );
+    }
+
+    // Log messages must not end up in the pipe they'd be read back from
+    if( !setLogOutputFd( streams[ 1 ].originalFd ) ) {
+        qCDebug( phxCore ) << "Log messages can't be kept out of stderr, not capturing stdout/stderr";
+        stopStdioCapture();
+        return;
+    }
+
+    for( Stream &stream : streams ) {
+        int pipeFds[ 2 ];
+
+        if( pipe( pipeFds ) != 0 ) {
+            qCWarning( phxCore ) << "Could not create a pipe for" << stream.name << "- not capturing stdout/stderr";
+            stopStdioCapture();
+            return;
+        }
+
+        dup2( pipeFds[ 1 ], stream.fd );
+        close( pipeFds[ 1 ] );
+        stream.readFd = pipeFds[ 0 ];
+    }
+
+    // A pipe would get stdout fully buffered, which is why output used to be flushed every frame
+    setvbuf( stdout, nullptr, _IOLBF, 0 );
+
+    readerThread = new ReaderThread;
+    readerThread->setObjectName( "Stdio capture thread" );
+    readerThread->start( QThread::LowPriority );
+
+    qAddPostRoutine( stopStdioCapture );
+}
+
+void stopStdioCapture() {
+    fflush( stdout );
+    fflush( stderr );
+
+    // Closes the write ends of the pipes, the reader thread logs what's left and exits
+    for( Stream &stream : streams ) {
+        if( stream.originalFd >= 0 ) {
+            dup2( stream.originalFd, stream.fd );
+        }
+    }
+
+    if( readerThread ) {
+        readerThread->wait();
+        delete readerThread;
+        readerThread = nullptr;
+    }
+
+    setLogOutputFd( -1 );
+
+    for( Stream &stream : streams ) {
+        if( stream.originalFd >= 0 ) {
+            close( stream.originalFd );
+            stream.originalFd = -1;
+        }
+
+        if( stream.readFd >= 0 ) {
+            close( stream.readFd );
+            stream.readFd = -1;
+        }
+
+        stream.pending.clear();
+    }
+}
+
+#else
+
+void startStdioCapture() {
+}
+
+void stopStdioCapture() {
+}
+
+#endif
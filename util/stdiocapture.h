@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+ * Stdio capture sends whatever gets written to stdout and stderr (by cores that don't use RETRO_ENVIRONMENT_GET_LOG_INTERFACE,
+ * mostly) to the log instead, line by line, under phxCore. Each line is tagged with the stream and the time it was read.
+ *
+ * File descriptors 1 and 2 are pointed at pipes that a reader thread drains, so writing to them costs the writer no more
+ * than a write() to a pipe and nobody has to fflush() anything to get output out in time: stdout is switched to line
+ * buffering. Log messages bound for stderr go to the original stderr instead so they don't loop back (see
+ * setLogOutputFd()).
+ *
+ * Unix only, does nothing elsewhere. Start it after startAsyncLogging(). It stops on its own when the QCoreApplication
+ * is destroyed.
+ */
+
+void startStdioCapture();
+
+// Point stdout and stderr back where they were, log whatever is left in the pipes and stop the reader thread
+void stopStdioCapture();
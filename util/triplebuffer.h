@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+
+/*
+ * TripleBuffer hands the latest of a stream of Ts from one producer thread to one consumer thread without locking.
+ *
+ * Of its three slots one always belongs to the producer, one to the consumer and one sits in between. The producer
+ * fills writeSlot() in place then publish()es it, which swaps it with the one in between: the producer always has a
+ * free slot and never waits. The consumer calls update() to swap its slot with the one in between if a newer one was
+ * published since, so readSlot() is always the newest complete T. Ts published in between two updates are overwritten
+ * and never seen.
+ *
+ * The swaps are a single atomic exchange of the in-between slot's index, with a bit set if it holds a T the consumer
+ * hasn't seen yet.
+ */
+
+template<typename T>
+class TripleBuffer {
+    public:
+        // Producer: the slot to fill in
+        T &writeSlot() {
+            return slots[ writeIndex ];
+        }
+
+        // Producer: hand writeSlot() over to the consumer, writeSlot() is another slot afterwards
+        void publish() {
+            writeIndex = middle.exchange( writeIndex | freshBit, std::memory_order_acq_rel ) & indexMask;
+        }
+
+        // Consumer: true if a slot was published since the last update()
+        bool hasUpdate() const {
+            return middle.load( std::memory_order_relaxed ) & freshBit;
+        }
+
+        // Consumer: take the newest published slot, if there's one the consumer hasn't seen. Returns true if readSlot()
+        // changed
+        bool update() {
+            if( !hasUpdate() ) {
+                return false;
+            }
+
+            readIndex = middle.exchange( readIndex, std::memory_order_acq_rel ) & indexMask;
+            return true;
+        }
+
+        // Consumer: the newest slot update() took, default-constructed until there was one
+        T &readSlot() {
+            return slots[ readIndex ];
+        }
+
+        // All three slots, only safe while neither side is using them
+        T &slot( int index ) {
+            return slots[ index ];
+        }
+
+    private:
+        static const int indexMask = 3;
+        static const int freshBit = 4;
+
+        T slots[ 3 ];
+
+        int writeIndex { 0 };
+        std::atomic<int> middle { 1 };
+        int readIndex { 2 };
+};